@@ -4,6 +4,7 @@ module;
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <vector>
 #include <span>
 #include <string>
@@ -28,6 +29,7 @@ module;
 #include <glm/gtx/hash.hpp>
 #include <print>
 #include <optional>
+#include <expected>
 
 export module environment_map;
 import vk;
@@ -106,6 +108,12 @@ public:
         staging_buffer.transfer(pixels_data);
         // staging_buffer.write(pixels_data);
 
+        // Image based lighting is produced from the same texels before they
+        // are freed
+        process_to_cubemap(
+          std::span<const float>(pixels, static_cast<size_t>(width) * height * 4),
+          { .width = width, .height = height });
+
         // Free CPU pixels immediately after staging copy
         stbi_image_free(pixels);
 
@@ -556,6 +564,7 @@ public:
     void destruct() {
 
         m_skybox_image.destruct();
+        m_ibl.destruct();
         if (m_skybox_pipeline->alive()) {
             m_skybox_pipeline->destruct();
         }
@@ -565,14 +574,94 @@ public:
         m_skybox_vbo.destruct();
     }
 
-    //! TODO: Logic for converting the HDR image handles to a skybox
-    //! samplerCube
-    void process_to_cubemap() {}
+    //! @brief Converts the HDR texels into the skybox cubemap and image
+    //! based lighting maps. Results are cached on disk between runs.
+    void process_to_cubemap(std::span<const float> p_pixels,
+                            const vk::image_extent& p_extent) {
+        vk::environment_params params = {
+            .memory_mask = m_physical_device->memory_properties(
+              vk::memory_property::device_local_bit),
+            .staging_memory_mask = m_physical_device->memory_properties(
+              vk::memory_property::host_visible_bit |
+              vk::memory_property::host_coherent_bit),
+            .shaders = {
+              .equirect_to_cubemap = environment_shader("equirect_to_cubemap"),
+              .prefilter_specular = environment_shader("prefilter_specular"),
+              .irradiance = environment_shader("irradiance"),
+              .brdf_lut = environment_shader("brdf_lut"),
+            },
+            .cache_directory = "asset_samples/.ibl_cache",
+        };
+
+        vk::environment_processor processor(m_device, params);
+        if (!processor.alive()) {
+            std::println("environment_map: compile the compute shaders of "
+                         "shader_samples/sample10-environment with glslc, or "
+                         "build vulkan-cpp with VULKAN_CPP_SHADERC, to "
+                         "enable image based lighting");
+            return;
+        }
+
+        m_ibl = processor.process(p_pixels, p_extent);
+        processor.destruct();
+
+        std::println("environment_map: image based lighting {} ({} "
+                     "prefiltered levels)",
+                     m_ibl.from_cache ? "loaded from cache" : "computed",
+                     m_ibl.prefiltered_mips);
+    }
+
+    /**
+     * @return the .spv of compute shader p_name of sample10-environment.
+     * When it has not been compiled with glslc yet, it is compiled from the
+     * GLSL source with vk::shader_compiler if vulkan-cpp was built with
+     * shaderc, and written to the shader cache rather than next to the
+     * source.
+     */
+    static std::string environment_shader(const std::string& p_name) {
+        const std::filesystem::path source =
+          "shader_samples/sample10-environment/" + p_name + ".comp";
+        std::filesystem::path binary = source;
+        binary += ".spv";
+
+        if (std::filesystem::exists(binary) or
+            !vk::shader_compiler::available()) {
+            return binary.string();
+        }
+
+        const std::filesystem::path cache_directory =
+          "asset_samples/.shader_cache";
+        vk::shader_compiler compiler({ .cache_directory = cache_directory });
+        const std::expected<std::vector<uint32_t>, std::string> spirv =
+          compiler.compile({
+            .filename = source,
+            .stage = vk::shader_stage::compute,
+          });
+        if (!spirv) {
+            std::println("{}", spirv.error());
+            return binary.string();
+        }
+
+        // Rewritten on every run, the compiler cache makes it a lookup and
+        // keeps the file in sync with the GLSL
+        std::filesystem::create_directories(cache_directory);
+        const std::filesystem::path compiled =
+          cache_directory / binary.filename();
+        std::ofstream outs(compiled, std::ios::binary);
+        outs.write(reinterpret_cast<const char*>(spirv->data()),
+                   static_cast<std::streamsize>(spirv->size() *
+                                                sizeof(uint32_t)));
+        return compiled.string();
+    }
+
+    //! @return the cubemaps and BRDF lookup table for image based lighting
+    [[nodiscard]] const vk::environment_maps& ibl() const { return m_ibl; }
 
 private:
     VkDevice m_device = nullptr;
     vk::physical_device* m_physical_device = nullptr;
     vk::sample_image m_skybox_image;
+    vk::environment_maps m_ibl{};
 
     vk::shader_resource m_skybox_shaders{};
     vk::uniform_buffer m_skybox_ubo{};
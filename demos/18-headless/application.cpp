@@ -0,0 +1,284 @@
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <print>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <expected>
+
+import vk;
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL
+debug_callback(
+  [[maybe_unused]] VkDebugUtilsMessageSeverityFlagBitsEXT p_message_severity,
+  [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT p_message_type,
+  const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
+  [[maybe_unused]] void* p_user_data) {
+    std::print("validation layer:\t\t{}\n\n", p_callback_data->pMessage);
+    return false;
+}
+
+//! @brief RGBA8 texel at (p_x, p_y) of tightly packed p_pixels
+std::array<uint8_t, 4>
+texel(std::span<const std::byte> p_pixels,
+      VkExtent2D p_extent,
+      uint32_t p_x,
+      uint32_t p_y) {
+    const size_t offset =
+      (static_cast<size_t>(p_y) * p_extent.width + p_x) * 4;
+    return {
+        static_cast<uint8_t>(p_pixels[offset + 0]),
+        static_cast<uint8_t>(p_pixels[offset + 1]),
+        static_cast<uint8_t>(p_pixels[offset + 2]),
+        static_cast<uint8_t>(p_pixels[offset + 3]),
+    };
+}
+
+//! @brief Writes the RGB channels of p_pixels as a binary PPM
+void
+write_ppm(const char* p_filename,
+          std::span<const std::byte> p_pixels,
+          VkExtent2D p_extent) {
+    std::ofstream outs(p_filename, std::ios::binary);
+    outs << "P6\n" << p_extent.width << " " << p_extent.height << "\n255\n";
+    for (size_t i = 0; i < p_pixels.size(); i += 4) {
+        outs.write(reinterpret_cast<const char*>(&p_pixels[i]), 3);
+    }
+}
+
+int
+main() {
+    // No window, surface or swapchain, so no GLFW and no WSI extensions
+    std::array<const char*, 1> validation_layers = {
+        "VK_LAYER_KHRONOS_validation",
+    };
+
+    std::vector<const char*> global_extensions = {
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    };
+#if defined(__APPLE__)
+    global_extensions.emplace_back(
+      VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+
+    vk::debug_message_utility debug_callback_info = {
+        .severity = vk::message::warning | vk::message::error,
+        .message_type =
+          vk::debug::general | vk::debug::validation | vk::debug::performance,
+        .callback = debug_callback
+    };
+
+    vk::application_params config = {
+        .name = "vulkan instance",
+        .version = vk::api_version::vk_1_3,
+        .validations = validation_layers,
+        .extensions = global_extensions,
+    };
+
+    vk::instance api_instance(config, debug_callback_info);
+
+    // lavapipe reports itself as a CPU device, prefer it so the demo runs the
+    // same on CI machines without a GPU
+    std::expected<vk::physical_device, VkResult> physical_device_expected =
+      api_instance.enumerate_physical_device(vk::physical_gpu::type_cpu);
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::integrated);
+    }
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::discrete);
+    }
+    if (!physical_device_expected) {
+        std::println("No physical device found");
+        return -1;
+    }
+    vk::physical_device physical_device = physical_device_expected.value();
+
+    std::array<float, 1> priorities = { 0.f };
+#if defined(__APPLE__)
+    std::array<const char*, 1> extensions = { "VK_KHR_portability_subset" };
+#else
+    std::span<const char*> extensions{};
+#endif
+
+    vk::device_params logical_device_params = {
+        .queue_priorities = priorities,
+        .extensions = extensions,
+        .queue_family_index = 0,
+    };
+    vk::device logical_device(physical_device, logical_device_params);
+
+    const VkExtent2D extent = { .width = 256, .height = 256 };
+    const VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // The image stays in the attachment layout between frames, the target
+    // moves it to and from the transfer layout around its readback copy
+    std::array<vk::attachment, 1> renderpass_attachments = {
+        vk::attachment{
+          .format = color_format,
+          .layout = vk::image_layout::color_optimal,
+          .samples = vk::sample_bit::count_1,
+          .load = vk::attachment_load::clear,
+          .store = vk::attachment_store::store,
+          .stencil_load = vk::attachment_load::dont_care,
+          .stencil_store = vk::attachment_store::dont_care,
+          .initial_layout = vk::image_layout::undefined,
+          .final_layout = vk::image_layout::color_optimal,
+        },
+    };
+    vk::renderpass main_renderpass(logical_device, renderpass_attachments);
+
+    vk::headless_target target(
+      logical_device,
+      vk::headless_target_params{
+        .extent = extent,
+        .format = color_format,
+        .image_count = 2,
+        .memory_mask = physical_device.memory_properties(
+          vk::memory_property::device_local_bit),
+        .readback_memory_mask = physical_device.memory_properties(
+          static_cast<vk::memory_property>(
+            vk::memory_property::host_visible_bit |
+            vk::memory_property::host_coherent_bit)),
+        .renderpass = main_renderpass,
+      });
+
+    if (!target.alive()) {
+        std::println("headless_target could not be created");
+        return -1;
+    }
+
+    std::vector<vk::command_buffer> command_buffers(target.image_count());
+    for (vk::command_buffer& command : command_buffers) {
+        command = vk::command_buffer(logical_device,
+                                     vk::command_params{
+                                       .levels = vk::command_levels::primary,
+                                       .queue_index = 0,
+                                       .flags = vk::command_pool_flags::reset,
+                                     });
+    }
+
+    std::array<vk::shader_source, 2> shader_sources = {
+        vk::shader_source{
+          .filename = "shader_samples/sample1/test.vert.spv",
+          .stage = vk::shader_stage::vertex,
+        },
+        vk::shader_source{
+          .filename = "shader_samples/sample1/test.frag.spv",
+          .stage = vk::shader_stage::fragment,
+        },
+    };
+    vk::shader_resource_info shader_info = {
+        .sources = shader_sources,
+    };
+    vk::shader_resource geometry_resource(logical_device, shader_info);
+
+    std::array<vk::color_blend_attachment_state, 1> color_blend_attachments = {
+        vk::color_blend_attachment_state{},
+    };
+    std::array<vk::dynamic_state, 2> dynamic_states = {
+        vk::dynamic_state::viewport, vk::dynamic_state::scissor
+    };
+    vk::pipeline_params pipeline_configuration = {
+        .renderpass = main_renderpass,
+        .shader_modules = geometry_resource.handles(),
+        .vertex_attributes = geometry_resource.vertex_attributes(),
+        .vertex_bind_attributes = geometry_resource.vertex_bind_attributes(),
+        .color_blend = {
+            .attachments = color_blend_attachments,
+        },
+        .dynamic_states = dynamic_states,
+    };
+    vk::pipeline main_graphics_pipeline(logical_device, pipeline_configuration);
+
+    std::array<float, 4> color = { 0.f, 0.5f, 0.5f, 1.f };
+
+    // More frames than images, so every image is reused and the ring waits
+    // on its fences like a swapchain would
+    constexpr uint32_t frame_count = 5;
+    uint32_t current_image = 0;
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        current_image = target.acquire_next_image();
+        vk::command_buffer& current = command_buffers[current_image];
+
+        current.begin(vk::command_usage::one_time_submit);
+        vk::renderpass_begin_params begin_renderpass = {
+            .extent = extent,
+            .current_framebuffer = target.framebuffer(current_image),
+            .color = color,
+            .subpass = vk::subpass_contents::inline_bit
+        };
+        main_renderpass.begin(current, begin_renderpass);
+
+        main_graphics_pipeline.bind(current);
+
+        VkViewport viewport = {
+            .x = 0.f,
+            .y = 0.f,
+            .width = static_cast<float>(extent.width),
+            .height = static_cast<float>(extent.height),
+            .minDepth = 0.f,
+            .maxDepth = 1.f,
+        };
+        VkRect2D scissor = { .offset = { 0, 0 }, .extent = extent };
+        vkCmdSetViewport(current, 0, 1, &viewport);
+        vkCmdSetScissor(current, 0, 1, &scissor);
+
+        vkCmdDraw(current, 3, 1, 0, 0);
+
+        main_renderpass.end(current);
+        current.end();
+
+        std::array<const VkCommandBuffer, 1> commands = { current };
+        target.submit(commands);
+    }
+
+    // Waits on the last submit of the image, then reads the copied pixels
+    std::span<const std::byte> pixels = target.readback(current_image);
+
+    // The triangle covers the center, the corners keep the clear color
+    const std::array<uint8_t, 4> center =
+      texel(pixels, extent, extent.width / 2, extent.height / 2);
+    const std::array<uint8_t, 4> corner = texel(pixels, extent, 0, 0);
+    const bool cleared = corner[0] == 0 and corner[1] >= 127 and
+                         corner[1] <= 128 and corner[2] >= 127 and
+                         corner[2] <= 128;
+    const bool drawn = center != corner;
+
+    std::println("corner = ({}, {}, {}, {})",
+                 corner[0],
+                 corner[1],
+                 corner[2],
+                 corner[3]);
+    std::println("center = ({}, {}, {}, {})",
+                 center[0],
+                 center[1],
+                 center[2],
+                 center[3]);
+
+    write_ppm("headless.ppm", pixels, extent);
+    std::println("Rendered {} frames into {} images, wrote headless.ppm",
+                 frame_count,
+                 target.image_count());
+
+    logical_device.wait();
+
+    for (vk::command_buffer& command : command_buffers) {
+        command.destruct();
+    }
+    main_graphics_pipeline.destruct();
+    geometry_resource.destruct();
+    target.destruct();
+    main_renderpass.destruct();
+    logical_device.destruct();
+
+    if (!cleared or !drawn) {
+        std::println("Readback does not match the rendered frame");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include <vulkan/vulkan.h>
+
+#include <print>
+#include <span>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <expected>
+#include <cstdint>
+#include <filesystem>
+#include <algorithm>
+#include <system_error>
+
+import vk;
+
+//! @return the stage of a GLSL source from its extension, undefined if none
+vk::shader_stage
+stage_from_extension(const std::filesystem::path& p_path) {
+    const std::string extension = p_path.extension().string();
+    if (extension == ".vert") {
+        return vk::shader_stage::vertex;
+    }
+    if (extension == ".frag") {
+        return vk::shader_stage::fragment;
+    }
+    if (extension == ".comp") {
+        return vk::shader_stage::compute;
+    }
+    return vk::shader_stage::undefined;
+}
+
+//! @return every GLSL source under p_directory with a known stage
+std::vector<vk::shader_compile_source>
+collect_sources(const std::filesystem::path& p_directory) {
+    std::vector<vk::shader_compile_source> sources;
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(p_directory)) {
+        const vk::shader_stage stage = stage_from_extension(entry.path());
+        if (!entry.is_regular_file() or stage == vk::shader_stage::undefined) {
+            continue;
+        }
+        sources.push_back({ .filename = entry.path(), .stage = stage });
+    }
+    return sources;
+}
+
+struct compile_pass {
+    double elapsed_ms = 0.0;
+    uint32_t failed = 0;
+    std::vector<std::vector<uint32_t>> spirv;
+};
+
+//! @brief Compiles every source through a fresh compiler on p_cache
+compile_pass
+compile_all(std::span<const vk::shader_compile_source> p_sources,
+            const std::filesystem::path& p_cache) {
+    vk::shader_compiler compiler({ .cache_directory = p_cache });
+
+    compile_pass pass;
+    const auto start = std::chrono::steady_clock::now();
+    for (const vk::shader_compile_source& source : p_sources) {
+        std::expected<std::vector<uint32_t>, std::string> spirv =
+          compiler.compile(source);
+        if (!spirv) {
+            std::println("  {}", spirv.error());
+            pass.failed++;
+        }
+        pass.spirv.push_back(spirv.value_or(std::vector<uint32_t>{}));
+    }
+    pass.elapsed_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+    const vk::shader_compiler_stats stats = compiler.stats();
+    std::println("  {} compiles, {} cache hits, {} failed, {:.2f} ms",
+                 stats.compiles,
+                 stats.cache_hits,
+                 pass.failed,
+                 pass.elapsed_ms);
+    return pass;
+}
+
+/**
+ * @brief Compiles shader_samples with an empty cache then again with the
+ * cache it wrote, and checks both passes produce the same SPIR-V
+ */
+bool
+benchmark_compiler(const std::filesystem::path& p_samples) {
+    const std::filesystem::path cache = ".shader_cache";
+    std::vector<vk::shader_compile_source> sources =
+      collect_sources(p_samples);
+    std::println("shader_compiler: {} sources, shaderc {}",
+                 sources.size(),
+                 vk::shader_compiler::available() ? "linked" : "not linked");
+
+    if (!vk::shader_compiler::available()) {
+        // Only a cache shipped next to the binary can be loaded
+        std::println("warm (shipped cache):");
+        compile_all(sources, cache);
+        return true;
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(cache, error);
+
+    std::println("cold:");
+    compile_pass cold = compile_all(sources, cache);
+    std::println("warm:");
+    compile_pass warm = compile_all(sources, cache);
+
+    bool matching = cold.failed == warm.failed;
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (cold.spirv[i] != warm.spirv[i]) {
+            std::println("  {} differs between cold and warm",
+                         sources[i].filename.string());
+            matching = false;
+        }
+    }
+    if (warm.elapsed_ms > 0.0) {
+        std::println("warm is {:.1f}x faster than cold",
+                     cold.elapsed_ms / warm.elapsed_ms);
+    }
+    return matching and cold.failed == 0;
+}
+
+//! @brief Binding a sample shader is expected to declare
+struct expected_binding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    vk::descriptor_type type = vk::descriptor_type::uniform;
+    uint32_t count = 1;
+};
+
+//! @brief What reflecting a sample .spv must produce
+struct expected_reflection {
+    std::string_view filename;
+    std::vector<expected_binding> bindings;
+    // size of the push constant block, 0 when there is none
+    uint32_t push_constant_range = 0;
+    // not checked in, only verified once compiled from its GLSL
+    bool generated = false;
+};
+
+constexpr vk::descriptor_type ubo = vk::descriptor_type::uniform;
+constexpr vk::descriptor_type sampler =
+  vk::descriptor_type::combined_image_sampler;
+constexpr vk::descriptor_type storage_image =
+  vk::descriptor_type::storage_image;
+
+//! @brief Bindings of every .spv in shader_samples, taken from its GLSL
+const std::array<expected_reflection, 28> expected_reflections = {
+    expected_reflection{ "sample1/test.vert.spv", {} },
+    { "sample1/test.frag.spv", {} },
+    { "sample2/test.vert.spv", {} },
+    { "sample2/test.frag.spv", {} },
+    { "sample3/test.vert.spv", { { 0, 0, ubo } } },
+    { "sample3/test.frag.spv", {} },
+    { "sample4/test.vert.spv", { { 0, 0, ubo } } },
+    { "sample4/test.frag.spv", { { 0, 1, sampler } } },
+    { "sample5/test.vert.spv", { { 0, 0, ubo } } },
+    { "sample5/test.frag.spv", { { 1, 0, sampler } } },
+    { "sample6/sky.vert.spv", { { 0, 0, ubo } } },
+    { "sample6/sky.frag.spv", { { 1, 0, sampler } } },
+    { "sample6/test.vert.spv", { { 0, 0, ubo } } },
+    { "sample6/test.frag.spv", { { 0, 1, sampler } } },
+    { "sample7-skybox/skybox.vert.spv", { { 0, 0, ubo } } },
+    { "sample7-skybox/skybox.frag.spv", { { 0, 1, sampler } } },
+    // int texture_index
+    { "sample8-descriptor-indexing/test.vert.spv", { { 0, 0, ubo } }, 4 },
+    // sampler2D textures[] is a runtime array, reflected with a count of 0
+    { "sample8-descriptor-indexing/test.frag.spv", { { 1, 0, sampler, 0 } } },
+    // int texture_index, then a 64-bit buffer reference at offset 8
+    { "sample9-buffer-device-address/test.vert.spv", {}, 16 },
+    { "sample9-buffer-device-address/test.frag.spv",
+      { { 0, 1, sampler, 0 } } },
+    { "sandbox-shader-samples/test.vert.spv",
+      { { 0, 0, ubo }, { 1, 0, ubo } } },
+    { "sandbox-shader-samples/test.frag.spv",
+      { { 1, 1, sampler }, { 1, 2, sampler } } },
+    { "skybox_sampler/skybox.vert.spv", { { 0, 0, ubo } } },
+    { "skybox_sampler/skybox.frag.spv", { { 0, 1, sampler } } },
+    // environment_push: float roughness, uint sample_count, size, source_size
+    { "sample10-environment/equirect_to_cubemap.comp.spv",
+      { { 0, 0, sampler }, { 0, 1, storage_image } },
+      16,
+      true },
+    { "sample10-environment/prefilter_specular.comp.spv",
+      { { 0, 0, sampler }, { 0, 1, storage_image } },
+      16,
+      true },
+    { "sample10-environment/irradiance.comp.spv",
+      { { 0, 0, sampler }, { 0, 1, storage_image } },
+      16,
+      true },
+    { "sample10-environment/brdf_lut.comp.spv",
+      { { 0, 1, storage_image } },
+      16,
+      true },
+};
+
+//! @return true if reflecting p_expected's .spv yields its bindings and push
+//! constant range
+bool
+check_reflection(const std::filesystem::path& p_samples,
+                 const expected_reflection& p_expected) {
+    const std::filesystem::path path = p_samples / p_expected.filename;
+    vk::spirv_file binary(path);
+    vk::shader_reflection reflection(binary.words());
+    if (!binary.valid() or !reflection.valid()) {
+        std::println("  {}: cannot be reflected", p_expected.filename);
+        return false;
+    }
+
+    bool matching = true;
+    std::span<const vk::reflected_descriptor> descriptors =
+      reflection.descriptors();
+    if (descriptors.size() != p_expected.bindings.size()) {
+        std::println("  {}: {} bindings, expected {}",
+                     p_expected.filename,
+                     descriptors.size(),
+                     p_expected.bindings.size());
+        matching = false;
+    }
+    for (size_t i = 0;
+         i < std::min(descriptors.size(), p_expected.bindings.size());
+         i++) {
+        const vk::reflected_descriptor& actual = descriptors[i];
+        const expected_binding& expected = p_expected.bindings[i];
+        if (actual.set != expected.set or
+            actual.entry.binding_point.binding != expected.binding or
+            actual.entry.type != expected.type or
+            actual.entry.descriptor_count != expected.count) {
+            std::println("  {}: binding {} is set {} binding {} type {} "
+                         "count {}, expected set {} binding {} type {} "
+                         "count {}",
+                         p_expected.filename,
+                         i,
+                         actual.set,
+                         actual.entry.binding_point.binding,
+                         static_cast<uint32_t>(actual.entry.type),
+                         actual.entry.descriptor_count,
+                         expected.set,
+                         expected.binding,
+                         static_cast<uint32_t>(expected.type),
+                         expected.count);
+            matching = false;
+        }
+    }
+
+    std::span<const vk::push_constant_range> push_constants =
+      reflection.push_constants();
+    const uint32_t push_constant_range =
+      push_constants.empty() ? 0 : push_constants.front().range;
+    if (push_constants.size() > 1 or
+        push_constant_range != p_expected.push_constant_range or
+        (!push_constants.empty() and push_constants.front().offset != 0)) {
+        std::println("  {}: push constant range {}, expected {}",
+                     p_expected.filename,
+                     push_constant_range,
+                     p_expected.push_constant_range);
+        matching = false;
+    }
+    return matching;
+}
+
+/**
+ * @brief Reflects every .spv in shader_samples, failing on a .spv without an
+ * expectation or whose reflection does not match it
+ */
+bool
+verify_reflection(const std::filesystem::path& p_samples) {
+    uint32_t checked = 0;
+    uint32_t checked_in = 0;
+    uint32_t failed = 0;
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(p_samples)) {
+        if (!entry.is_regular_file() or entry.path().extension() != ".spv") {
+            continue;
+        }
+        const std::string relative =
+          entry.path().lexically_relative(p_samples).generic_string();
+        const auto expected = std::ranges::find(
+          expected_reflections, relative, &expected_reflection::filename);
+        if (expected == expected_reflections.end()) {
+            std::println("  {}: no expected reflection", relative);
+            failed++;
+            continue;
+        }
+        checked++;
+        if (!expected->generated) {
+            checked_in++;
+        }
+        if (!check_reflection(p_samples, *expected)) {
+            failed++;
+        }
+    }
+    std::println("shader_reflection: {} modules checked, {} failed",
+                 checked,
+                 failed);
+    // Every checked in module has to be found
+    const auto required = std::ranges::count(
+      expected_reflections, false, &expected_reflection::generated);
+    return failed == 0 and checked_in == static_cast<uint32_t>(required);
+}
+
+int
+main() {
+    const std::filesystem::path samples = "shader_samples";
+
+    bool passed = verify_reflection(samples);
+    passed = benchmark_compiler(samples) and passed;
+
+    return passed ? 0 : -1;
+}
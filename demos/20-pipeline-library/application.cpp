@@ -0,0 +1,264 @@
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <print>
+#include <span>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <expected>
+
+import vk;
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL
+debug_callback(
+  [[maybe_unused]] VkDebugUtilsMessageSeverityFlagBitsEXT p_message_severity,
+  [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT p_message_type,
+  const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
+  [[maybe_unused]] void* p_user_data) {
+    std::print("validation layer:\t\t{}\n\n", p_callback_data->pMessage);
+    return false;
+}
+
+//! @brief Rasterization and blend state of one benchmarked pipeline
+struct pipeline_variant {
+    vk::cull_mode cull = vk::cull_mode::none;
+    vk::front_face face = vk::front_face::counter_clockwise;
+    bool blend = true;
+};
+
+//! @return every combination of cull mode, front face and blending
+std::vector<pipeline_variant>
+collect_variants() {
+    std::vector<pipeline_variant> variants;
+    for (vk::cull_mode cull : { vk::cull_mode::none,
+                                vk::cull_mode::front_bit,
+                                vk::cull_mode::back_bit }) {
+        for (vk::front_face face : { vk::front_face::counter_clockwise,
+                                     vk::front_face::clockwise }) {
+            for (bool blend : { true, false }) {
+                variants.push_back(
+                  { .cull = cull, .face = face, .blend = blend });
+            }
+        }
+    }
+    return variants;
+}
+
+double
+elapsed_ms(std::chrono::steady_clock::time_point p_start) {
+    return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - p_start)
+      .count();
+}
+
+int
+main() {
+    std::array<const char*, 1> validation_layers = {
+        "VK_LAYER_KHRONOS_validation",
+    };
+
+    std::vector<const char*> global_extensions = {
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    };
+#if defined(__APPLE__)
+    global_extensions.emplace_back(
+      VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+
+    vk::debug_message_utility debug_callback_info = {
+        .severity = vk::message::warning | vk::message::error,
+        .message_type =
+          vk::debug::general | vk::debug::validation | vk::debug::performance,
+        .callback = debug_callback
+    };
+
+    vk::application_params config = {
+        .name = "vulkan instance",
+        .version = vk::api_version::vk_1_3,
+        .validations = validation_layers,
+        .extensions = global_extensions,
+    };
+
+    vk::instance api_instance(config, debug_callback_info);
+
+    // Prefers lavapipe as demo 18 does, which supports pipeline libraries
+    std::expected<vk::physical_device, VkResult> physical_device_expected =
+      api_instance.enumerate_physical_device(vk::physical_gpu::type_cpu);
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::integrated);
+    }
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::discrete);
+    }
+    if (!physical_device_expected) {
+        std::println("No physical device found");
+        return -1;
+    }
+    vk::physical_device physical_device = physical_device_expected.value();
+
+    if (!physical_device.graphics_pipeline_library_supported()) {
+        std::println("graphicsPipelineLibrary is not supported, skipping");
+        return 0;
+    }
+
+    std::array<float, 1> priorities = { 0.f };
+    std::vector<const char*> extensions = {
+        VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+        VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+    };
+#if defined(__APPLE__)
+    extensions.emplace_back("VK_KHR_portability_subset");
+#endif
+
+    vk::device_features device_features{
+        vk::pipeline_library{ {
+          .graphicsPipelineLibrary = true,
+        } },
+    };
+
+    vk::device_params logical_device_params = {
+        .features = device_features.data(),
+        .queue_priorities = priorities,
+        .extensions = extensions,
+        .queue_family_index = 0,
+    };
+    vk::device logical_device(physical_device, logical_device_params);
+
+    std::array<vk::attachment, 1> renderpass_attachments = {
+        vk::attachment{
+          .format = VK_FORMAT_R8G8B8A8_UNORM,
+          .layout = vk::image_layout::color_optimal,
+          .samples = vk::sample_bit::count_1,
+          .load = vk::attachment_load::clear,
+          .store = vk::attachment_store::store,
+          .stencil_load = vk::attachment_load::dont_care,
+          .stencil_store = vk::attachment_store::dont_care,
+          .initial_layout = vk::image_layout::undefined,
+          .final_layout = vk::image_layout::color_optimal,
+        },
+    };
+    vk::renderpass main_renderpass(logical_device, renderpass_attachments);
+
+    std::array<vk::shader_source, 2> shader_sources = {
+        vk::shader_source{
+          .filename = "shader_samples/sample1/test.vert.spv",
+          .stage = vk::shader_stage::vertex,
+        },
+        vk::shader_source{
+          .filename = "shader_samples/sample1/test.frag.spv",
+          .stage = vk::shader_stage::fragment,
+        },
+    };
+    vk::shader_resource_info shader_info = {
+        .sources = shader_sources,
+    };
+    vk::shader_resource geometry_resource(logical_device, shader_info);
+    if (!geometry_resource.is_valid()) {
+        std::println("shader_samples/sample1 could not be loaded");
+        return -1;
+    }
+
+    const std::vector<pipeline_variant> variants = collect_variants();
+    std::array<vk::color_blend_attachment_state, 1> blended = {
+        vk::color_blend_attachment_state{ .blend_enabled = true },
+    };
+    std::array<vk::color_blend_attachment_state, 1> opaque = {
+        vk::color_blend_attachment_state{ .blend_enabled = false },
+    };
+
+    auto params_of = [&](const pipeline_variant& p_variant,
+                         const vk::shader_resource& p_shaders) {
+        return vk::pipeline_params{
+            .renderpass = main_renderpass,
+            .shader_modules = p_shaders.handles(),
+            .vertex_attributes = p_shaders.vertex_attributes(),
+            .vertex_bind_attributes = p_shaders.vertex_bind_attributes(),
+            .rasterization = {
+                .cull_mode = p_variant.cull,
+                .front_face = p_variant.face,
+            },
+            .color_blend = {
+                .attachments = p_variant.blend ? blended : opaque,
+            },
+        };
+    };
+
+    // Monolithic vkCreateGraphicsPipelines of every variant, the baseline
+    std::vector<vk::pipeline> monolithic;
+    auto start = std::chrono::steady_clock::now();
+    for (const pipeline_variant& variant : variants) {
+        monolithic.emplace_back(logical_device,
+                                params_of(variant, geometry_resource));
+    }
+    const double monolithic_ms = elapsed_ms(start);
+
+    vk::pipeline_library_cache pipelines(logical_device);
+    bool passed = true;
+    for (const pipeline_variant& variant : variants) {
+        if (!pipelines.get(params_of(variant, geometry_resource)).alive()) {
+            passed = false;
+        }
+    }
+
+    // Waits for the background thread to relink every variant
+    uint32_t swapped = 0;
+    uint64_t frame = 0;
+    start = std::chrono::steady_clock::now();
+    while (swapped < variants.size() and elapsed_ms(start) < 10'000.0) {
+        swapped += pipelines.apply(frame++);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The same SPIR-V loaded again gets new modules, yet the same pipelines
+    vk::shader_resource reloaded_resource(logical_device, shader_info);
+    for (const pipeline_variant& variant : variants) {
+        if (!pipelines.get(params_of(variant, reloaded_resource)).optimized) {
+            passed = false;
+        }
+    }
+
+    const vk::pipeline_library_stats stats = pipelines.stats();
+    const auto count = static_cast<double>(variants.size());
+    std::println(
+      "{} pipelines, {} parts", variants.size(), stats.parts_created);
+    std::println("  monolithic      {:8.3f} ms per pipeline",
+                 monolithic_ms / count);
+    std::println("  fast link       {:8.3f} ms per pipeline",
+                 stats.fast_link_ms / static_cast<double>(stats.fast_links));
+    if (stats.optimized_links > 0) {
+        std::println(
+          "  optimized link  {:8.3f} ms per pipeline",
+          stats.optimized_link_ms / static_cast<double>(stats.optimized_links));
+    }
+    std::println("{} of {} optimized pipelines swapped in",
+                 swapped,
+                 variants.size());
+
+    // One vertex input and fragment shader part, a pre-rasterization part
+    // per cull mode and front face, and a fragment output per blend state
+    if (stats.fast_links != variants.size() or stats.parts_created != 10 or
+        swapped != variants.size()) {
+        passed = false;
+    }
+
+    logical_device.wait();
+
+    pipelines.destruct();
+    for (vk::pipeline& variant : monolithic) {
+        variant.destruct();
+    }
+    reloaded_resource.destruct();
+    geometry_resource.destruct();
+    main_renderpass.destruct();
+    logical_device.destruct();
+
+    if (!passed) {
+        std::println("pipeline_library_cache did not link every variant");
+        return -1;
+    }
+    return 0;
+}
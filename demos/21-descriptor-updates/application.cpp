@@ -0,0 +1,235 @@
+#include <vulkan/vulkan.h>
+
+#include <new>
+#include <array>
+#include <print>
+#include <span>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <expected>
+
+import vk;
+
+// Every operator new of the process, counted to measure the allocations
+// made by one descriptor update
+static std::atomic<uint64_t> allocations{ 0 };
+
+void*
+operator new(std::size_t p_size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(p_size == 0 ? 1 : p_size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p_memory) noexcept {
+    std::free(p_memory);
+}
+
+void
+operator delete(void* p_memory, std::size_t) noexcept {
+    std::free(p_memory);
+}
+
+//! @brief Time and allocations of one benchmarked update path
+struct update_result {
+    double ns_per_update = 0.0;
+    double allocations_per_update = 0.0;
+    bool updated = true;
+};
+
+/**
+ * @brief Runs p_update p_warmup times, then measures p_iterations more
+ *
+ * The warm-up lets scratch storage reach its capacity, so only allocations
+ * made on every update are counted.
+ */
+template<typename F>
+update_result
+measure(uint32_t p_warmup, uint32_t p_iterations, F&& p_update) {
+    update_result result;
+    for (uint32_t i = 0; i < p_warmup; i++) {
+        result.updated = p_update() and result.updated;
+    }
+
+    const uint64_t first = allocations.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < p_iterations; i++) {
+        result.updated = p_update() and result.updated;
+    }
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+    const uint64_t last = allocations.load(std::memory_order_relaxed);
+
+    result.ns_per_update = elapsed_ns / p_iterations;
+    result.allocations_per_update =
+      static_cast<double>(last - first) / p_iterations;
+    return result;
+}
+
+int
+main() {
+    // No validation layers, they allocate inside the very calls counted and
+    // timed here
+    std::vector<const char*> global_extensions;
+#if defined(__APPLE__)
+    global_extensions.emplace_back(
+      VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+
+    vk::application_params config = {
+        .name = "vulkan instance",
+        .version = vk::api_version::vk_1_3,
+        .extensions = global_extensions,
+    };
+
+    vk::instance api_instance(config, vk::debug_message_utility{});
+
+    std::expected<vk::physical_device, VkResult> physical_device_expected =
+      api_instance.enumerate_physical_device(vk::physical_gpu::type_cpu);
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::integrated);
+    }
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::discrete);
+    }
+    if (!physical_device_expected) {
+        std::println("No physical device found");
+        return -1;
+    }
+    vk::physical_device physical_device = physical_device_expected.value();
+
+    std::array<float, 1> priorities = { 0.f };
+#if defined(__APPLE__)
+    std::array<const char*, 1> extensions = { "VK_KHR_portability_subset" };
+#else
+    std::span<const char*> extensions{};
+#endif
+
+    vk::device_params logical_device_params = {
+        .queue_priorities = priorities,
+        .extensions = extensions,
+        .queue_family_index = 0,
+    };
+    vk::device logical_device(physical_device, logical_device_params);
+
+    // A camera, four lights and two material blocks, as a lit pass binds
+    std::array<vk::descriptor_entry, 3> entries = {
+        vk::descriptor_entry{
+          .type = vk::descriptor_type::uniform,
+          .binding_point = { .binding = 0,
+                             .stage = vk::shader_stage::vertex },
+          .descriptor_count = 1,
+        },
+        vk::descriptor_entry{
+          .type = vk::descriptor_type::uniform,
+          .binding_point = { .binding = 1,
+                             .stage = vk::shader_stage::fragment },
+          .descriptor_count = 4,
+        },
+        vk::descriptor_entry{
+          .type = vk::descriptor_type::uniform,
+          .binding_point = { .binding = 2,
+                             .stage = vk::shader_stage::fragment },
+          .descriptor_count = 2,
+        },
+    };
+    vk::descriptor_layout layout = {
+        .slot = 0,
+        .max_sets = 1,
+        .entries = entries,
+    };
+    vk::descriptor_resource set0(logical_device, layout);
+    vk::descriptor_update_template set0_template(
+      logical_device, set0.layout(), entries);
+
+    // One 256 byte block per descriptor, 256 being the largest
+    // minUniformBufferOffsetAlignment allowed
+    constexpr uint32_t block_size = 256;
+    constexpr uint32_t descriptor_count = 7;
+    vk::buffer_parameters uniform_params = {
+        .memory_mask = physical_device.memory_properties(
+          static_cast<vk::memory_property>(
+            vk::memory_property::host_visible_bit |
+            vk::memory_property::host_coherent_bit)),
+        .usage = vk::buffer_usage::uniform_buffer_bit,
+    };
+    vk::uniform_buffer blocks(
+      logical_device, block_size * descriptor_count, uniform_params);
+
+    std::array<vk::write_buffer, descriptor_count> buffers{};
+    for (uint32_t i = 0; i < descriptor_count; i++) {
+        buffers[i] = { .buffer = blocks,
+                       .offset = i * block_size,
+                       .range = block_size };
+    }
+
+    const std::span<const vk::write_buffer> all = buffers;
+    std::array<vk::write_buffer_descriptor, 3> writes = {
+        vk::write_buffer_descriptor{ .dst_binding = 0,
+                                     .uniforms = all.subspan(0, 1) },
+        vk::write_buffer_descriptor{ .dst_binding = 1,
+                                     .uniforms = all.subspan(1, 4) },
+        vk::write_buffer_descriptor{ .dst_binding = 2,
+                                     .uniforms = all.subspan(5, 2) },
+    };
+
+    constexpr uint32_t warmup = 100;
+    constexpr uint32_t iterations = 100'000;
+
+    // One VkWriteDescriptorSet per binding, built in the resource's scratch
+    // storage
+    const update_result write_sets = measure(warmup, iterations, [&]() {
+        set0.update(writes);
+        return true;
+    });
+
+    // The writer is filled on the stack on every update, as a frame would
+    const update_result with_template = measure(warmup, iterations, [&]() {
+        vk::descriptor_writer<descriptor_count> writer;
+        for (uint32_t i = 0; i < 4; i++) {
+            writer.write(set0_template.slot(1, i), buffers[1 + i]);
+        }
+        writer.write(set0_template.slot(0), buffers[0]);
+        writer.write(set0_template.slot(2, 0), buffers[5]);
+        writer.write(set0_template.slot(2, 1), buffers[6]);
+        return set0.update(set0_template, writer);
+    });
+
+    std::println("{} updates of {} descriptors in 3 bindings",
+                 iterations,
+                 descriptor_count);
+    std::println("  vkUpdateDescriptorSets          {:8.1f} ns, {:.2f} "
+                 "allocations per update",
+                 write_sets.ns_per_update,
+                 write_sets.allocations_per_update);
+    std::println("  descriptor_update_template      {:8.1f} ns, {:.2f} "
+                 "allocations per update",
+                 with_template.ns_per_update,
+                 with_template.allocations_per_update);
+
+    logical_device.wait();
+
+    set0_template.destruct();
+    blocks.destruct();
+    set0.destruct();
+    logical_device.destruct();
+
+    if (!with_template.updated) {
+        std::println("descriptor_update_template did not update the set");
+        return -1;
+    }
+    if (with_template.allocations_per_update > 0.0) {
+        std::println("descriptor_update_template allocated while updating");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <bit>
+#include <print>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <expected>
+
+import vk;
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL
+debug_callback(
+  [[maybe_unused]] VkDebugUtilsMessageSeverityFlagBitsEXT p_message_severity,
+  [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT p_message_type,
+  const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
+  [[maybe_unused]] void* p_user_data) {
+    std::print("validation layer:\t\t{}\n\n", p_callback_data->pMessage);
+    return false;
+}
+
+/**
+ * @brief RGBA8 texture with a full mip chain laid out as a KTX2 file stores
+ * it, smallest level first, each level filled with its own shade
+ */
+vk::ktx2_texture
+synthetic_texture(uint32_t p_size) {
+    vk::ktx2_texture texture{
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { .width = p_size, .height = p_size, .depth = 1 },
+        .mip_levels = static_cast<uint32_t>(std::bit_width(p_size)),
+    };
+    texture.regions.resize(texture.mip_levels);
+    for (uint32_t level = texture.mip_levels; level-- > 0;) {
+        texture.regions[level] =
+          vk::copy_region(texture.extent, level, texture.bytes.size());
+        texture.bytes.resize(
+          texture.bytes.size() +
+            vk::image_level_size(texture.format, texture.extent, level),
+          static_cast<uint8_t>(255 - (level * 16)));
+    }
+    return texture;
+}
+
+//! @return bytes of every level of p_texture, as resident at level 0
+uint64_t
+full_size(const vk::ktx2_texture& p_texture) {
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < p_texture.mip_levels; level++) {
+        size += vk::image_level_size(p_texture.format, p_texture.extent, level);
+    }
+    return size;
+}
+
+int
+main() {
+    std::array<const char*, 1> validation_layers = {
+        "VK_LAYER_KHRONOS_validation",
+    };
+
+    std::vector<const char*> global_extensions = {
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    };
+#if defined(__APPLE__)
+    global_extensions.emplace_back(
+      VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+
+    vk::debug_message_utility debug_callback_info = {
+        .severity = vk::message::warning | vk::message::error,
+        .message_type =
+          vk::debug::general | vk::debug::validation | vk::debug::performance,
+        .callback = debug_callback
+    };
+
+    vk::application_params config = {
+        .name = "vulkan instance",
+        .version = vk::api_version::vk_1_3,
+        .validations = validation_layers,
+        .extensions = global_extensions,
+    };
+
+    vk::instance api_instance(config, debug_callback_info);
+
+    std::expected<vk::physical_device, VkResult> physical_device_expected =
+      api_instance.enumerate_physical_device(vk::physical_gpu::type_cpu);
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::integrated);
+    }
+    if (!physical_device_expected) {
+        physical_device_expected =
+          api_instance.enumerate_physical_device(vk::physical_gpu::discrete);
+    }
+    if (!physical_device_expected) {
+        std::println("No physical device found");
+        return -1;
+    }
+    vk::physical_device physical_device = physical_device_expected.value();
+
+    std::array<float, 1> priorities = { 0.f };
+#if defined(__APPLE__)
+    std::array<const char*, 1> extensions = { "VK_KHR_portability_subset" };
+#else
+    std::span<const char*> extensions{};
+#endif
+
+    vk::device_params logical_device_params = {
+        .queue_priorities = priorities,
+        .extensions = extensions,
+        .queue_family_index = 0,
+    };
+    vk::device logical_device(physical_device, logical_device_params);
+
+    // Four 256x256 textures with a 16x16 mip tail, under a synthetic budget
+    // of one and a half fully resident textures
+    constexpr uint32_t texture_count = 4;
+    const uint64_t full = full_size(synthetic_texture(256));
+    const uint64_t budget = full + (full / 2);
+
+    vk::texture_streamer streamer(
+      logical_device,
+      physical_device,
+      nullptr,
+      vk::streaming_params{
+        .budget_bytes = budget,
+        .mip_tail_size = 16,
+        .memory_mask = physical_device.memory_properties(
+          vk::memory_property::device_local_bit),
+        .staging_memory_mask = physical_device.memory_properties(
+          static_cast<vk::memory_property>(
+            vk::memory_property::host_visible_bit |
+            vk::memory_property::host_coherent_bit)),
+      });
+
+    std::array<uint32_t, texture_count> handles{};
+    for (uint32_t i = 0; i < texture_count; i++) {
+        handles[i] = streamer.add(synthetic_texture(256), i);
+    }
+
+    bool passed = true;
+    uint64_t frame = 0;
+    // Requests p_handle at level 0, updates, then prints the residency
+    auto stream_frame = [&](uint32_t p_handle) {
+        streamer.request(handles[p_handle], 0);
+        streamer.update(++frame);
+
+        std::array<uint32_t, texture_count> levels{};
+        for (uint32_t i = 0; i < texture_count; i++) {
+            levels[i] = streamer.resident_level(handles[i]);
+        }
+        std::println("frame {}: request {}, resident levels [{}, {}, {}, {}], "
+                     "{} of {} bytes",
+                     frame,
+                     p_handle,
+                     levels[0],
+                     levels[1],
+                     levels[2],
+                     levels[3],
+                     streamer.resident_bytes(),
+                     budget);
+        if (streamer.resident_bytes() > budget) {
+            passed = false;
+        }
+        return levels;
+    };
+
+    // Mip tails are resident from the first update and never evicted
+    const std::array<uint32_t, texture_count> first = stream_frame(0);
+    const uint32_t tail = first[2];
+    passed = passed and first[0] == 0 and tail == 4 and first[3] == tail;
+
+    // Texture 1 does not fit beside texture 0, so the least recently used
+    // texture 0 drops back, then streams in again as far as the budget allows
+    const std::array<uint32_t, texture_count> second = stream_frame(1);
+    passed = passed and second[1] == 0 and second[0] > 0 and
+             second[0] < tail;
+
+    // Requesting texture 0 again evicts texture 1 and reloads level 0
+    const std::array<uint32_t, texture_count> third = stream_frame(0);
+    passed = passed and third[0] == 0 and third[1] > 0 and third[1] < tail;
+
+    passed = passed and third[2] == tail and third[3] == tail;
+
+    logical_device.wait();
+
+    streamer.destruct();
+    logical_device.destruct();
+
+    if (!passed) {
+        std::println("texture_streamer did not evict or reload as expected");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,454 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+
+export module vk:bindless_table;
+
+export import :types;
+export import :utilities;
+export import :descriptor_layout_cache;
+
+export namespace vk {
+    inline namespace v6 {
+
+        //! @brief Index returned when a bindless array has no free slot left
+        constexpr uint32_t invalid_bindless_index = ~0u;
+
+        //! @brief The arrays of a vk::bindless_table, in binding order
+        enum class bindless_kind : uint8_t {
+            sampled_image = 0,  // layout(binding = 0) sampler2D []
+            storage_image = 1,  // layout(binding = 1) image2D []
+            storage_buffer = 2, // layout(binding = 2) buffer []
+        };
+
+        /**
+         * @param sampled_images is the capacity of the combined image
+         * sampler array
+         * @param storage_images is the capacity of the storage image array
+         * @param storage_buffers is the capacity of the storage buffer array
+         * @param stage are the shader stages allowed to index the arrays
+         * @param recycle_delay is the amount of next_frame() calls before a
+         * removed index can be handed out again, usually the frames in flight
+         */
+        struct bindless_table_params {
+            uint32_t sampled_images = 4096;
+            uint32_t storage_images = 1024;
+            uint32_t storage_buffers = 1024;
+            shader_stage stage = shader_stage::all;
+            uint32_t recycle_delay = 2;
+        };
+
+        /**
+         * @param in_use is the amount of indices handed out per array
+         * @param pending is the amount of removed indices waiting to be
+         * recycled per array
+         */
+        struct bindless_table_stats {
+            std::array<uint32_t, 3> in_use{};
+            std::array<uint32_t, 3> pending{};
+        };
+
+        /**
+         * @brief One descriptor set holding large arrays of every texture and
+         * buffer, indexed from shaders by handle
+         *
+         * Every binding is partially bound and update-after-bind, so indices
+         * are written while the set stays bound for the whole frame and draws
+         * only push the indices of their material instead of binding a set
+         * per material.
+         *
+         * Removed indices are not reused until recycle_delay frames later, as
+         * frames still in flight may read them.
+         *
+         * ```
+         *
+         *  add() --> free list --> next unused index --> invalid_bindless_index
+         *
+         *  remove(i) at frame N --> pending --next_frame() at N + delay--> free
+         *
+         * ```
+         *
+         * GLSL declaration of the set:
+         *
+         * ```
+         *
+         * #extension GL_EXT_nonuniform_qualifier : require
+         * layout(set = 1, binding = 0) uniform sampler2D textures[];
+         * layout(set = 1, binding = 1, rgba8) uniform image2D images[];
+         * layout(set = 1, binding = 2) buffer buffers { uint data[]; } b[];
+         *
+         * vec4 albedo = texture(textures[nonuniformEXT(material.albedo)], uv);
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::bindless_table bindless(logical_device, {});
+         *
+         * uint32_t albedo = bindless.add(vk::write_image{
+         *      .sampler = texture.image().sampler(),
+         *      .view = texture.image().image_view(),
+         *      .layout = vk::image_layout::shader_read_only_optimal,
+         * });
+         *
+         * // per frame, after waiting on the frame fence
+         * bindless.next_frame();
+         * bindless.bind(current, pipeline.layout(),
+         *      VK_PIPELINE_BIND_POINT_GRAPHICS, 1);
+         *
+         * ```
+         */
+        class bindless_table {
+        public:
+            bindless_table() = default;
+
+            bindless_table(const VkDevice& p_device,
+                           const bindless_table_params& p_params)
+              : m_device(p_device)
+              , m_params(p_params) {
+                m_arrays[0].capacity = std::max(p_params.sampled_images, 1u);
+                m_arrays[1].capacity = std::max(p_params.storage_images, 1u);
+                m_arrays[2].capacity = std::max(p_params.storage_buffers, 1u);
+                for (index_array& array : m_arrays) {
+                    array.handed_out.assign(array.capacity, false);
+                }
+
+                const descriptor_bind_flags flags =
+                  descriptor_bind_flags::partially_bound_bit |
+                  descriptor_bind_flags::update_after_bind |
+                  descriptor_bind_flags::update_unused_while_pending;
+
+                std::array<descriptor_entry, 3> entries = {
+                    descriptor_entry{
+                      .type = descriptor_type::combined_image_sampler,
+                      .binding_point = { .binding = 0,
+                                         .stage = p_params.stage },
+                      .descriptor_count = m_arrays[0].capacity,
+                      .flags = flags,
+                    },
+                    descriptor_entry{
+                      .type = descriptor_type::storage_image,
+                      .binding_point = { .binding = 1,
+                                         .stage = p_params.stage },
+                      .descriptor_count = m_arrays[1].capacity,
+                      .flags = flags,
+                    },
+                    descriptor_entry{
+                      .type = descriptor_type::storage,
+                      .binding_point = { .binding = 2,
+                                         .stage = p_params.stage },
+                      .descriptor_count = m_arrays[2].capacity,
+                      .flags = flags,
+                    },
+                };
+
+                m_descriptor_layout = create_descriptor_set_layout(
+                  m_device,
+                  entries,
+                  descriptor_layout_flags::update_after_bind_pool);
+
+                std::array<VkDescriptorPoolSize, 3> pool_sizes;
+                for (size_t i = 0; i < entries.size(); i++) {
+                    pool_sizes[i] = {
+                        .type = static_cast<VkDescriptorType>(entries[i].type),
+                        .descriptorCount = entries[i].descriptor_count,
+                    };
+                }
+
+                VkDescriptorPoolCreateInfo pool_ci = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+                    .maxSets = 1,
+                    .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+                    .pPoolSizes = pool_sizes.data()
+                };
+
+                vk_check(vkCreateDescriptorPool(
+                           m_device, &pool_ci, nullptr, &m_descriptor_pool),
+                         "vkCreateDescriptorPool");
+
+                VkDescriptorSetAllocateInfo descriptor_set_alloc_info = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                    .pNext = nullptr,
+                    .descriptorPool = m_descriptor_pool,
+                    .descriptorSetCount = 1,
+                    .pSetLayouts = &m_descriptor_layout
+                };
+
+                vk_check(vkAllocateDescriptorSets(m_device,
+                                                  &descriptor_set_alloc_info,
+                                                  &m_descriptor_set),
+                         "vkAllocateDescriptorSets");
+            }
+
+            bindless_table(const bindless_table&) = delete;
+            bindless_table& operator=(const bindless_table&) = delete;
+
+            /**
+             * @brief Writes a combined image sampler into a free index of the
+             * sampled image array
+             *
+             * @return the index for shaders, or invalid_bindless_index when
+             * the array is full
+             */
+            [[nodiscard]] uint32_t add(const write_image& p_image) {
+                std::scoped_lock lock(m_mutex);
+                uint32_t index = acquire(bindless_kind::sampled_image);
+                if (index != invalid_bindless_index) {
+                    write(bindless_kind::sampled_image, index, p_image);
+                }
+                return index;
+            }
+
+            /**
+             * @brief Writes a storage image, which must be in
+             * image_layout::general, into a free index of the storage image
+             * array
+             */
+            [[nodiscard]] uint32_t add_storage_image(
+              const write_image& p_image) {
+                std::scoped_lock lock(m_mutex);
+                uint32_t index = acquire(bindless_kind::storage_image);
+                if (index != invalid_bindless_index) {
+                    write(bindless_kind::storage_image, index, p_image);
+                }
+                return index;
+            }
+
+            //! @brief Writes a storage buffer into a free index of the storage
+            //! buffer array
+            [[nodiscard]] uint32_t add_storage_buffer(
+              const write_buffer& p_buffer) {
+                std::scoped_lock lock(m_mutex);
+                uint32_t index = acquire(bindless_kind::storage_buffer);
+                if (index == invalid_bindless_index) {
+                    return index;
+                }
+
+                VkDescriptorBufferInfo buffer_info = {
+                    .buffer = p_buffer.buffer,
+                    .offset = p_buffer.offset,
+                    .range =
+                      (p_buffer.range == 0) ? VK_WHOLE_SIZE : p_buffer.range,
+                };
+                VkWriteDescriptorSet write_descriptor = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = nullptr,
+                    .dstSet = m_descriptor_set,
+                    .dstBinding = 2,
+                    .dstArrayElement = index,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo = &buffer_info,
+                };
+                vkUpdateDescriptorSets(
+                  m_device, 1, &write_descriptor, 0, nullptr);
+                return index;
+            }
+
+            /**
+             * @brief Points an index of an image array at another image, such
+             * as a streamed texture gaining mips
+             *
+             * @return false, writing nothing, for the storage buffer array or
+             * an index that is not handed out
+             */
+            bool replace(bindless_kind p_kind,
+                         uint32_t p_index,
+                         const write_image& p_image) {
+                if (p_kind == bindless_kind::storage_buffer) {
+                    return false;
+                }
+                std::scoped_lock lock(m_mutex);
+                if (!handed_out(p_kind, p_index)) {
+                    return false;
+                }
+                write(p_kind, p_index, p_image);
+                return true;
+            }
+
+            /**
+             * @brief Releases p_index of the p_kind array
+             *
+             * The index keeps its descriptor until it is recycled
+             * recycle_delay frames later, so in-flight frames still read a
+             * valid resource.
+             *
+             * @return false, releasing nothing, if p_index is out of range or
+             * was already removed
+             */
+            bool remove(bindless_kind p_kind, uint32_t p_index) {
+                std::scoped_lock lock(m_mutex);
+                if (!handed_out(p_kind, p_index)) {
+                    return false;
+                }
+                index_array& array = m_arrays[static_cast<size_t>(p_kind)];
+                array.handed_out[p_index] = false;
+                array.pending.push_back(
+                  { .index = p_index,
+                    .frame = m_frame + m_params.recycle_delay });
+                array.in_use--;
+                return true;
+            }
+
+            /**
+             * @brief Advances the frame counter and recycles the indices
+             * removed recycle_delay frames ago
+             *
+             * Called once per frame after waiting on the oldest frame fence.
+             */
+            void next_frame() {
+                std::scoped_lock lock(m_mutex);
+                m_frame++;
+                for (index_array& array : m_arrays) {
+                    std::erase_if(array.pending,
+                                  [this, &array](const pending_index& p_pending) {
+                                      if (p_pending.frame > m_frame) {
+                                          return false;
+                                      }
+                                      array.free.push_back(p_pending.index);
+                                      return true;
+                                  });
+                }
+            }
+
+            //! @brief Binds the table to p_slot of p_pipeline_layout
+            void bind(const VkCommandBuffer& p_command,
+                      const VkPipelineLayout& p_pipeline_layout,
+                      uint64_t p_pipeline_bind_point,
+                      uint32_t p_slot) const {
+                vkCmdBindDescriptorSets(
+                  p_command,
+                  static_cast<VkPipelineBindPoint>(p_pipeline_bind_point),
+                  p_pipeline_layout,
+                  p_slot,
+                  1,
+                  &m_descriptor_set,
+                  0,
+                  nullptr);
+            }
+
+            [[nodiscard]] bindless_table_stats stats() const {
+                std::scoped_lock lock(m_mutex);
+                bindless_table_stats current{};
+                for (size_t i = 0; i < m_arrays.size(); i++) {
+                    current.in_use[i] = m_arrays[i].in_use;
+                    current.pending[i] =
+                      static_cast<uint32_t>(m_arrays[i].pending.size());
+                }
+                return current;
+            }
+
+            [[nodiscard]] VkDescriptorSetLayout layout() const {
+                return m_descriptor_layout;
+            }
+
+            [[nodiscard]] bool alive() const { return m_descriptor_set; }
+
+            void destruct() {
+                if (m_descriptor_pool != nullptr) {
+                    vkDestroyDescriptorPool(
+                      m_device, m_descriptor_pool, nullptr);
+                }
+
+                if (m_descriptor_layout != nullptr) {
+                    vkDestroyDescriptorSetLayout(
+                      m_device, m_descriptor_layout, nullptr);
+                }
+            }
+
+            operator VkDescriptorSet() const { return m_descriptor_set; }
+
+            operator VkDescriptorSet() { return m_descriptor_set; }
+
+        private:
+            struct pending_index {
+                uint32_t index = 0;
+                uint64_t frame = 0;
+            };
+
+            //! @brief Free list allocator of one array
+            struct index_array {
+                uint32_t capacity = 0;
+                uint32_t next = 0;
+                uint32_t in_use = 0;
+                std::vector<uint32_t> free;
+                std::vector<pending_index> pending;
+                // Whether each index is currently handed out
+                std::vector<bool> handed_out;
+            };
+
+            //! @return true if p_index of the p_kind array is in use
+            [[nodiscard]] bool handed_out(bindless_kind p_kind,
+                                          uint32_t p_index) const {
+                const index_array& array =
+                  m_arrays[static_cast<size_t>(p_kind)];
+                return p_index < array.capacity and array.handed_out[p_index];
+            }
+
+            uint32_t acquire(bindless_kind p_kind) {
+                index_array& array = m_arrays[static_cast<size_t>(p_kind)];
+
+                uint32_t index = invalid_bindless_index;
+                if (!array.free.empty()) {
+                    index = array.free.back();
+                    array.free.pop_back();
+                }
+                else if (array.next < array.capacity) {
+                    index = array.next++;
+                }
+                else {
+                    return invalid_bindless_index;
+                }
+
+                array.in_use++;
+                array.handed_out[index] = true;
+                return index;
+            }
+
+            void write(bindless_kind p_kind,
+                       uint32_t p_index,
+                       const write_image& p_image) {
+                VkDescriptorImageInfo image_info = {
+                    .sampler = p_image.sampler,
+                    .imageView = p_image.view,
+                    .imageLayout = static_cast<VkImageLayout>(p_image.layout),
+                };
+                VkWriteDescriptorSet write_descriptor = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = nullptr,
+                    .dstSet = m_descriptor_set,
+                    .dstBinding = static_cast<uint32_t>(p_kind),
+                    .dstArrayElement = p_index,
+                    .descriptorCount = 1,
+                    .descriptorType =
+                      (p_kind == bindless_kind::storage_image)
+                        ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                        : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo = &image_info,
+                };
+                vkUpdateDescriptorSets(
+                  m_device, 1, &write_descriptor, 0, nullptr);
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            bindless_table_params m_params{};
+            VkDescriptorPool m_descriptor_pool = nullptr;
+            VkDescriptorSetLayout m_descriptor_layout = nullptr;
+            VkDescriptorSet m_descriptor_set = nullptr;
+            mutable std::mutex m_mutex;
+            std::array<index_array, 3> m_arrays{};
+            uint64_t m_frame = 0;
+        };
+    };
+};
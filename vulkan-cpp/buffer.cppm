@@ -57,6 +57,7 @@ export namespace vk {
                 vk_check(
                   vkCreateBuffer(m_device, &buffer_ci, nullptr, &m_handle),
                   "vkCreateBuffer");
+                m_size = p_device_size;
 
                 // retrieving buffer memory requirements
                 VkMemoryRequirements memory_requirements = {};
@@ -282,7 +283,80 @@ export namespace vk {
                   image_copies.data());
             }
 
+            /**
+             * @brief Copies regions of an image into this buffer. The reverse
+             * of copy_to_image, used to read GPU results back to the host.
+             *
+             * @brief Additional Considerations:
+             * - p_image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+             * - this buffer must have vk::buffer_usage::transfer_dst_bit set
+             */
+            void copy_from_image(const VkCommandBuffer& p_command,
+                                 const VkImage& p_image,
+                                 std::span<const buffer_image_copy> p_copies) {
+                std::vector<VkBufferImageCopy> image_copies(p_copies.size());
+
+                for (uint32_t i = 0; i < image_copies.size(); i++) {
+                    const buffer_image_copy image_copy = p_copies[i];
+                    image_copies[i] = {
+                        .bufferOffset = image_copy.offset,
+                        .bufferRowLength = image_copy.row_length,
+                        .bufferImageHeight = image_copy.image_height,
+                        .imageSubresource = {
+                            .aspectMask = static_cast<VkImageAspectFlags>(image_copy.aspect_mask),
+                            .mipLevel = image_copy.mip_level,
+                            .baseArrayLayer = image_copy.base_array_layer,
+                            .layerCount = image_copy.layer_count,
+                        },
+                        .imageOffset = { static_cast<int32_t>(image_copy.image_offset.width), static_cast<int32_t>(image_copy.image_offset.height), static_cast<int32_t>(image_copy.image_offset.depth), },
+                        .imageExtent = { image_copy.image_extent.width, image_copy.image_extent.height, image_copy.image_extent.depth, },
+                    };
+                }
+
+                vkCmdCopyImageToBuffer(
+                  p_command,
+                  p_image,
+                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                  m_handle,
+                  static_cast<uint32_t>(image_copies.size()),
+                  image_copies.data());
+            }
+
+            /**
+             * @brief Persistently maps the entire buffer memory
+             *
+             * The memory must be host-visible and host-coherent. The mapping
+             * stays valid until unmap() or destruct(), so transfer() must not
+             * be used while mapped.
+             *
+             * @return the mapped bytes of the buffer
+             */
+            [[nodiscard]] std::span<uint8_t> map() {
+                if (m_mapped == nullptr) {
+                    vk_check(vkMapMemory(m_device,
+                                         m_device_memory,
+                                         0,
+                                         VK_WHOLE_SIZE,
+                                         0,
+                                         reinterpret_cast<void**>(&m_mapped)),
+                             "vkMapMemory");
+                }
+                return std::span<uint8_t>(m_mapped, m_size);
+            }
+
+            void unmap() {
+                if (m_mapped != nullptr) {
+                    vkUnmapMemory(m_device, m_device_memory);
+                    m_mapped = nullptr;
+                }
+            }
+
+            //! @return size in bytes the buffer was created with
+            [[nodiscard]] uint64_t size_bytes() const { return m_size; }
+
             void destruct() {
+                unmap();
+
                 if (m_handle != nullptr) {
                     vkDestroyBuffer(m_device, m_handle, nullptr);
                 }
@@ -298,8 +372,10 @@ export namespace vk {
 
         private:
             VkDevice m_device = nullptr;
-            VkBuffer m_handle;
-            VkDeviceMemory m_device_memory;
+            VkBuffer m_handle = nullptr;
+            VkDeviceMemory m_device_memory = nullptr;
+            uint64_t m_size = 0;
+            uint8_t* m_mapped = nullptr;
         };
     };
 };
\ No newline at end of file
@@ -3,15 +3,22 @@ module;
 #include <span>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <array>
 #include <print>
 
 export module vk:command_buffer;
 
 export import :types;
 export import :utilities;
+export import :descriptor_update_template;
 
 export namespace vk {
     inline namespace v6 {
+        //! @brief Maximum descriptors pushed by one
+        //! command_buffer::push_descriptors call, the common
+        //! maxPushDescriptors limit
+        constexpr uint32_t max_push_descriptors = 32;
+
         struct command_inherit_info {
             VkRenderPass renderpass = nullptr;
             uint32_t subpass_index = 0;
@@ -501,6 +508,174 @@ export namespace vk {
                   p_dynamic_offsets.data());
             }
 
+            /**
+             * @brief Pushes descriptors straight into the command buffer for
+             * set p_slot, without allocating or updating a descriptor set
+             *
+             * Meant for small per-draw transient bindings. The layout at
+             * p_slot of p_pipeline_layout must be created with
+             * descriptor_layout_flags::push_descriptor (through
+             * vk::create_descriptor_set_layout or vk::descriptor_layout_cache,
+             * as there is no set to allocate) and the
+             * VK_KHR_push_descriptor extension enabled. The descriptor type of
+             * each write is read from its .type field.
+             *
+             * At most max_push_descriptors descriptors are pushed per call,
+             * built on the stack.
+             *
+             * @return false, pushing nothing, if more than
+             * max_push_descriptors descriptors or writes are given
+             *
+             * Example Usage:
+             *
+             * ```C++
+             *
+             * std::array<vk::write_buffer, 1> object = {
+             *      vk::write_buffer{ .buffer = object_ubo, .range = 64 },
+             * };
+             * std::array<vk::write_buffer_descriptor, 1> writes = {
+             *      vk::write_buffer_descriptor{
+             *          .dst_binding = 0,
+             *          .uniforms = object,
+             *      },
+             * };
+             * current.push_descriptors(pipeline.layout(),
+             *      VK_PIPELINE_BIND_POINT_GRAPHICS, 2, writes);
+             * ```
+             */
+            bool push_descriptors(
+              const VkPipelineLayout& p_pipeline_layout,
+              uint64_t p_pipeline_bind_point,
+              uint32_t p_slot,
+              std::span<const write_buffer_descriptor> p_buffers,
+              std::span<const write_image_descriptor> p_images = {}) {
+                load_push_descriptors();
+
+                std::array<VkWriteDescriptorSet, max_push_descriptors> writes;
+                std::array<VkDescriptorBufferInfo, max_push_descriptors>
+                  buffer_infos;
+                std::array<VkDescriptorImageInfo, max_push_descriptors>
+                  image_infos;
+                uint32_t write_count = 0;
+                uint32_t buffer_count = 0;
+                uint32_t image_count = 0;
+
+                for (const auto& ubo : p_buffers) {
+                    if (write_count == max_push_descriptors or
+                        buffer_count + ubo.uniforms.size() >
+                          max_push_descriptors) {
+                        return false;
+                    }
+
+                    const uint32_t first = buffer_count;
+                    for (const auto& uniform : ubo.uniforms) {
+                        buffer_infos[buffer_count++] = {
+                            .buffer = uniform.buffer,
+                            .offset = uniform.offset,
+                            .range = uniform.range,
+                        };
+                    }
+
+                    writes[write_count++] = {
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .pNext = nullptr,
+                        .dstSet = nullptr,
+                        .dstBinding = ubo.dst_binding,
+                        .dstArrayElement = ubo.dst_array_element,
+                        .descriptorCount =
+                          static_cast<uint32_t>(ubo.uniforms.size()),
+                        .descriptorType =
+                          static_cast<VkDescriptorType>(ubo.type),
+                        .pBufferInfo = buffer_infos.data() + first,
+                    };
+                }
+
+                for (const auto& image : p_images) {
+                    if (write_count == max_push_descriptors or
+                        image_count + image.sample_images.size() >
+                          max_push_descriptors) {
+                        return false;
+                    }
+
+                    const uint32_t first = image_count;
+                    for (const auto& sample_image : image.sample_images) {
+                        image_infos[image_count++] = {
+                            .sampler = sample_image.sampler,
+                            .imageView = sample_image.view,
+                            .imageLayout =
+                              static_cast<VkImageLayout>(sample_image.layout),
+                        };
+                    }
+
+                    writes[write_count++] = {
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .pNext = nullptr,
+                        .dstSet = nullptr,
+                        .dstBinding = image.dst_binding,
+                        .dstArrayElement = image.dst_array_element,
+                        .descriptorCount =
+                          static_cast<uint32_t>(image.sample_images.size()),
+                        .descriptorType =
+                          static_cast<VkDescriptorType>(image.type),
+                        .pImageInfo = image_infos.data() + first,
+                    };
+                }
+
+                m_push_descriptor_set(
+                  m_command_buffer,
+                  static_cast<VkPipelineBindPoint>(p_pipeline_bind_point),
+                  p_pipeline_layout,
+                  p_slot,
+                  write_count,
+                  writes.data());
+                return true;
+            }
+
+            /**
+             * @brief Pushes every descriptor of a push descriptor
+             * vk::descriptor_update_template in a single call
+             *
+             * p_template must be created with the pipeline layout constructor
+             * of vk::descriptor_update_template, which also fixes the bind
+             * point and set.
+             *
+             * @return false, pushing nothing, if p_infos holds fewer than
+             * p_template.descriptor_count() descriptors
+             *
+             * Example Usage:
+             *
+             * ```C++
+             *
+             * vk::descriptor_update_template per_draw(logical_device,
+             *      pipeline.layout(), VK_PIPELINE_BIND_POINT_GRAPHICS, 2,
+             *      per_draw_entries);
+             *
+             * vk::descriptor_writer<2> writer;
+             * writer.write(per_draw.slot(0), vk::write_buffer{...});
+             * writer.write(per_draw.slot(1), vk::write_image{...});
+             * current.push_descriptors(per_draw, pipeline.layout(), 2,
+             *      writer.data());
+             * ```
+             */
+            bool push_descriptors(
+              const descriptor_update_template& p_template,
+              const VkPipelineLayout& p_pipeline_layout,
+              uint32_t p_slot,
+              std::span<const descriptor_info> p_infos) {
+                load_push_descriptors();
+
+                if (p_infos.size() < p_template.descriptor_count()) {
+                    return false;
+                }
+
+                m_push_descriptor_set_with_template(m_command_buffer,
+                                                    p_template,
+                                                    p_pipeline_layout,
+                                                    p_slot,
+                                                    p_infos.data());
+                return true;
+            }
+
             /**
              * @brief Performs high-speed raw memory transfers between two
              * buffer handles.
@@ -560,6 +735,65 @@ export namespace vk {
                   m_command_buffer, p_src, p_dst, 1, &copy_region);
             }
 
+            /**
+             * @brief Records an indexed draw from the draw parameters
+             *
+             * Takes the same layout used for indirect draws, so draws produced
+             * by vk::mesh_lod::draw_command can be recorded directly.
+             */
+            void draw_indexed(const VkDrawIndexedIndirectCommand& p_draw) {
+                vkCmdDrawIndexed(m_command_buffer,
+                                 p_draw.indexCount,
+                                 p_draw.instanceCount,
+                                 p_draw.firstIndex,
+                                 p_draw.vertexOffset,
+                                 p_draw.firstInstance);
+            }
+
+            /**
+             * @brief Records indexed draws whose parameters are read from a
+             * buffer at execution time.
+             *
+             * @param p_buffer is the buffer containing tightly packed
+             * VkDrawIndexedIndirectCommand's
+             * @param p_offset is the byte offset of the first draw in p_buffer
+             * @param p_draw_count is the amount of draws to execute
+             * @param p_stride is the byte stride between each draw
+             *
+             * @brief Additional Considerations:
+             * - p_buffer must be created with
+             * vk::buffer_usage::indirect_buffer_bit
+             * - p_draw_count greater than 1 requires the multiDrawIndirect
+             * feature
+             */
+            void draw_indexed_indirect(
+              const VkBuffer& p_buffer,
+              uint64_t p_offset,
+              uint32_t p_draw_count,
+              uint32_t p_stride = sizeof(VkDrawIndexedIndirectCommand)) {
+                vkCmdDrawIndexedIndirect(m_command_buffer,
+                                         p_buffer,
+                                         p_offset,
+                                         p_draw_count,
+                                         p_stride);
+            }
+
+            /**
+             * @brief Records a compute dispatch of the bound compute pipeline
+             *
+             * @param p_group_count_x is the amount of workgroups along x
+             * @param p_group_count_y is the amount of workgroups along y
+             * @param p_group_count_z is the amount of workgroups along z
+             */
+            void dispatch(uint32_t p_group_count_x,
+                          uint32_t p_group_count_y = 1,
+                          uint32_t p_group_count_z = 1) {
+                vkCmdDispatch(m_command_buffer,
+                              p_group_count_x,
+                              p_group_count_y,
+                              p_group_count_z);
+            }
+
             [[nodiscard]] bool alive() const { return m_command_buffer; }
 
             /**
@@ -656,11 +890,30 @@ export namespace vk {
 
             operator VkCommandBuffer() { return m_command_buffer; }
 
+        private:
+            //! @brief Loads the VK_KHR_push_descriptor entry points on first
+            //! use
+            void load_push_descriptors() {
+                if (m_push_descriptor_set != nullptr) {
+                    return;
+                }
+                m_push_descriptor_set =
+                  reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(
+                    vkGetDeviceProcAddr(m_device, "vkCmdPushDescriptorSetKHR"));
+                m_push_descriptor_set_with_template =
+                  reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+                    vkGetDeviceProcAddr(
+                      m_device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+            }
+
         private:
             VkDevice m_device = nullptr;
             uint32_t m_begin_end_count = 0;
             VkCommandPool m_command_pool = nullptr;
             VkCommandBuffer m_command_buffer = nullptr;
+            PFN_vkCmdPushDescriptorSetKHR m_push_descriptor_set = nullptr;
+            PFN_vkCmdPushDescriptorSetWithTemplateKHR
+              m_push_descriptor_set_with_template = nullptr;
         };
     };
 };
\ No newline at end of file
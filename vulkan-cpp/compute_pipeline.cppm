@@ -0,0 +1,209 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+export module vk:compute_pipeline;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @param shader is the compute shader module. Its stage must be
+         * shader_stage::compute
+         * @param descriptor_layouts are the VkDescriptorSetLayout's the
+         * compute shader accesses, in set order
+         * @param push_constants are the push constant ranges used by the
+         * compute shader
+         * @param flags are the VkPipelineCreateFlags of the pipeline
+         * @param max_push_constants_size is the device maxPushConstantsSize
+         * the push constant ranges are validated against, 0 skips the check
+         * as in pipeline_params
+         */
+        struct compute_pipeline_params {
+            shader_handle shader{};
+            std::span<const VkDescriptorSetLayout> descriptor_layouts{};
+            std::span<const push_constant_range> push_constants{};
+            VkPipelineCreateFlags flags = 0;
+            uint32_t max_push_constants_size = 0;
+        };
+
+        /**
+         * @brief compute_pipeline represents a vulkan compute pipeline
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::compute_pipeline_params params = {
+         *      .shader = compute_shader.handles()[0],
+         *      .descriptor_layouts = layouts,
+         * };
+         * vk::compute_pipeline blur(logical_device, params);
+         *
+         * blur.bind(current);
+         * current.bind_descriptors(blur.layout(),
+         *      VK_PIPELINE_BIND_POINT_COMPUTE, sets);
+         * current.dispatch(group_x, group_y);
+         *
+         * ```
+         */
+        class compute_pipeline {
+        public:
+            compute_pipeline() = default;
+
+            compute_pipeline(const VkDevice& p_device,
+                             const compute_pipeline_params& p_params)
+              : m_device(p_device) {
+                configure(p_params);
+            }
+
+            //! @brief Creates the VkPipelineLayout and VkPipeline handles,
+            //! none if the push constants fail validate_push_constants
+            void configure(const compute_pipeline_params& p_params) {
+                if (!validate_push_constants(p_params.push_constants,
+                                             p_params.max_push_constants_size)) {
+                    return;
+                }
+
+                std::vector<VkPushConstantRange> push_constants(
+                  p_params.push_constants.size());
+
+                for (uint32_t i = 0; i < push_constants.size(); i++) {
+                    const push_constant_range data = p_params.push_constants[i];
+                    push_constants[i] = {
+                        .stageFlags =
+                          static_cast<VkShaderStageFlags>(data.stage),
+                        .offset = data.offset,
+                        .size = data.range,
+                    };
+                }
+
+                VkPipelineLayoutCreateInfo pipeline_layout_ci = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                    .setLayoutCount =
+                      static_cast<uint32_t>(p_params.descriptor_layouts.size()),
+                    .pSetLayouts = p_params.descriptor_layouts.data(),
+                    .pushConstantRangeCount =
+                      static_cast<uint32_t>(push_constants.size()),
+                    .pPushConstantRanges = push_constants.data(),
+                };
+
+                vk_check(
+                  vkCreatePipelineLayout(
+                    m_device, &pipeline_layout_ci, nullptr, &m_pipeline_layout),
+                  "vkCreatePipelineLayout");
+
+                // maintenance5: the module is created with the pipeline
+                VkShaderModuleCreateInfo inline_module = {
+                    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                    .codeSize = p_params.shader.code.size_bytes(),
+                    .pCode = p_params.shader.code.data(),
+                };
+                const bool is_inline = p_params.shader.module == nullptr and
+                                       !p_params.shader.code.empty();
+
+                const specialization_info& constants =
+                  p_params.shader.specialization;
+                VkSpecializationInfo specialization = {
+                    .mapEntryCount =
+                      static_cast<uint32_t>(constants.entries.size()),
+                    .pMapEntries =
+                      reinterpret_cast<const VkSpecializationMapEntry*>(
+                        constants.entries.data()),
+                    .dataSize = constants.data.size_bytes(),
+                    .pData = constants.data.data(),
+                };
+
+                VkComputePipelineCreateInfo compute_pipeline_ci = {
+                    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = p_params.flags,
+                    .stage = {
+                        .sType =
+                          VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                        .pNext = is_inline ? &inline_module : nullptr,
+                        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                        .module = p_params.shader.module,
+                        .pName = p_params.shader.entry_point,
+                        .pSpecializationInfo =
+                          constants.empty() ? nullptr : &specialization,
+                    },
+                    .layout = m_pipeline_layout,
+                    .basePipelineHandle = nullptr,
+                    .basePipelineIndex = -1,
+                };
+
+                vk_check(vkCreateComputePipelines(m_device,
+                                                  nullptr,
+                                                  1,
+                                                  &compute_pipeline_ci,
+                                                  nullptr,
+                                                  &m_pipeline),
+                         "vkCreateComputePipelines");
+            }
+
+            //! @brief Binds to VK_PIPELINE_BIND_POINT_COMPUTE of p_command
+            void bind(const VkCommandBuffer& p_command) {
+                vkCmdBindPipeline(
+                  p_command, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+            }
+
+            /**
+             * @brief Update values of push constants for the compute stage
+             *
+             * @tparam T is the type of the push constant
+             * @tparam max_size parameter for controlling max of bytes to send
+             */
+            template<typename T, size_t max_size = 128>
+            void push_constant(const VkCommandBuffer& p_current,
+                               const T& p_data,
+                               uint32_t p_offset = 0) {
+                static_assert(sizeof(T) <= max_size,
+                              "Type T exceeds max allowed size of bytes for "
+                              "push constants.");
+
+                vkCmdPushConstants(p_current,
+                                   m_pipeline_layout,
+                                   VK_SHADER_STAGE_COMPUTE_BIT,
+                                   p_offset,
+                                   sizeof(T),
+                                   &p_data);
+            }
+
+            //! @return true if m_pipeline is valid, false if invalid
+            [[nodiscard]] bool alive() const { return m_pipeline; }
+
+            //! @return the VkPipelineLayout handle
+            [[nodiscard]] VkPipelineLayout layout() const {
+                return m_pipeline_layout;
+            }
+
+            //! @brief explicit cleanup performed on vk::compute_pipeline
+            void destruct() {
+                if (m_pipeline_layout != nullptr) {
+                    vkDestroyPipelineLayout(
+                      m_device, m_pipeline_layout, nullptr);
+                }
+                if (m_pipeline != nullptr) {
+                    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+                }
+            }
+
+            operator VkPipeline() const { return m_pipeline; }
+
+            operator VkPipeline() { return m_pipeline; }
+
+        private:
+            VkDevice m_device = nullptr;
+            VkPipelineLayout m_pipeline_layout = nullptr;
+            VkPipeline m_pipeline = nullptr;
+        };
+    };
+};
@@ -0,0 +1,313 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+export module vk:descriptor_allocator;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Amount of descriptors of a type reserved per set in each pool
+         *
+         * A ratio of 2 for descriptor_type::uniform with 100 sets per pool
+         * gives every pool room for 200 uniform buffer descriptors.
+         */
+        struct pool_size_ratio {
+            descriptor_type type;
+            float ratio = 1.f;
+        };
+
+        //! @brief Ratios used when descriptor_allocator_params::ratios is empty
+        constexpr std::array<pool_size_ratio, 7> default_pool_ratios = {
+            pool_size_ratio{ .type = descriptor_type::combined_image_sampler,
+                             .ratio = 4.f },
+            pool_size_ratio{ .type = descriptor_type::uniform, .ratio = 2.f },
+            pool_size_ratio{ .type = descriptor_type::storage, .ratio = 2.f },
+            pool_size_ratio{ .type = descriptor_type::sampled_only_image,
+                             .ratio = 1.f },
+            pool_size_ratio{ .type = descriptor_type::storage_image,
+                             .ratio = 1.f },
+            pool_size_ratio{ .type = descriptor_type::sampler_only,
+                             .ratio = 1.f },
+            pool_size_ratio{ .type = descriptor_type::uniform_dynamic,
+                             .ratio = 1.f },
+        };
+
+        /**
+         * @param sets_per_pool is the amount of sets the first pool can hold
+         * @param growth_factor multiplies the size of each new pool created
+         * once every existing pool is full
+         * @param max_sets_per_pool caps the growth
+         * @param ratios are the descriptors reserved per set for each type
+         * @param flags must be descriptor_layout_flags::update_after_bind_pool
+         * to allocate sets with update-after-bind layouts
+         */
+        struct descriptor_allocator_params {
+            uint32_t sets_per_pool = 64;
+            float growth_factor = 1.5f;
+            uint32_t max_sets_per_pool = 4096;
+            std::span<const pool_size_ratio> ratios = default_pool_ratios;
+            descriptor_layout_flags flags = descriptor_layout_flags::none;
+        };
+
+        /**
+         * @param pools is the amount of VkDescriptorPool's created
+         * @param full_pools is the amount of pools that ran out of memory
+         * since the last reset
+         * @param sets_in_use is the amount of sets allocated since the last
+         * reset
+         * @param sets_allocated is the amount of sets allocated in total
+         * @param growths is the amount of times a pool was created because the
+         * others were full
+         * @param resets is the amount of times reset() was called
+         */
+        struct descriptor_allocator_stats {
+            uint32_t pools = 0;
+            uint32_t full_pools = 0;
+            uint64_t sets_in_use = 0;
+            uint64_t sets_allocated = 0;
+            uint32_t growths = 0;
+            uint64_t resets = 0;
+        };
+
+        /**
+         * @brief Allocates descriptor sets of any layout from a list of shared
+         * pools
+         *
+         * Unlike vk::descriptor_resource which creates a pool per set, sets
+         * are carved out of pools sized by a ratio per descriptor type. When
+         * a pool returns VK_ERROR_OUT_OF_POOL_MEMORY or
+         * VK_ERROR_FRAGMENTED_POOL it is marked full and the next pool is
+         * used, creating a larger one if there is none left.
+         *
+         * Sets are never freed individually. reset() returns every pool at
+         * once, so transient sets are allocated from one allocator per frame
+         * in flight and reset after that frame's fence has signaled.
+         *
+         * ```
+         *
+         *  ready:  [pool 2]                 full: [pool 0][pool 1]
+         *  current: pool 3 --allocate--> set, set, set ...
+         *
+         *  reset():  every pool --vkResetDescriptorPool--> ready
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * std::array<vk::descriptor_allocator, 2> frame_allocators = {...};
+         *
+         * // after waiting on the frame fence
+         * vk::descriptor_allocator& allocator = frame_allocators[frame];
+         * allocator.reset();
+         *
+         * VkDescriptorSet material_set = allocator.allocate(material_layout);
+         *
+         * ```
+         */
+        class descriptor_allocator {
+        public:
+            descriptor_allocator() = default;
+
+            descriptor_allocator(const VkDevice& p_device,
+                                 const descriptor_allocator_params& p_params =
+                                   {})
+              : m_device(p_device)
+              , m_params(p_params)
+              , m_sets_per_pool(std::max(p_params.sets_per_pool, 1u)) {
+                const std::span<const pool_size_ratio> ratios =
+                  p_params.ratios.empty()
+                    ? std::span<const pool_size_ratio>(default_pool_ratios)
+                    : p_params.ratios;
+                m_ratios.assign(ratios.begin(), ratios.end());
+            }
+
+            /**
+             * @brief Allocates a set of p_layout from the current pool
+             *
+             * @param p_layout is the layout of the set to allocate
+             * @param p_variable_count is the descriptor count of the variable
+             * sized binding of p_layout, if it has one
+             *
+             * @return the allocated set, or nullptr if even a new pool could
+             * not hold the set (a layout needing more descriptors than the
+             * ratios reserve)
+             */
+            [[nodiscard]] VkDescriptorSet allocate(
+              const VkDescriptorSetLayout& p_layout,
+              uint32_t p_variable_count = 0) {
+                VkDescriptorSet set = nullptr;
+                VkResult result = try_allocate(p_layout, p_variable_count, set);
+
+                if (result == VK_ERROR_OUT_OF_POOL_MEMORY or
+                    result == VK_ERROR_FRAGMENTED_POOL) {
+                    m_full.push_back(m_current);
+                    m_current = nullptr;
+                    result = try_allocate(p_layout, p_variable_count, set);
+                }
+
+                vk_check(result, "vkAllocateDescriptorSets");
+                if (result != VK_SUCCESS) {
+                    return nullptr;
+                }
+
+                m_stats.sets_in_use++;
+                m_stats.sets_allocated++;
+                return set;
+            }
+
+            /**
+             * @brief Resets every pool, invalidating every set allocated from
+             * this allocator
+             *
+             * Sets must no longer be in use by the GPU.
+             */
+            void reset() {
+                if (m_current != nullptr) {
+                    m_ready.push_back(m_current);
+                    m_current = nullptr;
+                }
+                m_ready.insert(m_ready.end(), m_full.begin(), m_full.end());
+                m_full.clear();
+
+                for (const VkDescriptorPool& pool : m_ready) {
+                    vk_check(vkResetDescriptorPool(m_device, pool, 0),
+                             "vkResetDescriptorPool");
+                }
+
+                m_stats.sets_in_use = 0;
+                m_stats.resets++;
+            }
+
+            //! @return usage statistics of this allocator
+            [[nodiscard]] descriptor_allocator_stats stats() const {
+                descriptor_allocator_stats current = m_stats;
+                current.full_pools = static_cast<uint32_t>(m_full.size());
+                return current;
+            }
+
+            [[nodiscard]] bool alive() const { return m_device != nullptr; }
+
+            void destruct() {
+                if (m_current != nullptr) {
+                    vkDestroyDescriptorPool(m_device, m_current, nullptr);
+                    m_current = nullptr;
+                }
+                for (const VkDescriptorPool& pool : m_ready) {
+                    vkDestroyDescriptorPool(m_device, pool, nullptr);
+                }
+                for (const VkDescriptorPool& pool : m_full) {
+                    vkDestroyDescriptorPool(m_device, pool, nullptr);
+                }
+                m_ready.clear();
+                m_full.clear();
+            }
+
+        private:
+            VkResult try_allocate(const VkDescriptorSetLayout& p_layout,
+                                  uint32_t p_variable_count,
+                                  VkDescriptorSet& p_set) {
+                if (m_current == nullptr) {
+                    m_current = acquire_pool();
+                }
+
+                VkDescriptorSetVariableDescriptorCountAllocateInfo
+                  variable_count_info = {
+                      .sType =
+                        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+                      .descriptorSetCount = 1,
+                      .pDescriptorCounts = &p_variable_count,
+                  };
+
+                VkDescriptorSetAllocateInfo descriptor_set_alloc_info = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                    .pNext =
+                      (p_variable_count == 0) ? nullptr : &variable_count_info,
+                    .descriptorPool = m_current,
+                    .descriptorSetCount = 1,
+                    .pSetLayouts = &p_layout
+                };
+
+                return vkAllocateDescriptorSets(
+                  m_device, &descriptor_set_alloc_info, &p_set);
+            }
+
+            //! @return a pool that was reset, or a new pool grown from the
+            //! previous one
+            VkDescriptorPool acquire_pool() {
+                if (!m_ready.empty()) {
+                    VkDescriptorPool pool = m_ready.back();
+                    m_ready.pop_back();
+                    return pool;
+                }
+
+                VkDescriptorPool pool = create_pool(m_sets_per_pool);
+                if (m_stats.pools > 0) {
+                    m_stats.growths++;
+                }
+                m_stats.pools++;
+
+                m_sets_per_pool = std::min(
+                  static_cast<uint32_t>(std::ceil(
+                    static_cast<float>(m_sets_per_pool) *
+                    std::max(m_params.growth_factor, 1.f))),
+                  std::max(m_params.max_sets_per_pool, 1u));
+                return pool;
+            }
+
+            VkDescriptorPool create_pool(uint32_t p_set_count) {
+                std::vector<VkDescriptorPoolSize> pool_sizes(m_ratios.size());
+                for (size_t i = 0; i < pool_sizes.size(); i++) {
+                    pool_sizes[i] = {
+                        .type = static_cast<VkDescriptorType>(m_ratios[i].type),
+                        .descriptorCount = std::max(
+                          static_cast<uint32_t>(
+                            m_ratios[i].ratio *
+                            static_cast<float>(p_set_count)),
+                          1u),
+                    };
+                }
+
+                VkDescriptorPoolCreateInfo pool_ci = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = static_cast<VkDescriptorPoolCreateFlags>(
+                      (m_params.flags ==
+                       descriptor_layout_flags::update_after_bind_pool)
+                        ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+                        : 0),
+                    .maxSets = p_set_count,
+                    .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+                    .pPoolSizes = pool_sizes.data()
+                };
+
+                VkDescriptorPool pool = nullptr;
+                vk_check(vkCreateDescriptorPool(m_device, &pool_ci, nullptr, &pool),
+                         "vkCreateDescriptorPool");
+                return pool;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            descriptor_allocator_params m_params{};
+            //! @brief Copy of m_params.ratios, which is not kept alive
+            std::vector<pool_size_ratio> m_ratios;
+            uint32_t m_sets_per_pool = 0;
+            VkDescriptorPool m_current = nullptr;
+            std::vector<VkDescriptorPool> m_ready;
+            std::vector<VkDescriptorPool> m_full;
+            descriptor_allocator_stats m_stats{};
+        };
+    };
+};
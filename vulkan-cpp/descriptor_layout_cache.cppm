@@ -0,0 +1,198 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+
+export module vk:descriptor_layout_cache;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Creates a VkDescriptorSetLayout from p_entries that the
+         * caller owns
+         *
+         * The binding flags of every entry are chained through
+         * VkDescriptorSetLayoutBindingFlagsCreateInfo for descriptor indexing.
+         */
+        VkDescriptorSetLayout create_descriptor_set_layout(
+          const VkDevice& p_device,
+          std::span<const descriptor_entry> p_entries,
+          descriptor_layout_flags p_flags = descriptor_layout_flags::none) {
+            std::vector<VkDescriptorSetLayoutBinding> descriptor_layout_bindings(
+              p_entries.size());
+            std::vector<VkDescriptorBindingFlags> binding_flags(
+              p_entries.size());
+
+            for (size_t i = 0; i < p_entries.size(); i++) {
+                descriptor_entry entry = p_entries[i];
+                descriptor_binding_point bind = entry.binding_point;
+
+                descriptor_layout_bindings[i] = {
+                    .binding = bind.binding,
+                    .descriptorType = static_cast<VkDescriptorType>(entry.type),
+                    .descriptorCount = entry.descriptor_count,
+                    .stageFlags = static_cast<VkShaderStageFlags>(bind.stage),
+                };
+                binding_flags[i] =
+                  static_cast<VkDescriptorBindingFlags>(entry.flags);
+            }
+
+            VkDescriptorSetLayoutBindingFlagsCreateInfo
+              descriptor_layout_binding_flags = {
+                  .sType =
+                    VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+                  .bindingCount = static_cast<uint32_t>(binding_flags.size()),
+                  .pBindingFlags = binding_flags.data(),
+              };
+
+            VkDescriptorSetLayoutCreateInfo descriptor_layout_ci = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = &descriptor_layout_binding_flags,
+                .flags = static_cast<VkDescriptorSetLayoutCreateFlags>(p_flags),
+                .bindingCount =
+                  static_cast<uint32_t>(descriptor_layout_bindings.size()),
+                .pBindings = descriptor_layout_bindings.data()
+            };
+
+            VkDescriptorSetLayout layout = nullptr;
+            vk_check(vkCreateDescriptorSetLayout(
+                       p_device, &descriptor_layout_ci, nullptr, &layout),
+                     "vkCreateDescriptorSetLayout");
+            return layout;
+        }
+
+        //! @brief Bindings of a descriptor set layout, sorted by binding
+        struct descriptor_layout_key {
+            std::vector<descriptor_entry> entries;
+            descriptor_layout_flags flags = descriptor_layout_flags::none;
+
+            bool operator==(const descriptor_layout_key& p_other) const {
+                return flags == p_other.flags and entries == p_other.entries;
+            }
+        };
+
+        //! @brief Hashes every entry of vk::descriptor_layout_key
+        struct descriptor_layout_key_hash {
+            size_t operator()(const descriptor_layout_key& p_key) const {
+                uint64_t seed = hash_seed;
+                auto combine = [&seed](uint64_t p_value) {
+                    seed = hash_combine(seed, p_value);
+                };
+
+                combine(static_cast<uint64_t>(p_key.flags));
+                for (const descriptor_entry& entry : p_key.entries) {
+                    combine(static_cast<uint64_t>(entry.type));
+                    combine(entry.binding_point.binding);
+                    combine(static_cast<uint64_t>(entry.binding_point.stage));
+                    combine(entry.descriptor_count);
+                    combine(static_cast<uint64_t>(entry.flags));
+                }
+                return seed;
+            }
+        };
+
+        /**
+         * @brief Shares one VkDescriptorSetLayout between every descriptor set
+         * declaring the same bindings
+         *
+         * Pipeline layouts are only compatible when their set layouts are
+         * identically defined, and comparing handles is the cheap way to know
+         * a bound set can stay bound across a pipeline switch. Looking layouts
+         * up by their bindings (in any declaration order) gives equivalent
+         * specs the same handle. Layouts live until destruct().
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::descriptor_layout_cache layouts(logical_device);
+         *
+         * vk::descriptor_layout set1_layout = {
+         *      .slot = 1,
+         *      .max_sets = 1,
+         *      .entries = material_entries,
+         *      .layout_cache = &layouts,
+         * };
+         *
+         * // both share the same VkDescriptorSetLayout
+         * vk::descriptor_resource brick(logical_device, set1_layout);
+         * vk::descriptor_resource marble(logical_device, set1_layout);
+         *
+         * ```
+         */
+        class descriptor_layout_cache {
+        public:
+            descriptor_layout_cache() = default;
+
+            descriptor_layout_cache(const VkDevice& p_device)
+              : m_device(p_device) {}
+
+            descriptor_layout_cache(const descriptor_layout_cache&) = delete;
+            descriptor_layout_cache& operator=(const descriptor_layout_cache&) =
+              delete;
+
+            /**
+             * @return the layout matching p_entries and p_flags, created on
+             * first use. Safe to call from multiple threads.
+             */
+            [[nodiscard]] VkDescriptorSetLayout get(
+              std::span<const descriptor_entry> p_entries,
+              descriptor_layout_flags p_flags = descriptor_layout_flags::none) {
+                descriptor_layout_key key = {
+                    .entries = { p_entries.begin(), p_entries.end() },
+                    .flags = p_flags,
+                };
+                std::ranges::sort(key.entries,
+                                  [](const descriptor_entry& p_lhs,
+                                     const descriptor_entry& p_rhs) {
+                                      return p_lhs.binding_point.binding <
+                                             p_rhs.binding_point.binding;
+                                  });
+
+                std::scoped_lock lock(m_mutex);
+                auto found = m_layouts.find(key);
+                if (found != m_layouts.end()) {
+                    return found->second;
+                }
+
+                VkDescriptorSetLayout layout =
+                  create_descriptor_set_layout(m_device, key.entries, p_flags);
+                m_layouts.emplace(std::move(key), layout);
+                return layout;
+            }
+
+            //! @return the amount of unique layouts created
+            [[nodiscard]] size_t size() const {
+                std::scoped_lock lock(m_mutex);
+                return m_layouts.size();
+            }
+
+            //! @brief Destroys every layout. Descriptor resources and pipeline
+            //! layouts referencing them must be destroyed first.
+            void destruct() {
+                std::scoped_lock lock(m_mutex);
+                for (auto& [key, layout] : m_layouts) {
+                    vkDestroyDescriptorSetLayout(m_device, layout, nullptr);
+                }
+                m_layouts.clear();
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            mutable std::mutex m_mutex;
+            std::unordered_map<descriptor_layout_key,
+                               VkDescriptorSetLayout,
+                               descriptor_layout_key_hash>
+              m_layouts;
+        };
+    };
+};
@@ -4,6 +4,7 @@ module;
 #include <span>
 #include <array>
 #include <unordered_map>
+#include <vector>
 
 export module vk:descriptor_resource;
 
@@ -11,18 +12,24 @@ export import :types;
 export import :utilities;
 export import :uniform_buffer;
 export import :sample_image;
+export import :descriptor_allocator;
+export import :descriptor_layout_cache;
+export import :descriptor_update_template;
 
 export namespace vk {
     inline namespace v6 {
         /**
          * @param slot is the slot specific to the number slot for the
          * descriptor. Ex. layout (set = 0)
+         * @param layout_cache when set, the VkDescriptorSetLayout is looked up
+         * from the cache and shared instead of being owned by the resource
          */
         struct descriptor_layout {
             uint32_t slot = 0;
             uint32_t max_sets = 0;
             std::span<descriptor_entry> entries;
             std::span<const uint32_t> descriptor_counts = {};
+            descriptor_layout_cache* layout_cache = nullptr;
         };
 
         /**
@@ -117,8 +124,6 @@ export namespace vk {
               , m_slot(p_info.slot) {
                 std::vector<VkDescriptorPoolSize> pool_sizes(
                   p_info.entries.size());
-                std::vector<VkDescriptorSetLayoutBinding>
-                  descriptor_layout_bindings(p_info.entries.size());
 
                 for (size_t i = 0; i < pool_sizes.size(); i++) {
                     VkDescriptorType descriptor_type =
@@ -132,22 +137,6 @@ export namespace vk {
                     };
                 }
 
-                for (size_t i = 0; i < descriptor_layout_bindings.size(); i++) {
-                    descriptor_entry entry = p_info.entries[i];
-                    descriptor_binding_point bind = entry.binding_point;
-
-                    VkDescriptorType type =
-                      static_cast<VkDescriptorType>(entry.type);
-
-                    descriptor_layout_bindings[i] = {
-                        .binding = bind.binding,
-                        .descriptorType = type,
-                        .descriptorCount = entry.descriptor_count,
-                        .stageFlags =
-                          static_cast<VkShaderStageFlags>(bind.stage),
-                    };
-                }
-
                 VkDescriptorPoolCreateInfo pool_ci = {
                     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
                     .pNext = nullptr,
@@ -165,42 +154,7 @@ export namespace vk {
                            m_device, &pool_ci, nullptr, &m_descriptor_pool),
                          "vkCreateDescriptorPool");
 
-                // For Descriptor Indexing
-                // Enable binding flags
-
-                std::vector<VkDescriptorBindingFlags> binding_flags(
-                  p_info.entries.size());
-
-                for (uint32_t i = 0; i < binding_flags.size(); i++) {
-                    binding_flags[i] = static_cast<VkDescriptorBindingFlags>(
-                      p_info.entries[i].flags);
-                }
-
-                VkDescriptorSetLayoutBindingFlagsCreateInfo
-                  descriptor_layout_binding_flags = {
-                      .sType =
-                        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
-                      .bindingCount =
-                        static_cast<uint32_t>(binding_flags.size()),
-                      .pBindingFlags = binding_flags.data(),
-                  };
-
-                VkDescriptorSetLayoutCreateInfo descriptor_layout_ci = {
-                    .sType =
-                      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-                    .pNext = &descriptor_layout_binding_flags,
-                    .flags =
-                      static_cast<VkDescriptorSetLayoutCreateFlags>(p_flags),
-                    .bindingCount =
-                      static_cast<uint32_t>(descriptor_layout_bindings.size()),
-                    .pBindings = descriptor_layout_bindings.data()
-                };
-
-                vk_check(vkCreateDescriptorSetLayout(m_device,
-                                                     &descriptor_layout_ci,
-                                                     nullptr,
-                                                     &m_descriptor_layout),
-                         "vkCreateDescriptorSetLayout");
+                create_layout(p_info, p_flags);
 
                 VkDescriptorSetVariableDescriptorCountAllocateInfo
                   descriptor_variable_cound_info = {
@@ -227,6 +181,39 @@ export namespace vk {
                          "vkAllocateDescriptorSets");
             }
 
+            /**
+             * @brief Constructs a descriptor resource whose set is allocated
+             * from a shared vk::descriptor_allocator instead of its own pool
+             *
+             * The VkDescriptorSetLayout is still owned by this resource, but
+             * p_info.max_sets is ignored and the set is released when
+             * p_allocator is reset or destroyed.
+             *
+             * Example Usage:
+             *
+             * ```C++
+             *
+             * vk::descriptor_allocator allocator(logical_device);
+             * vk::descriptor_resource set1(logical_device, layout, allocator);
+             * ```
+             */
+            descriptor_resource(
+              const VkDevice& p_device,
+              const descriptor_layout& p_info,
+              descriptor_allocator& p_allocator,
+              descriptor_layout_flags p_flags = descriptor_layout_flags::none)
+              : m_device(p_device)
+              , m_slot(p_info.slot) {
+                create_layout(p_info, p_flags);
+
+                const uint32_t variable_count =
+                  p_info.descriptor_counts.empty()
+                    ? 0
+                    : p_info.descriptor_counts[0];
+                m_descriptor_set =
+                  p_allocator.allocate(m_descriptor_layout, variable_count);
+            }
+
             /**
              * @brief Performs the operation to actual update the descriptor set
              * handle with the uniforms data segments.
@@ -243,6 +230,9 @@ export namespace vk {
              * command buffer that is "in-flight" (executing on the GPU).
              * - Resource type (e.g. combind_image_sampler) must match what has
              * been defined in the `descriptor layout` for that `dst_binding`.
+             * The descriptor type of each write is taken from the layout, so
+             * storage images are written through p_images with
+             * image_layout::general and no sampler.
              * - Buffer/Image handles must remain valid until the GPU has
              * finished executing the cmomand buffer that is using this
              * particular descriptor set.
@@ -308,22 +298,30 @@ export namespace vk {
              */
             void update(std::span<const write_buffer_descriptor> p_uniforms,
                         std::span<const write_image_descriptor> p_images = {}) {
-                std::vector<VkWriteDescriptorSet> write_descriptors;
-
-                // uint32_t represent the destination bindings to those
-                // resources (uniforms and sample images)
-                std::unordered_map<uint32_t,
-                                   std::vector<VkDescriptorBufferInfo>>
-                  buffer_infos;
-                std::unordered_map<uint32_t, std::vector<VkDescriptorImageInfo>>
-                  image_infos;
-
-                // Reconfigure the VkWriteDescriptorBufferInfo with the
-                // parameters accroding vk::write_buffer_descriptor
-                // specifications
+                // Scratch storage is kept between calls so per-frame updates
+                // stop allocating once the capacity has been reached. Reserving
+                // the totals upfront keeps the info pointers stable.
+                size_t buffer_count = 0;
                 for (const auto& ubo : p_uniforms) {
+                    buffer_count += ubo.uniforms.size();
+                }
+                size_t image_count = 0;
+                for (const auto& ubo : p_images) {
+                    image_count += ubo.sample_images.size();
+                }
+
+                m_write_descriptors.clear();
+                m_buffer_infos.clear();
+                m_image_infos.clear();
+                m_write_descriptors.reserve(p_uniforms.size() +
+                                            p_images.size());
+                m_buffer_infos.reserve(buffer_count);
+                m_image_infos.reserve(image_count);
+
+                for (const auto& ubo : p_uniforms) {
+                    const size_t first = m_buffer_infos.size();
                     for (const auto& uniform : ubo.uniforms) {
-                        buffer_infos[ubo.dst_binding].emplace_back(
+                        m_buffer_infos.emplace_back(
                           uniform.buffer, uniform.offset, uniform.range);
                     }
 
@@ -333,19 +331,21 @@ export namespace vk {
                         .dstSet = m_descriptor_set,
                         .dstBinding = ubo.dst_binding,
                         .dstArrayElement = ubo.dst_array_element,
-                        .descriptorCount = static_cast<uint32_t>(
-                          buffer_infos[ubo.dst_binding].size()),
-                        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                        .pBufferInfo = buffer_infos[ubo.dst_binding].data(),
+                        .descriptorCount =
+                          static_cast<uint32_t>(ubo.uniforms.size()),
+                        .descriptorType =
+                          binding_type(ubo.dst_binding,
+                                       VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+                        .pBufferInfo = m_buffer_infos.data() + first,
                     };
 
-                    write_descriptors.emplace_back(write_descriptor);
+                    m_write_descriptors.emplace_back(write_descriptor);
                 }
 
                 for (const auto& ubo : p_images) {
-
+                    const size_t first = m_image_infos.size();
                     for (const auto& sample_image : ubo.sample_images) {
-                        image_infos[ubo.dst_binding].emplace_back(
+                        m_image_infos.emplace_back(
                           sample_image.sampler,
                           sample_image.view,
                           static_cast<VkImageLayout>(sample_image.layout));
@@ -357,28 +357,60 @@ export namespace vk {
                         .dstSet = m_descriptor_set,
                         .dstBinding = ubo.dst_binding,
                         .dstArrayElement = ubo.dst_array_element,
-                        .descriptorCount = static_cast<uint32_t>(
-                          image_infos[ubo.dst_binding].size()),
-                        .descriptorType =
-                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                        .pImageInfo = image_infos[ubo.dst_binding].data(),
+                        .descriptorCount =
+                          static_cast<uint32_t>(ubo.sample_images.size()),
+                        .descriptorType = binding_type(
+                          ubo.dst_binding,
+                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+                        .pImageInfo = m_image_infos.data() + first,
                     };
 
-                    write_descriptors.emplace_back(write_descriptor);
+                    m_write_descriptors.emplace_back(write_descriptor);
                 }
 
                 vkUpdateDescriptorSets(
                   m_device,
-                  static_cast<uint32_t>(write_descriptors.size()),
-                  write_descriptors.data(),
+                  static_cast<uint32_t>(m_write_descriptors.size()),
+                  m_write_descriptors.data(),
                   0,
                   nullptr);
+            }
 
-                // Ensures to clear up so we dont have any existing handles
-                // because they only need to exist until we've updated this
-                // descriptor set in particular
-                buffer_infos.clear();
-                image_infos.clear();
+            /**
+             * @brief Updates every binding of the set in a single call through
+             * a VkDescriptorUpdateTemplate
+             *
+             * Nothing is allocated: p_writer lives on the stack and the driver
+             * reads the descriptors straight out of it.
+             *
+             * @return false, leaving the set untouched, if p_writer dropped a
+             * write or holds fewer descriptors than p_template reads
+             *
+             * Example Usage:
+             *
+             * ```C++
+             *
+             * vk::descriptor_update_template set0_template(
+             *      logical_device, set0.layout(), entries);
+             *
+             * vk::descriptor_writer<2> writer;
+             * writer.write(set0_template.slot(0), vk::write_buffer{
+             *      .buffer = camera_ubo,
+             *      .range = sizeof(camera_uniform),
+             * });
+             * writer.write(set0_template.slot(1), vk::write_image{
+             *      .sampler = texture.image().sampler(),
+             *      .view = texture.image().image_view(),
+             *      .layout = vk::image_layout::shader_read_only_optimal,
+             * });
+             * set0.update(set0_template, writer);
+             * ```
+             */
+            template<size_t capacity>
+            bool update(const descriptor_update_template& p_template,
+                        const descriptor_writer<capacity>& p_writer) {
+                return p_writer.valid() and
+                       p_template.update(m_descriptor_set, p_writer.data());
             }
 
             [[nodiscard]] VkDescriptorSetLayout layout() const {
@@ -391,7 +423,7 @@ export namespace vk {
                       m_device, m_descriptor_pool, nullptr);
                 }
 
-                if (m_descriptor_layout != nullptr) {
+                if (m_owns_layout and m_descriptor_layout != nullptr) {
                     vkDestroyDescriptorSetLayout(
                       m_device, m_descriptor_layout, nullptr);
                 }
@@ -401,12 +433,48 @@ export namespace vk {
 
             operator VkDescriptorSet() { return m_descriptor_set; }
 
+        private:
+            //! @brief Creates or looks up m_descriptor_layout from p_info
+            void create_layout(const descriptor_layout& p_info,
+                               descriptor_layout_flags p_flags) {
+                for (const descriptor_entry& entry : p_info.entries) {
+                    m_binding_types[entry.binding_point.binding] =
+                      static_cast<VkDescriptorType>(entry.type);
+                }
+
+                if (p_info.layout_cache != nullptr) {
+                    m_descriptor_layout =
+                      p_info.layout_cache->get(p_info.entries, p_flags);
+                    m_owns_layout = false;
+                    return;
+                }
+
+                m_descriptor_layout =
+                  create_descriptor_set_layout(m_device, p_info.entries, p_flags);
+                m_owns_layout = true;
+            }
+
+            //! @return the descriptor type p_binding was declared with in the
+            //! layout, or p_fallback if the binding is unknown
+            [[nodiscard]] VkDescriptorType binding_type(
+              uint32_t p_binding,
+              VkDescriptorType p_fallback) const {
+                auto found = m_binding_types.find(p_binding);
+                return (found != m_binding_types.end()) ? found->second
+                                                        : p_fallback;
+            }
+
         private:
             VkDevice m_device = nullptr;
             uint32_t m_slot;
+            std::unordered_map<uint32_t, VkDescriptorType> m_binding_types;
             VkDescriptorPool m_descriptor_pool = nullptr;
             VkDescriptorSetLayout m_descriptor_layout = nullptr;
+            bool m_owns_layout = false;
             VkDescriptorSet m_descriptor_set = nullptr;
+            std::vector<VkWriteDescriptorSet> m_write_descriptors;
+            std::vector<VkDescriptorBufferInfo> m_buffer_infos;
+            std::vector<VkDescriptorImageInfo> m_image_infos;
         };
     };
 };
\ No newline at end of file
@@ -0,0 +1,282 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+export module vk:descriptor_update_template;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief One descriptor as read by vkUpdateDescriptorSetWithTemplate
+         *
+         * Buffer descriptors (uniform, storage and their dynamic variants)
+         * read buffer, every image and sampler descriptor reads image.
+         */
+        union descriptor_info {
+            VkDescriptorBufferInfo buffer;
+            VkDescriptorImageInfo image;
+        };
+
+        /**
+         * @brief Fixed-capacity list of descriptors filled on the stack
+         *
+         * Slots are the indices returned by descriptor_update_template::slot,
+         * so writes can come in any order. A write past capacity is dropped
+         * and leaves the writer invalid until reset().
+         *
+         * @tparam capacity is the maximum amount of descriptors written
+         */
+        template<size_t capacity>
+        class descriptor_writer {
+        public:
+            descriptor_writer() = default;
+
+            //! @brief Writes a uniform or storage buffer (dynamic or not)
+            descriptor_writer& write(uint32_t p_slot,
+                                     const write_buffer& p_buffer) {
+                if (!reserve(p_slot)) {
+                    return *this;
+                }
+                m_infos[p_slot].buffer = {
+                    .buffer = p_buffer.buffer,
+                    .offset = p_buffer.offset,
+                    .range = (p_buffer.range == 0) ? VK_WHOLE_SIZE
+                                                   : p_buffer.range,
+                };
+                return *this;
+            }
+
+            //! @brief Writes a sampled, storage or combined image sampler
+            //! descriptor, or a sampler only
+            descriptor_writer& write(uint32_t p_slot,
+                                     const write_image& p_image) {
+                if (!reserve(p_slot)) {
+                    return *this;
+                }
+                m_infos[p_slot].image = {
+                    .sampler = p_image.sampler,
+                    .imageView = p_image.view,
+                    .imageLayout = static_cast<VkImageLayout>(p_image.layout),
+                };
+                return *this;
+            }
+
+            //! @brief Clears the writer for reuse
+            void reset() {
+                m_count = 0;
+                m_overflowed = false;
+            }
+
+            //! @return false if a write was dropped for exceeding capacity
+            [[nodiscard]] bool valid() const { return !m_overflowed; }
+
+            //! @return the descriptors written so far, indexed by slot
+            [[nodiscard]] std::span<const descriptor_info> data() const {
+                return std::span<const descriptor_info>(m_infos.data(),
+                                                        m_count);
+            }
+
+        private:
+            bool reserve(uint32_t p_slot) {
+                if (p_slot >= capacity) {
+                    m_overflowed = true;
+                    return false;
+                }
+                m_count = std::max(m_count, p_slot + 1);
+                return true;
+            }
+
+        private:
+            std::array<descriptor_info, capacity> m_infos{};
+            uint32_t m_count = 0;
+            bool m_overflowed = false;
+        };
+
+        /**
+         * @brief Describes how every binding of a descriptor set layout is
+         * read out of a packed array of vk::descriptor_info
+         *
+         * Each binding occupies descriptor_count consecutive slots, in the
+         * order the entries are declared. Updating a set is then a single
+         * vkUpdateDescriptorSetWithTemplate call with no
+         * VkWriteDescriptorSet to build.
+         *
+         * ```
+         *
+         *  entries:  binding 0 (uniform, 1)  binding 1 (sampler2D, 3)
+         *  slots:    [0]                     [1] [2] [3]
+         *
+         * ```
+         */
+        class descriptor_update_template {
+        public:
+            descriptor_update_template() = default;
+
+            /**
+             * @param p_device is the logical device
+             * @param p_layout is the layout of the sets updated
+             * @param p_entries are the bindings p_layout was created with
+             */
+            descriptor_update_template(
+              const VkDevice& p_device,
+              const VkDescriptorSetLayout& p_layout,
+              std::span<const descriptor_entry> p_entries)
+              : m_device(p_device) {
+                create(p_entries,
+                       VkDescriptorUpdateTemplateCreateInfo{
+                         .sType =
+                           VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+                         .templateType =
+                           VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+                         .descriptorSetLayout = p_layout,
+                       });
+            }
+
+            /**
+             * @brief Creates a template for command_buffer::push_descriptors
+             *
+             * @param p_device is the logical device
+             * @param p_pipeline_layout is the layout the descriptors are pushed
+             * to
+             * @param p_pipeline_bind_point is the bind point pushed to
+             * @param p_slot is the set index of the push descriptor layout in
+             * p_pipeline_layout
+             * @param p_entries are the bindings of that push descriptor layout
+             */
+            descriptor_update_template(
+              const VkDevice& p_device,
+              const VkPipelineLayout& p_pipeline_layout,
+              uint64_t p_pipeline_bind_point,
+              uint32_t p_slot,
+              std::span<const descriptor_entry> p_entries)
+              : m_device(p_device) {
+                create(p_entries,
+                       VkDescriptorUpdateTemplateCreateInfo{
+                         .sType =
+                           VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+                         .templateType =
+                           VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR,
+                         .pipelineBindPoint = static_cast<VkPipelineBindPoint>(
+                           p_pipeline_bind_point),
+                         .pipelineLayout = p_pipeline_layout,
+                         .set = p_slot,
+                       });
+            }
+
+            /**
+             * @return the slot of element p_array_element of p_binding, used
+             * with descriptor_writer::write. descriptor_count() if p_binding
+             * is not part of the template or p_array_element is past its
+             * descriptor_count.
+             */
+            [[nodiscard]] uint32_t slot(uint32_t p_binding,
+                                        uint32_t p_array_element = 0) const {
+                for (const binding_slot& binding : m_bindings) {
+                    if (binding.binding != p_binding) {
+                        continue;
+                    }
+                    // Past the last element the slot belongs to the next
+                    // binding, the writer would accept it
+                    if (p_array_element >= binding.descriptor_count) {
+                        return m_descriptor_count;
+                    }
+                    return binding.first_slot + p_array_element;
+                }
+                return m_descriptor_count;
+            }
+
+            //! @return the amount of descriptors read per update
+            [[nodiscard]] uint32_t descriptor_count() const {
+                return m_descriptor_count;
+            }
+
+            /**
+             * @brief Writes every descriptor of p_set from p_infos
+             *
+             * @return false, leaving p_set untouched, if p_infos holds fewer
+             * than descriptor_count() descriptors
+             */
+            bool update(const VkDescriptorSet& p_set,
+                        std::span<const descriptor_info> p_infos) const {
+                if (p_infos.size() < m_descriptor_count) {
+                    return false;
+                }
+                vkUpdateDescriptorSetWithTemplate(
+                  m_device, p_set, m_template, p_infos.data());
+                return true;
+            }
+
+            [[nodiscard]] bool alive() const { return m_template; }
+
+            void destruct() {
+                if (m_template != nullptr) {
+                    vkDestroyDescriptorUpdateTemplate(
+                      m_device, m_template, nullptr);
+                }
+            }
+
+            operator VkDescriptorUpdateTemplate() const { return m_template; }
+
+            operator VkDescriptorUpdateTemplate() { return m_template; }
+
+        private:
+            void create(std::span<const descriptor_entry> p_entries,
+                        VkDescriptorUpdateTemplateCreateInfo p_template_ci) {
+                std::vector<VkDescriptorUpdateTemplateEntry> template_entries(
+                  p_entries.size());
+                m_bindings.resize(p_entries.size());
+
+                uint32_t slot = 0;
+                for (size_t i = 0; i < p_entries.size(); i++) {
+                    const descriptor_entry& entry = p_entries[i];
+                    template_entries[i] = {
+                        .dstBinding = entry.binding_point.binding,
+                        .dstArrayElement = 0,
+                        .descriptorCount = entry.descriptor_count,
+                        .descriptorType =
+                          static_cast<VkDescriptorType>(entry.type),
+                        .offset = slot * sizeof(descriptor_info),
+                        .stride = sizeof(descriptor_info),
+                    };
+                    m_bindings[i] = {
+                        .binding = entry.binding_point.binding,
+                        .first_slot = slot,
+                        .descriptor_count = entry.descriptor_count,
+                    };
+                    slot += entry.descriptor_count;
+                }
+                m_descriptor_count = slot;
+
+                p_template_ci.descriptorUpdateEntryCount =
+                  static_cast<uint32_t>(template_entries.size());
+                p_template_ci.pDescriptorUpdateEntries = template_entries.data();
+
+                vk_check(vkCreateDescriptorUpdateTemplate(
+                           m_device, &p_template_ci, nullptr, &m_template),
+                         "vkCreateDescriptorUpdateTemplate");
+            }
+
+        private:
+            struct binding_slot {
+                uint32_t binding = 0;
+                uint32_t first_slot = 0;
+                uint32_t descriptor_count = 0;
+            };
+
+        private:
+            VkDevice m_device = nullptr;
+            VkDescriptorUpdateTemplate m_template = nullptr;
+            std::vector<binding_slot> m_bindings;
+            uint32_t m_descriptor_count = 0;
+        };
+    };
+};
@@ -3,6 +3,9 @@ module;
 #include <span>
 #include <vulkan/vulkan.h>
 #include <limits>
+#include <array>
+#include <chrono>
+#include <algorithm>
 
 export module vk:device_present_queue;
 
@@ -11,6 +14,21 @@ export import :utilities;
 
 export namespace vk {
     inline namespace v6 {
+        /**
+         * @brief Present-to-display latency measured with VK_KHR_present_wait
+         *
+         * Latency is the time between vkQueuePresentKHR and
+         * vkWaitForPresentKHR returning for that present, in milliseconds.
+         * Only the presents wait_for_present is called with are measured,
+         * presents it skips over have no display time of their own.
+         */
+        struct present_latency_stats {
+            uint64_t presents_measured = 0;
+            double last_ms = 0.0;
+            double average_ms = 0.0;
+            double max_ms = 0.0;
+        };
+
         /**
          * @name device_present_queue
          * @brief Represents a presentation queue that must have an associated
@@ -39,6 +57,105 @@ export namespace vk {
 
             void wait_idle() { vkQueueWaitIdle(m_queue_handler); }
 
+            //! @brief Presents to p_swapchain from now on, called after
+            //! swapchain::recreate
+            void rebind(const VkSwapchainKHR& p_swapchain) {
+                m_swapchain = p_swapchain;
+                m_out_of_date = false;
+                m_first_present_id = m_present_id + 1;
+            }
+
+            /**
+             * @brief Tags every present with a VK_KHR_present_id so
+             * wait_for_present can pace frames and measure latency
+             *
+             * The device must be created with VK_KHR_present_id and
+             * VK_KHR_present_wait and their features chained in
+             * device_params::features, see
+             * physical_device::present_wait_supported.
+             *
+             * @return false if vkWaitForPresentKHR could not be loaded
+             */
+            bool enable_present_wait() {
+                m_wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                  vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+                return m_wait_for_present != nullptr;
+            }
+
+            //! @return the id of the last present, 0 before the first present
+            //! or without enable_present_wait
+            [[nodiscard]] uint64_t present_id() const { return m_present_id; }
+
+            /**
+             * @brief Blocks until the present p_frames_behind presents before
+             * the last one is displayed
+             *
+             * Calling this with 1 before recording the next frame keeps at
+             * most one frame queued ahead of the display, trading throughput
+             * for input latency.
+             *
+             * ```C++
+             *
+             * present_queue.present_frame(image_index);
+             * present_queue.wait_for_present(1);
+             * std::println("latency {} ms",
+             *              present_queue.latency_stats().last_ms);
+             *
+             * ```
+             *
+             * @return true if the present was displayed, false on timeout,
+             * when present wait is not enabled or when there is nothing to
+             * wait on
+             */
+            bool wait_for_present(uint64_t p_frames_behind = 0,
+                                  uint64_t p_timeout_ns =
+                                    std::numeric_limits<uint64_t>::max()) {
+                if (m_wait_for_present == nullptr or
+                    m_present_id < p_frames_behind) {
+                    return false;
+                }
+
+                // ids before m_first_present_id went to a retired swapchain
+                const uint64_t id = m_present_id - p_frames_behind;
+                if (id < m_first_present_id) {
+                    return false;
+                }
+                if (id <= m_waited_present_id) {
+                    return true;
+                }
+
+                VkResult res =
+                  m_wait_for_present(m_device, m_swapchain, id, p_timeout_ns);
+                if (res == VK_TIMEOUT) {
+                    return false;
+                }
+                if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+                    m_out_of_date = true;
+                    return false;
+                }
+                // The present was displayed, the swapchain no longer matches
+                // the surface exactly
+                if (res == VK_SUBOPTIMAL_KHR) {
+                    m_out_of_date = true;
+                }
+                else if (res != VK_SUCCESS) {
+                    vk_check(res, "vkWaitForPresentKHR");
+                    return false;
+                }
+
+                if (m_present_id - id < max_tracked_presents) {
+                    record_latency(std::chrono::steady_clock::now() -
+                                   m_present_times[id % max_tracked_presents]);
+                }
+                m_waited_present_id = id;
+                return true;
+            }
+
+            //! @return latency measured by wait_for_present
+            [[nodiscard]] present_latency_stats latency_stats() const {
+                return m_latency;
+            }
+
             //! @return true if this queue is out of date
             // Can occur when acquired_next_image or present_frame are out of
             // date indication swapchain resizeability.
@@ -143,6 +260,19 @@ export namespace vk {
                     .pImageIndices = &p_frame_idx,
                 };
 
+                VkPresentIdKHR present_id = {
+                    .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                    .swapchainCount = 1,
+                };
+                uint64_t next_present_id = m_present_id + 1;
+                if (m_wait_for_present != nullptr) {
+                    present_id.pPresentIds = &next_present_id;
+                    present_info.pNext = &present_id;
+                    m_present_times[next_present_id % max_tracked_presents] =
+                      std::chrono::steady_clock::now();
+                    m_present_id = next_present_id;
+                }
+
                 VkResult res =
                   vkQueuePresentKHR(m_queue_handler, &present_info);
                 vk_check(res, "vkQueuePresentKHR");
@@ -162,6 +292,20 @@ export namespace vk {
 
             operator VkQueue() const { return m_queue_handler; }
 
+        private:
+            static constexpr uint64_t max_tracked_presents = 8;
+
+            void record_latency(std::chrono::steady_clock::duration p_latency) {
+                const double latency_ms =
+                  std::chrono::duration<double, std::milli>(p_latency).count();
+                m_latency.presents_measured++;
+                m_latency.last_ms = latency_ms;
+                m_latency.max_ms = std::max(m_latency.max_ms, latency_ms);
+                m_latency.average_ms +=
+                  (latency_ms - m_latency.average_ms) /
+                  static_cast<double>(m_latency.presents_measured);
+            }
+
         private:
             VkDevice m_device = nullptr;
             bool m_out_of_date = false;
@@ -169,6 +313,15 @@ export namespace vk {
             VkQueue m_queue_handler = nullptr;
             VkSemaphore m_work_completed = nullptr;
             VkSemaphore m_presentation_completed = nullptr;
+
+            PFN_vkWaitForPresentKHR m_wait_for_present = nullptr;
+            uint64_t m_present_id = 0;
+            uint64_t m_first_present_id = 1;
+            uint64_t m_waited_present_id = 0;
+            std::array<std::chrono::steady_clock::time_point,
+                       max_tracked_presents>
+              m_present_times{};
+            present_latency_stats m_latency{};
         };
     };
 };
\ No newline at end of file
@@ -0,0 +1,411 @@
+module;
+
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstddef>
+#include <vulkan/vulkan.h>
+
+export module vk:descriptor_buffer;
+
+import :types;
+import :utilities;
+import :buffer_device_address;
+import :descriptor_layout_cache;
+
+export namespace vk::dyn {
+    inline namespace v6 {
+
+        /**
+         * @param entries are the bindings of every set stored in the buffer
+         * @param max_sets is the amount of sets the buffer holds
+         * @param memory_mask must be host visible, descriptors are written
+         * directly into the mapped memory
+         */
+        struct descriptor_buffer_params {
+            std::span<const descriptor_entry> entries;
+            uint32_t max_sets = 1;
+            uint32_t memory_mask = 0;
+        };
+
+        /**
+         * @brief Descriptor sets stored directly in a host-visible buffer
+         * through VK_EXT_descriptor_buffer
+         *
+         * Parallel to vk::descriptor_resource but without pools or
+         * VkDescriptorSet handles: vkGetDescriptorEXT writes the descriptor
+         * bytes straight into the mapped buffer, and binding a set is an
+         * offset into it.
+         *
+         * ```
+         *
+         *  [ set 0 | set 1 | set 2 | ... ]   one slice of layout size each
+         *     |
+         *     +-- binding 0 offset --> uniform descriptor bytes
+         *     +-- binding 1 offset --> image descriptor bytes [element 0..n]
+         *
+         * ```
+         *
+         * Requires descriptor_buffer_feature and bufferDeviceAddress to be
+         * enabled. Pipelines reading these sets are created with
+         * VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT in their flags, and
+         * buffers written as descriptors need shader_device_address_bit usage.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::dyn::descriptor_buffer descriptors(physical_device,
+         *      logical_device, vk::dyn::descriptor_buffer_params{
+         *          .entries = entries,
+         *          .max_sets = image_count,
+         *          .memory_mask = host_visible,
+         *      });
+         *
+         * descriptors.write(frame, 0, 0, vk::write_buffer{
+         *      .buffer = camera_ubo,
+         *      .range = sizeof(camera_uniform),
+         * });
+         *
+         * descriptors.bind(current, pipeline.layout(),
+         *      VK_PIPELINE_BIND_POINT_GRAPHICS, 0, frame);
+         *
+         * ```
+         */
+        class descriptor_buffer {
+        public:
+            descriptor_buffer() = default;
+
+            descriptor_buffer(const VkPhysicalDevice& p_physical,
+                              const VkDevice& p_device,
+                              const descriptor_buffer_params& p_params)
+              : m_device(p_device) {
+                load_functions();
+
+                m_properties = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT,
+                };
+                VkPhysicalDeviceProperties2 properties = {
+                    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                    .pNext = &m_properties,
+                };
+                vkGetPhysicalDeviceProperties2(p_physical, &properties);
+
+                m_descriptor_layout = create_descriptor_set_layout(
+                  m_device,
+                  p_params.entries,
+                  descriptor_layout_flags::descriptor_buffer);
+
+                VkDeviceSize layout_size = 0;
+                m_get_layout_size(m_device, m_descriptor_layout, &layout_size);
+                const VkDeviceSize alignment = std::max<VkDeviceSize>(
+                  m_properties.descriptorBufferOffsetAlignment, 1);
+                m_set_stride =
+                  (layout_size + alignment - 1) / alignment * alignment;
+
+                bool has_samplers = false;
+                for (const descriptor_entry& entry : p_params.entries) {
+                    VkDeviceSize offset = 0;
+                    m_get_binding_offset(m_device,
+                                         m_descriptor_layout,
+                                         entry.binding_point.binding,
+                                         &offset);
+                    m_bindings[entry.binding_point.binding] = {
+                        .offset = offset,
+                        .type = static_cast<VkDescriptorType>(entry.type),
+                        .descriptor_count = entry.descriptor_count,
+                    };
+                    has_samplers =
+                      has_samplers or
+                      entry.type == descriptor_type::combined_image_sampler or
+                      entry.type == descriptor_type::sampler_only;
+                }
+
+                buffer_usage usage =
+                  buffer_usage::descriptor_buffer_bit_ext |
+                  buffer_usage::shader_device_address_bit;
+                if (has_samplers) {
+                    usage =
+                      usage | buffer_usage::sampler_descriptor_buffer_bit_ext;
+                }
+                m_usage = static_cast<VkBufferUsageFlags>(usage);
+
+                buffer_parameters buffer_params = {
+                    .memory_mask = p_params.memory_mask,
+                    .usage = usage,
+                    .allocate_flags = memory_allocate_flags::device_address_bit,
+                };
+                m_buffer =
+                  buffer(m_device,
+                         m_set_stride * std::max(p_params.max_sets, 1u),
+                         buffer_params);
+                m_address = m_buffer.get_device_address();
+
+                vk_check(vkMapMemory(m_device,
+                                     m_buffer.device_memory(),
+                                     0,
+                                     VK_WHOLE_SIZE,
+                                     0,
+                                     &m_mapped),
+                         "vkMapMemory");
+            }
+
+            /**
+             * @brief Writes a uniform or storage buffer descriptor
+             *
+             * p_buffer.range must be set, and p_buffer.buffer created with
+             * shader_device_address_bit usage. Dynamic buffers do not exist
+             * with descriptor buffers, offset the set instead.
+             *
+             * @return false, writing nothing, if p_binding is not a uniform
+             * or storage buffer of the layout, or p_array_element or p_set is
+             * out of range
+             */
+            bool write(uint32_t p_set,
+                       uint32_t p_binding,
+                       uint32_t p_array_element,
+                       const write_buffer& p_buffer) {
+                const binding_location* location = find(p_binding);
+                if (location == nullptr) {
+                    return false;
+                }
+
+                VkBufferDeviceAddressInfo buffer_address_info = {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                    .buffer = p_buffer.buffer,
+                };
+                VkDescriptorAddressInfoEXT address_info = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+                    .address = vkGetBufferDeviceAddress(
+                                 m_device, &buffer_address_info) +
+                               p_buffer.offset,
+                    .range = p_buffer.range,
+                    .format = VK_FORMAT_UNDEFINED,
+                };
+
+                VkDescriptorGetInfoEXT descriptor_info = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+                    .type = location->type,
+                };
+                if (location->type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+                    descriptor_info.data.pStorageBuffer = &address_info;
+                }
+                else if (location->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                    descriptor_info.data.pUniformBuffer = &address_info;
+                }
+                else {
+                    return false;
+                }
+
+                return get_descriptor(
+                  p_set, *location, p_array_element, descriptor_info);
+            }
+
+            /**
+             * @brief Writes a combined image sampler, sampled image, storage
+             * image or sampler descriptor, as declared by p_binding
+             *
+             * @return false, writing nothing, if p_binding is not an image or
+             * sampler of the layout, or p_array_element or p_set is out of
+             * range
+             */
+            bool write(uint32_t p_set,
+                       uint32_t p_binding,
+                       uint32_t p_array_element,
+                       const write_image& p_image) {
+                const binding_location* location = find(p_binding);
+                if (location == nullptr) {
+                    return false;
+                }
+
+                VkDescriptorImageInfo image_info = {
+                    .sampler = p_image.sampler,
+                    .imageView = p_image.view,
+                    .imageLayout = static_cast<VkImageLayout>(p_image.layout),
+                };
+
+                VkDescriptorGetInfoEXT descriptor_info = {
+                    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT,
+                    .type = location->type,
+                };
+                switch (location->type) {
+                    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                        descriptor_info.data.pCombinedImageSampler = &image_info;
+                        break;
+                    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                        descriptor_info.data.pSampledImage = &image_info;
+                        break;
+                    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                        descriptor_info.data.pStorageImage = &image_info;
+                        break;
+                    case VK_DESCRIPTOR_TYPE_SAMPLER:
+                        descriptor_info.data.pSampler = &p_image.sampler;
+                        break;
+                    default:
+                        return false;
+                }
+
+                return get_descriptor(
+                  p_set, *location, p_array_element, descriptor_info);
+            }
+
+            /**
+             * @brief Binds the buffer and points p_slot of p_pipeline_layout
+             * at set p_set
+             */
+            void bind(const VkCommandBuffer& p_command,
+                      const VkPipelineLayout& p_pipeline_layout,
+                      uint64_t p_pipeline_bind_point,
+                      uint32_t p_slot,
+                      uint32_t p_set) const {
+                VkDescriptorBufferBindingInfoEXT binding_info = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+                    .pNext = nullptr,
+                    .address = m_address,
+                    .usage = m_usage,
+                };
+                m_bind_descriptor_buffers(p_command, 1, &binding_info);
+
+                const uint32_t buffer_index = 0;
+                const VkDeviceSize offset = p_set * m_set_stride;
+                m_set_descriptor_buffer_offsets(
+                  p_command,
+                  static_cast<VkPipelineBindPoint>(p_pipeline_bind_point),
+                  p_pipeline_layout,
+                  p_slot,
+                  1,
+                  &buffer_index,
+                  &offset);
+            }
+
+            [[nodiscard]] VkDescriptorSetLayout layout() const {
+                return m_descriptor_layout;
+            }
+
+            //! @return the size in bytes of one set, aligned for binding
+            [[nodiscard]] VkDeviceSize set_stride() const {
+                return m_set_stride;
+            }
+
+            [[nodiscard]] bool alive() const { return m_mapped != nullptr; }
+
+            void destruct() {
+                if (m_mapped != nullptr) {
+                    vkUnmapMemory(m_device, m_buffer.device_memory());
+                    m_buffer.reset();
+                    m_mapped = nullptr;
+                }
+
+                if (m_descriptor_layout != nullptr) {
+                    vkDestroyDescriptorSetLayout(
+                      m_device, m_descriptor_layout, nullptr);
+                    m_descriptor_layout = nullptr;
+                }
+            }
+
+        private:
+            struct binding_location {
+                VkDeviceSize offset = 0;
+                VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                uint32_t descriptor_count = 1;
+            };
+
+            //! @return the location of p_binding, null if not in the layout
+            const binding_location* find(uint32_t p_binding) const {
+                auto found = m_bindings.find(p_binding);
+                return (found != m_bindings.end()) ? &found->second : nullptr;
+            }
+
+            //! @return bytes of one descriptor of p_type in the buffer
+            [[nodiscard]] size_t descriptor_size(VkDescriptorType p_type) const {
+                switch (p_type) {
+                    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                        return m_properties.uniformBufferDescriptorSize;
+                    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                        return m_properties.storageBufferDescriptorSize;
+                    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                        return m_properties.combinedImageSamplerDescriptorSize;
+                    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                        return m_properties.sampledImageDescriptorSize;
+                    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                        return m_properties.storageImageDescriptorSize;
+                    case VK_DESCRIPTOR_TYPE_SAMPLER:
+                        return m_properties.samplerDescriptorSize;
+                    default:
+                        return 0;
+                }
+            }
+
+            //! @return false if p_array_element is not an element of the
+            //! binding or the descriptor lies past the buffer
+            bool get_descriptor(uint32_t p_set,
+                                const binding_location& p_location,
+                                uint32_t p_array_element,
+                                const VkDescriptorGetInfoEXT& p_info) {
+                // Past the last element the descriptor would land in the next
+                // binding, which the buffer bound check does not catch
+                if (p_array_element >= p_location.descriptor_count) {
+                    return false;
+                }
+
+                const size_t size = descriptor_size(p_location.type);
+                const VkDeviceSize offset = p_set * m_set_stride +
+                                            p_location.offset +
+                                            p_array_element * size;
+                if (offset + size > m_buffer.size_bytes()) {
+                    return false;
+                }
+
+                m_get_descriptor(m_device,
+                                 &p_info,
+                                 size,
+                                 static_cast<std::byte*>(m_mapped) + offset);
+                return true;
+            }
+
+            void load_functions() {
+                m_get_layout_size =
+                  reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+                    vkGetDeviceProcAddr(m_device,
+                                        "vkGetDescriptorSetLayoutSizeEXT"));
+                m_get_binding_offset =
+                  reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+                    vkGetDeviceProcAddr(
+                      m_device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+                m_get_descriptor = reinterpret_cast<PFN_vkGetDescriptorEXT>(
+                  vkGetDeviceProcAddr(m_device, "vkGetDescriptorEXT"));
+                m_bind_descriptor_buffers =
+                  reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+                    vkGetDeviceProcAddr(m_device,
+                                        "vkCmdBindDescriptorBuffersEXT"));
+                m_set_descriptor_buffer_offsets =
+                  reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+                    vkGetDeviceProcAddr(m_device,
+                                        "vkCmdSetDescriptorBufferOffsetsEXT"));
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            VkPhysicalDeviceDescriptorBufferPropertiesEXT m_properties{};
+            VkDescriptorSetLayout m_descriptor_layout = nullptr;
+            std::unordered_map<uint32_t, binding_location> m_bindings;
+            VkDeviceSize m_set_stride = 0;
+            VkBufferUsageFlags m_usage = 0;
+            buffer m_buffer{};
+            VkDeviceAddress m_address = 0;
+            void* m_mapped = nullptr;
+
+            PFN_vkGetDescriptorSetLayoutSizeEXT m_get_layout_size = nullptr;
+            PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_get_binding_offset =
+              nullptr;
+            PFN_vkGetDescriptorEXT m_get_descriptor = nullptr;
+            PFN_vkCmdBindDescriptorBuffersEXT m_bind_descriptor_buffers =
+              nullptr;
+            PFN_vkCmdSetDescriptorBufferOffsetsEXT
+              m_set_descriptor_buffer_offsets = nullptr;
+        };
+    };
+};
@@ -0,0 +1,902 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <string>
+#include <format>
+#include <filesystem>
+#include <expected>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+export module vk:environment_processor;
+
+export import :types;
+export import :utilities;
+export import :buffer;
+export import :sample_image;
+export import :command_buffer;
+export import :descriptor_resource;
+export import :shader_resource;
+export import :compute_pipeline;
+export import :texture;
+export import :mipmap;
+export import :ktx2;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Compiled SPIR-V of the compute shaders used by
+         * vk::environment_processor
+         *
+         * GLSL sources are in shader_samples/sample10-environment. They are
+         * self-contained, so they compile with glslc or vk::shader_compiler.
+         */
+        struct environment_shaders {
+            std::string equirect_to_cubemap;
+            std::string prefilter_specular;
+            std::string irradiance;
+            std::string brdf_lut;
+        };
+
+        /**
+         * @param cubemap_size is the face size of the skybox cubemap
+         * @param prefiltered_size is the face size of level 0 of the
+         * prefiltered specular cubemap
+         * @param prefiltered_mips is the amount of roughness levels, where
+         * level N is filtered for a roughness of N / (prefiltered_mips - 1)
+         * @param irradiance_size is the face size of the irradiance cubemap
+         * @param brdf_lut_size is the extent of the BRDF lookup table
+         * @param specular_samples, irradiance_samples and brdf_samples are the
+         * amount of importance samples per texel of each pass
+         * @param source_filter is the filter the equirectangular image is
+         * sampled with. Use VK_FILTER_NEAREST if the device does not support
+         * linear filtering of VK_FORMAT_R32G32B32A32_SFLOAT.
+         * @param memory_mask is the device-local memory mask for the images
+         * @param staging_memory_mask is the host-visible memory mask for the
+         * uploads and readbacks
+         * @param cache_directory is where results are stored as KTX2 files.
+         * Caching is disabled when empty.
+         */
+        struct environment_params {
+            uint32_t cubemap_size = 1024;
+            uint32_t prefiltered_size = 256;
+            uint32_t prefiltered_mips = 6;
+            uint32_t irradiance_size = 32;
+            uint32_t brdf_lut_size = 512;
+            uint32_t specular_samples = 1024;
+            uint32_t irradiance_samples = 512;
+            uint32_t brdf_samples = 1024;
+            VkFilter source_filter = VK_FILTER_LINEAR;
+            uint32_t memory_mask = 0;
+            uint32_t staging_memory_mask = 0;
+            environment_shaders shaders{};
+            std::filesystem::path cache_directory{};
+        };
+
+        /**
+         * @brief Image based lighting resources produced by
+         * vk::environment_processor
+         *
+         * Every image is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL with a
+         * clamped linear sampler. Cubemaps are VK_FORMAT_R16G16B16A16_SFLOAT
+         * with VK_IMAGE_VIEW_TYPE_CUBE views.
+         *
+         * @param skybox is the environment as a mipmapped cubemap
+         * @param prefiltered is the specular cubemap, sampled with
+         * textureLod(prefiltered, r, roughness * (prefiltered_mips - 1))
+         * @param irradiance is the diffuse cubemap
+         * @param brdf_lut holds the split-sum scale and bias for F0 in .rg,
+         * indexed by (n.v, roughness)
+         */
+        struct environment_maps {
+            sample_image skybox{};
+            sample_image prefiltered{};
+            sample_image irradiance{};
+            sample_image brdf_lut{};
+            uint32_t prefiltered_mips = 1;
+            bool from_cache = false;
+
+            //! @return true if the maps have been created
+            [[nodiscard]] bool alive() const {
+                return static_cast<VkImage>(skybox) != nullptr;
+            }
+
+            void destruct() {
+                skybox.destruct();
+                prefiltered.destruct();
+                irradiance.destruct();
+                brdf_lut.destruct();
+            }
+        };
+
+        /**
+         * @brief Converts an equirectangular HDR image into the resources
+         * needed for image based lighting with compute shaders
+         *
+         * ```
+         *
+         *  equirect --> skybox cube --blit mips--+--> prefiltered (GGX, per mip)
+         *                                        +--> irradiance (cosine)
+         *                                             brdf_lut (split-sum)
+         *
+         * ```
+         *
+         * Everything is recorded into a single submission. When a cache
+         * directory is set, results are read back and written as KTX2 files
+         * keyed by a hash of the source pixels and the parameters, so later
+         * runs only upload them.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::environment_processor processor(logical_device, {
+         *      .memory_mask = device_local_mask,
+         *      .staging_memory_mask = host_visible_mask,
+         *      .shaders = { ... },
+         *      .cache_directory = "cache/ibl",
+         * });
+         *
+         * float* pixels = stbi_loadf(path, &w, &h, &channels, STBI_rgb_alpha);
+         * vk::environment_maps ibl = processor.process(
+         *      std::span<const float>(pixels, w * h * 4), { w, h });
+         *
+         * ```
+         */
+        class environment_processor {
+            //! @brief Matches the environment_push block of the
+            //! sample10-environment compute shaders
+            struct environment_push {
+                float roughness = 0.f;
+                uint32_t sample_count = 0;
+                uint32_t size = 0;
+                uint32_t source_size = 0;
+            };
+
+            static constexpr VkFormat cubemap_format =
+              VK_FORMAT_R16G16B16A16_SFLOAT;
+            static constexpr uint32_t group_size = 8;
+
+        public:
+            environment_processor() = default;
+
+            environment_processor(const VkDevice& p_device,
+                                  const environment_params& p_params)
+              : m_device(p_device)
+              , m_params(p_params) {
+                m_params.prefiltered_mips =
+                  std::clamp(m_params.prefiltered_mips,
+                             1u,
+                             max_mip_levels({ .width = p_params.prefiltered_size,
+                                              .height =
+                                                p_params.prefiltered_size }));
+
+                const std::array<shader_source, 4> sources = {
+                    shader_source{ .filename =
+                                     p_params.shaders.equirect_to_cubemap,
+                                   .stage = shader_stage::compute },
+                    shader_source{ .filename =
+                                     p_params.shaders.prefilter_specular,
+                                   .stage = shader_stage::compute },
+                    shader_source{ .filename = p_params.shaders.irradiance,
+                                   .stage = shader_stage::compute },
+                    shader_source{ .filename = p_params.shaders.brdf_lut,
+                                   .stage = shader_stage::compute },
+                };
+                m_shaders = shader_resource(m_device, { .sources = sources });
+
+                if (!m_shaders.is_valid()) {
+                    return;
+                }
+
+                // One set per dispatch of compute(), allocated once and
+                // updated every process() since every pass is recorded into
+                // the same submission
+                m_sets.resize(pass_count());
+                for (descriptor_resource& set : m_sets) {
+                    set = create_set();
+                }
+                const std::array<VkDescriptorSetLayout, 1> layouts = {
+                    m_sets.front().layout(),
+                };
+                const std::array<push_constant_range, 1> push_constants = {
+                    push_constant_range{
+                      .stage = shader_stage::compute,
+                      .offset = 0,
+                      .range = sizeof(environment_push),
+                    },
+                };
+
+                for (size_t i = 0; i < m_pipelines.size(); i++) {
+                    m_pipelines[i] = compute_pipeline(
+                      m_device,
+                      { .shader = m_shaders.handles()[i],
+                        .descriptor_layouts = layouts,
+                        .push_constants = push_constants });
+                }
+            }
+
+            //! @return true if the compute shaders were loaded
+            [[nodiscard]] bool alive() const {
+                return m_pipelines.back().alive();
+            }
+
+            /**
+             * @brief Produces the IBL resources from an equirectangular image
+             *
+             * @param p_equirect are tightly packed RGBA float texels, as
+             * returned by stbi_loadf with STBI_rgb_alpha
+             * @param p_extent is the extent of the equirectangular image
+             *
+             * @return the maps, loaded from the cache if a matching entry
+             * exists. alive() is false if the processor is not alive.
+             */
+            [[nodiscard]] environment_maps process(
+              std::span<const float> p_equirect,
+              const image_extent& p_extent) {
+                environment_maps maps{ .prefiltered_mips =
+                                         m_params.prefiltered_mips };
+
+                if (!alive() or
+                    p_equirect.size() <
+                      uint64_t{ p_extent.width } * p_extent.height * 4) {
+                    return maps;
+                }
+
+                const uint64_t key = cache_key(p_equirect, p_extent);
+                if (!m_params.cache_directory.empty() and
+                    load_cache(key, maps)) {
+                    maps.from_cache = true;
+                    return maps;
+                }
+
+                compute(p_equirect, p_extent, key, maps);
+                return maps;
+            }
+
+            void destruct() {
+                for (auto& pipeline : m_pipelines) {
+                    if (pipeline.alive()) {
+                        pipeline.destruct();
+                    }
+                }
+                for (auto& set : m_sets) {
+                    set.destruct();
+                }
+                m_sets.clear();
+                m_shaders.destruct();
+            }
+
+        private:
+            //! @return the amount of dispatches recorded by compute(): the
+            //! skybox, one per prefiltered level, irradiance and the BRDF LUT
+            [[nodiscard]] size_t pass_count() const {
+                return 3 + m_params.prefiltered_mips;
+            }
+
+            //! @brief set 0 of every pass: binding 0 is the sampled source and
+            //! binding 1 is the storage image written to
+            descriptor_resource create_set() {
+                std::array<descriptor_entry, 2> entries = {
+                    descriptor_entry{
+                      .type = descriptor_type::combined_image_sampler,
+                      .binding_point = { .binding = 0,
+                                         .stage = shader_stage::compute },
+                      .descriptor_count = 1,
+                    },
+                    descriptor_entry{
+                      .type = descriptor_type::storage_image,
+                      .binding_point = { .binding = 1,
+                                         .stage = shader_stage::compute },
+                      .descriptor_count = 1,
+                    },
+                };
+                return descriptor_resource(
+                  m_device,
+                  descriptor_layout{
+                    .slot = 0, .max_sets = 1, .entries = entries });
+            }
+
+            //! @return a 2D array view of a single mip level for imageStore
+            VkImageView storage_view(const VkImage& p_image,
+                                     uint32_t p_level,
+                                     uint32_t p_layer_count) {
+                VkImageViewCreateInfo image_view_ci = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .image = p_image,
+                    .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                    .format = cubemap_format,
+                    .components = {
+                        .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    },
+                    .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = p_level,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = p_layer_count,
+                    },
+                };
+
+                VkImageView view = nullptr;
+                vk_check(
+                  vkCreateImageView(m_device, &image_view_ci, nullptr, &view),
+                  "vkCreateImageView");
+                m_storage_views.push_back(view);
+                return view;
+            }
+
+            image_params output_params(uint32_t p_size,
+                                       uint32_t p_mip_levels,
+                                       bool p_cubemap,
+                                       image_usage p_usage) const {
+                const uint32_t layers = p_cubemap ? 6 : 1;
+                return image_params{
+                    .extent = { .width = p_size, .height = p_size },
+                    .format = cubemap_format,
+                    .memory_mask = m_params.memory_mask,
+                    .usage = p_usage,
+                    .image_flags =
+                      p_cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u,
+                    .view_type = p_cubemap ? VK_IMAGE_VIEW_TYPE_CUBE
+                                           : VK_IMAGE_VIEW_TYPE_2D,
+                    .mip_levels = p_mip_levels,
+                    .layer_count = layers,
+                    .array_layers = layers,
+                    .address_mode_u = sampler_address_mode::clamp_to_edge,
+                    .addrses_mode_v = sampler_address_mode::clamp_to_edge,
+                    .addrses_mode_w = sampler_address_mode::clamp_to_edge,
+                };
+            }
+
+            //! @brief layout transition of every subresource of p_image
+            void transition(const VkCommandBuffer& p_command,
+                            const VkImage& p_image,
+                            VkImageLayout p_old,
+                            VkImageLayout p_new,
+                            VkPipelineStageFlags p_src_stage,
+                            VkAccessFlags p_src_access,
+                            VkPipelineStageFlags p_dst_stage,
+                            VkAccessFlags p_dst_access) {
+                VkImageMemoryBarrier barrier = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = p_src_access,
+                    .dstAccessMask = p_dst_access,
+                    .oldLayout = p_old,
+                    .newLayout = p_new,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = p_image,
+                    .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                          .baseMipLevel = 0,
+                                          .levelCount = VK_REMAINING_MIP_LEVELS,
+                                          .baseArrayLayer = 0,
+                                          .layerCount = VK_REMAINING_ARRAY_LAYERS },
+                };
+                vkCmdPipelineBarrier(p_command,
+                                     p_src_stage,
+                                     p_dst_stage,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr,
+                                     1,
+                                     &barrier);
+            }
+
+            /**
+             * @brief Makes transfer writes visible to compute shaders
+             *
+             * The layout transitions done by sample_image finish in the
+             * fragment stage, so the fragment stage is included to chain with
+             * them.
+             */
+            void transfer_to_compute(const VkCommandBuffer& p_command) {
+                VkMemoryBarrier barrier = {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                };
+                vkCmdPipelineBarrier(p_command,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0,
+                                     1,
+                                     &barrier,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr);
+            }
+
+            //! @brief Records compute pass p_pass writing p_target from
+            //! p_source, updating the pass's descriptor set
+            void dispatch(command_buffer& p_command,
+                          size_t p_pass,
+                          compute_pipeline& p_pipeline,
+                          const sample_image& p_source,
+                          const VkImageView& p_target,
+                          const environment_push& p_push,
+                          uint32_t p_layers) {
+                descriptor_resource& set = m_sets[p_pass];
+
+                const std::array<write_image, 1> source = {
+                    write_image{ .sampler = p_source.sampler(),
+                                 .view = p_source.image_view(),
+                                 .layout =
+                                   image_layout::shader_read_only_optimal },
+                };
+                const std::array<write_image, 1> target = {
+                    write_image{ .sampler = nullptr,
+                                 .view = p_target,
+                                 .layout = image_layout::general },
+                };
+                const std::array<write_image_descriptor, 2> writes = {
+                    write_image_descriptor{ .dst_binding = 0,
+                                            .sample_images = source },
+                    write_image_descriptor{ .dst_binding = 1,
+                                            .sample_images = target },
+                };
+                set.update({}, writes);
+
+                p_pipeline.bind(p_command);
+                const std::array<VkDescriptorSet, 1> sets = { set };
+                p_command.bind_descriptors(
+                  p_pipeline.layout(), VK_PIPELINE_BIND_POINT_COMPUTE, sets);
+                p_pipeline.push_constant(p_command, p_push);
+
+                const uint32_t groups = (p_push.size + group_size - 1) /
+                                        group_size;
+                p_command.dispatch(groups, groups, p_layers);
+            }
+
+            void compute(std::span<const float> p_equirect,
+                         const image_extent& p_extent,
+                         uint64_t p_key,
+                         environment_maps& p_maps) {
+                const uint32_t cubemap_mips = max_mip_levels(
+                  { .width = m_params.cubemap_size,
+                    .height = m_params.cubemap_size });
+                const image_usage output_usage = image_usage::storage_bit |
+                                                 image_usage::sampled_bit |
+                                                 image_usage::transfer_src_bit;
+
+                p_maps.skybox = sample_image(
+                  m_device,
+                  output_params(m_params.cubemap_size,
+                                cubemap_mips,
+                                true,
+                                output_usage | image_usage::transfer_dst_bit));
+                p_maps.prefiltered = sample_image(
+                  m_device,
+                  output_params(m_params.prefiltered_size,
+                                m_params.prefiltered_mips,
+                                true,
+                                output_usage));
+                p_maps.irradiance = sample_image(
+                  m_device,
+                  output_params(
+                    m_params.irradiance_size, 1, true, output_usage));
+                p_maps.brdf_lut = sample_image(
+                  m_device,
+                  output_params(
+                    m_params.brdf_lut_size, 1, false, output_usage));
+
+                const std::array<sample_image*, 4> outputs = {
+                    &p_maps.skybox,
+                    &p_maps.prefiltered,
+                    &p_maps.irradiance,
+                    &p_maps.brdf_lut,
+                };
+
+                command_buffer command(
+                  m_device,
+                  command_params{ .levels = command_levels::primary,
+                                  .queue_index = 0,
+                                  .flags = command_pool_flags::reset });
+                command.begin(command_usage::one_time_submit);
+
+                // Upload the equirectangular source
+                const std::span<const uint8_t> source_bytes(
+                  reinterpret_cast<const uint8_t*>(p_equirect.data()),
+                  p_equirect.size_bytes());
+                buffer staging(m_device,
+                               source_bytes.size(),
+                               { .memory_mask = m_params.staging_memory_mask,
+                                 .usage = buffer_usage::transfer_src_bit });
+                staging.transfer(source_bytes);
+
+                image_params source_params = {
+                    .extent = p_extent,
+                    .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                    .memory_mask = m_params.memory_mask,
+                    .usage =
+                      image_usage::transfer_dst_bit | image_usage::sampled_bit,
+                    .range = { .min = m_params.source_filter,
+                               .max = m_params.source_filter },
+                    .address_mode_u = sampler_address_mode::repeat,
+                    .addrses_mode_v = sampler_address_mode::clamp_to_edge,
+                    .addrses_mode_w = sampler_address_mode::clamp_to_edge,
+                };
+                const std::array<buffer_image_copy, 1> source_region = {
+                    copy_region(p_extent, 0, 0),
+                };
+                texture source(m_device);
+                source.record_upload(
+                  command, staging, source_region, source_params, false);
+
+                for (sample_image* output : outputs) {
+                    transition(command,
+                               *output,
+                               VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_GENERAL,
+                               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               0,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               VK_ACCESS_SHADER_WRITE_BIT);
+                }
+                transfer_to_compute(command);
+
+                // 1. Equirectangular to the faces of level 0 of the skybox
+                size_t pass = 0;
+                dispatch(command,
+                         pass++,
+                         m_pipelines[0],
+                         source.image(),
+                         storage_view(p_maps.skybox, 0, 6),
+                         { .size = m_params.cubemap_size,
+                           .source_size = p_extent.width },
+                         6);
+
+                // 2. Remaining skybox levels are blitted so the filtering
+                // passes can read pre-averaged radiance
+                transition(command,
+                           p_maps.skybox,
+                           VK_IMAGE_LAYOUT_GENERAL,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_ACCESS_TRANSFER_READ_BIT |
+                             VK_ACCESS_TRANSFER_WRITE_BIT);
+                p_maps.skybox.generate_mipmaps(
+                  command,
+                  { .width = m_params.cubemap_size,
+                    .height = m_params.cubemap_size },
+                  cubemap_mips,
+                  6);
+                transfer_to_compute(command);
+
+                // 3. Specular, one roughness per level
+                for (uint32_t level = 0; level < m_params.prefiltered_mips;
+                     level++) {
+                    const float roughness =
+                      (m_params.prefiltered_mips > 1)
+                        ? static_cast<float>(level) /
+                            static_cast<float>(m_params.prefiltered_mips - 1)
+                        : 0.f;
+                    dispatch(
+                      command,
+                      pass++,
+                      m_pipelines[1],
+                      p_maps.skybox,
+                      storage_view(p_maps.prefiltered, level, 6),
+                      { .roughness = roughness,
+                        .sample_count = m_params.specular_samples,
+                        .size = std::max(m_params.prefiltered_size >> level, 1u),
+                        .source_size = m_params.cubemap_size },
+                      6);
+                }
+
+                // 4. Diffuse irradiance
+                dispatch(command,
+                         pass++,
+                         m_pipelines[2],
+                         p_maps.skybox,
+                         storage_view(p_maps.irradiance, 0, 6),
+                         { .sample_count = m_params.irradiance_samples,
+                           .size = m_params.irradiance_size,
+                           .source_size = m_params.cubemap_size },
+                         6);
+
+                // 5. BRDF lookup table, binding 0 is unused by the shader
+                dispatch(command,
+                         pass++,
+                         m_pipelines[3],
+                         p_maps.skybox,
+                         storage_view(p_maps.brdf_lut, 0, 1),
+                         { .sample_count = m_params.brdf_samples,
+                           .size = m_params.brdf_lut_size },
+                         1);
+
+                const bool write_cache = !m_params.cache_directory.empty();
+                std::array<ktx2_texture, 4> cached{};
+                buffer readback{};
+
+                if (write_cache) {
+                    uint64_t offset = 0;
+                    for (size_t i = 0; i < outputs.size(); i++) {
+                        cached[i] = cache_texture(i);
+                        for (auto& region : cached[i].regions) {
+                            region.offset += offset;
+                        }
+                        const auto& last = cached[i].regions.back();
+                        offset = align(
+                          last.offset +
+                            (image_level_size(cubemap_format,
+                                              cached[i].extent,
+                                              last.mip_level) *
+                             cached[i].layer_count()),
+                          16);
+                    }
+
+                    readback = buffer(
+                      m_device,
+                      offset,
+                      { .memory_mask = m_params.staging_memory_mask,
+                        .usage = buffer_usage::transfer_dst_bit });
+
+                    // The skybox is only read, the rest is in GENERAL after
+                    // being written to
+                    transition(command,
+                               p_maps.skybox,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               0,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_ACCESS_TRANSFER_READ_BIT);
+                    for (size_t i = 1; i < outputs.size(); i++) {
+                        transition(command,
+                                   *outputs[i],
+                                   VK_IMAGE_LAYOUT_GENERAL,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   VK_ACCESS_SHADER_WRITE_BIT,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_ACCESS_TRANSFER_READ_BIT);
+                    }
+
+                    for (size_t i = 0; i < outputs.size(); i++) {
+                        readback.copy_from_image(
+                          command, *outputs[i], cached[i].regions);
+                        transition(command,
+                                   *outputs[i],
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   0,
+                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                   VK_ACCESS_SHADER_READ_BIT);
+                    }
+                }
+                else {
+                    for (size_t i = 1; i < outputs.size(); i++) {
+                        transition(command,
+                                   *outputs[i],
+                                   VK_IMAGE_LAYOUT_GENERAL,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   VK_ACCESS_SHADER_WRITE_BIT,
+                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                   VK_ACCESS_SHADER_READ_BIT);
+                    }
+                }
+
+                command.end();
+                submit(command);
+
+                if (write_cache) {
+                    const std::span<uint8_t> bytes = readback.map();
+                    std::filesystem::create_directories(
+                      m_params.cache_directory);
+
+                    for (size_t i = 0; i < cached.size(); i++) {
+                        // Rebase the regions to the start of this image
+                        const uint64_t base = cached[i].regions.front().offset;
+                        const auto& last = cached[i].regions.back();
+                        const uint64_t end =
+                          last.offset + (image_level_size(cubemap_format,
+                                                          cached[i].extent,
+                                                          last.mip_level) *
+                                         cached[i].layer_count());
+                        cached[i].bytes.assign(bytes.begin() + base,
+                                               bytes.begin() + end);
+                        for (auto& region : cached[i].regions) {
+                            region.offset -= base;
+                        }
+
+                        // A failed write only means the next run recomputes
+                        (void)save_ktx2(cache_path(p_key, i), cached[i]);
+                    }
+                    readback.destruct();
+                }
+
+                for (VkImageView view : m_storage_views) {
+                    vkDestroyImageView(m_device, view, nullptr);
+                }
+                m_storage_views.clear();
+
+                source.destruct();
+                staging.destruct();
+                command.destruct();
+            }
+
+            //! @return the KTX2 description of output p_index with regions
+            //! laid out for a tightly packed readback
+            ktx2_texture cache_texture(size_t p_index) const {
+                const std::array<uint32_t, 4> sizes = {
+                    m_params.cubemap_size,
+                    m_params.prefiltered_size,
+                    m_params.irradiance_size,
+                    m_params.brdf_lut_size,
+                };
+                const uint32_t mips =
+                  (p_index == 0)
+                    ? max_mip_levels({ .width = m_params.cubemap_size,
+                                       .height = m_params.cubemap_size })
+                  : (p_index == 1) ? m_params.prefiltered_mips
+                                   : 1;
+                const uint32_t faces = (p_index == 3) ? 1 : 6;
+                const image_extent extent = { .width = sizes[p_index],
+                                              .height = sizes[p_index] };
+
+                return ktx2_texture{
+                    .format = cubemap_format,
+                    .extent = extent,
+                    .mip_levels = mips,
+                    .array_layers = 1,
+                    .face_count = faces,
+                    .regions =
+                      copy_regions(cubemap_format, extent, mips, faces),
+                };
+            }
+
+            /**
+             * @brief Uploads every cached KTX2 file of p_key
+             *
+             * @return false if any of the files is missing or does not match
+             * the current parameters, in which case nothing is created
+             */
+            bool load_cache(uint64_t p_key, environment_maps& p_maps) {
+                std::array<ktx2_texture, 4> files{};
+                for (size_t i = 0; i < files.size(); i++) {
+                    std::expected<ktx2_texture, ktx2_error> ktx =
+                      load_ktx2(cache_path(p_key, i));
+                    const ktx2_texture expected = cache_texture(i);
+
+                    if (!ktx.has_value() or ktx->format != expected.format or
+                        ktx->extent.width != expected.extent.width or
+                        ktx->mip_levels != expected.mip_levels or
+                        ktx->face_count != expected.face_count) {
+                        return false;
+                    }
+                    files[i] = std::move(ktx.value());
+                }
+
+                command_buffer command(
+                  m_device,
+                  command_params{ .levels = command_levels::primary,
+                                  .queue_index = 0,
+                                  .flags = command_pool_flags::reset });
+                command.begin(command_usage::one_time_submit);
+
+                std::array<buffer, 4> staging{};
+                std::array<sample_image*, 4> outputs = {
+                    &p_maps.skybox,
+                    &p_maps.prefiltered,
+                    &p_maps.irradiance,
+                    &p_maps.brdf_lut,
+                };
+                for (size_t i = 0; i < files.size(); i++) {
+                    staging[i] =
+                      buffer(m_device,
+                             files[i].bytes.size(),
+                             { .memory_mask = m_params.staging_memory_mask,
+                               .usage = buffer_usage::transfer_src_bit });
+                    staging[i].transfer(files[i].bytes);
+
+                    image_params params = files[i].params(m_params.memory_mask);
+                    params.address_mode_u = sampler_address_mode::clamp_to_edge;
+                    params.addrses_mode_v = sampler_address_mode::clamp_to_edge;
+                    params.addrses_mode_w = sampler_address_mode::clamp_to_edge;
+
+                    texture loaded(m_device);
+                    loaded.record_upload(
+                      command, staging[i], files[i].regions, params, false);
+                    *outputs[i] = loaded.image();
+                }
+
+                command.end();
+                submit(command);
+
+                for (auto& buffer : staging) {
+                    buffer.destruct();
+                }
+                command.destruct();
+                return true;
+            }
+
+            void submit(const command_buffer& p_command) {
+                VkQueue queue = nullptr;
+                vkGetDeviceQueue(m_device, 0, 0, &queue);
+
+                const VkCommandBuffer handle = p_command;
+                VkSubmitInfo submit_info = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers = &handle,
+                };
+                vk_check(vkQueueSubmit(queue, 1, &submit_info, nullptr),
+                         "vkQueueSubmit");
+                vkQueueWaitIdle(queue);
+            }
+
+            //! @brief Hash of the source texels and every parameter that
+            //! changes the results
+            uint64_t cache_key(std::span<const float> p_equirect,
+                               const image_extent& p_extent) const {
+
+                const std::array<uint32_t, 11> settings = {
+                    p_extent.width,
+                    p_extent.height,
+                    m_params.cubemap_size,
+                    m_params.prefiltered_size,
+                    m_params.prefiltered_mips,
+                    m_params.irradiance_size,
+                    m_params.brdf_lut_size,
+                    m_params.specular_samples,
+                    m_params.irradiance_samples,
+                    m_params.brdf_samples,
+                    static_cast<uint32_t>(m_params.source_filter),
+                };
+                uint64_t settings_hash =
+                  hash_bytes(std::as_bytes(std::span(settings)));
+
+                // Results are stale once a pass is recompiled, even with the
+                // same filenames
+                for (const shader_handle& shader : m_shaders.handles()) {
+                    settings_hash =
+                      hash_combine(settings_hash, spirv_hash(shader.code));
+                }
+                return hash_bytes(std::as_bytes(p_equirect), settings_hash);
+            }
+
+            std::filesystem::path cache_path(uint64_t p_key,
+                                             size_t p_index) const {
+                static constexpr std::array<const char*, 4> names = {
+                    "skybox", "prefiltered", "irradiance", "brdf_lut"
+                };
+                return m_params.cache_directory /
+                       std::format("{:016x}_{}.ktx2", p_key, names[p_index]);
+            }
+
+            static uint64_t align(uint64_t p_value, uint64_t p_alignment) {
+                return ((p_value + p_alignment - 1) / p_alignment) *
+                       p_alignment;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            environment_params m_params{};
+            shader_resource m_shaders{};
+            std::array<compute_pipeline, 4> m_pipelines{};
+            std::vector<descriptor_resource> m_sets;
+            std::vector<VkImageView> m_storage_views;
+        };
+    };
+};
@@ -104,7 +104,8 @@ export namespace vk {
           VkPhysicalDeviceShaderObjectFeaturesEXT,
           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT>;
 
-        //! @brief Handled dynamic pipeline states
+        //! @brief Pipelines linked from separately created parts, used by
+        //! pipeline_library_cache
         using pipeline_library = feature_trait<
           VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT,
           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT>;
@@ -0,0 +1,398 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+export module vk:headless;
+
+export import :types;
+export import :utilities;
+export import :buffer;
+export import :command_buffer;
+export import :sample_image;
+export import :framebuffer;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Settings of a vk::headless_target
+         *
+         * @param extent is the size of every color image
+         * @param format is the color format, formats lavapipe renders to are
+         * R8G8B8A8_UNORM and B8G8R8A8_UNORM
+         * @param image_count is the amount of images rendered round robin,
+         * the counterpart of swapchain images, at least 1
+         * @param memory_mask is the device local memory of the images
+         * @param readback_memory_mask is host visible and coherent memory the
+         * images are copied to, 0 disables readback
+         * @param renderpass creates a framebuffer per image when set
+         * @param depth_format creates a depth image per image when not
+         * VK_FORMAT_UNDEFINED
+         * @param attachment_layout is the layout the color image is left in by
+         * the recorded commands (the renderpass final layout)
+         * @param queue is the queue family and index submitted to
+         */
+        struct headless_target_params {
+            VkExtent2D extent{};
+            VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+            uint32_t image_count = 2;
+            uint32_t memory_mask = 0;
+            uint32_t readback_memory_mask = 0;
+            VkRenderPass renderpass = nullptr;
+            VkFormat depth_format = VK_FORMAT_UNDEFINED;
+            VkImageLayout attachment_layout =
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            queue_params queue{ .family = 0, .index = 0 };
+        };
+
+        /**
+         * @brief Renders into a ring of offscreen images instead of a
+         * swapchain, so no window, surface or WSI extension is required
+         *
+         * Stands in for vk::swapchain and vk::device_present_queue on render
+         * farms, CI and software drivers such as lavapipe. Each submit appends
+         * a copy of the rendered image into a host visible buffer, readable
+         * with readback() once the image's fence signals. The fence is only
+         * waited on when the image comes around again, so image_count frames
+         * stay in flight.
+         *
+         * ```
+         *
+         *  acquire_next_image -> record -> submit [commands | copy] -> fence
+         *        ^                                                     |
+         *        +------------ image_count frames later ---------------+
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::headless_target target(logical_device, {
+         *      .extent = { 1920, 1080 },
+         *      .memory_mask = device_local,
+         *      .readback_memory_mask = host_visible,
+         *      .renderpass = main_renderpass,
+         * });
+         *
+         * uint32_t image = 0;
+         * for (uint32_t frame = 0; frame < frames; frame++) {
+         *      image = target.acquire_next_image();
+         *      // record into command using target.framebuffer(image)
+         *      target.submit(std::array{ VkCommandBuffer(command) });
+         * }
+         * std::span<const std::byte> pixels = target.readback(image);
+         *
+         * ```
+         */
+        class headless_target {
+        public:
+            headless_target() = default;
+
+            headless_target(const VkDevice& p_device,
+                            const headless_target_params& p_params)
+              : m_device(p_device)
+              , m_params(p_params) {
+                // Nothing to render into, alive() stays false
+                if (m_params.image_count == 0) {
+                    return;
+                }
+                m_current = m_params.image_count - 1;
+
+                vkGetDeviceQueue(m_device,
+                                 m_params.queue.family,
+                                 m_params.queue.index,
+                                 &m_queue);
+
+                m_frames.resize(m_params.image_count);
+                for (frame_target& frame : m_frames) {
+                    construct(frame);
+                }
+            }
+
+            /**
+             * @brief Waits until the next image of the ring is no longer in
+             * flight
+             *
+             * @return the index of the image to render into
+             */
+            uint32_t acquire_next_image() {
+                m_current = (m_current + 1) % m_params.image_count;
+                wait(m_frames[m_current]);
+                return m_current;
+            }
+
+            /**
+             * @brief Submits p_commands rendering into the acquired image,
+             * followed by the copy into its readback buffer
+             */
+            void submit(std::span<const VkCommandBuffer> p_commands) {
+                frame_target& frame = m_frames[m_current];
+
+                m_submit_commands.assign(p_commands.begin(), p_commands.end());
+                if (!frame.mapped.empty()) {
+                    m_submit_commands.push_back(frame.copy);
+                }
+
+                VkSubmitInfo submit_info = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .commandBufferCount =
+                      static_cast<uint32_t>(m_submit_commands.size()),
+                    .pCommandBuffers = m_submit_commands.data(),
+                };
+                vk_check(vkResetFences(m_device, 1, &frame.fence),
+                         "vkResetFences");
+                vk_check(vkQueueSubmit(m_queue, 1, &submit_info, frame.fence),
+                         "vkQueueSubmit");
+                frame.submitted = true;
+            }
+
+            /**
+             * @brief Waits for the last submit of p_image and returns its
+             * pixels
+             *
+             * Rows are tightly packed, extent().width texels each. The bytes
+             * are overwritten the next time p_image is submitted.
+             *
+             * @return empty when readback is disabled
+             */
+            [[nodiscard]] std::span<const std::byte> readback(
+              uint32_t p_image) {
+                frame_target& frame = m_frames[p_image];
+                if (frame.mapped.empty()) {
+                    return {};
+                }
+                wait(frame);
+                return std::as_bytes(frame.mapped);
+            }
+
+            [[nodiscard]] uint32_t image_count() const {
+                return m_params.image_count;
+            }
+
+            [[nodiscard]] VkExtent2D extent() const { return m_params.extent; }
+
+            [[nodiscard]] VkFormat format() const { return m_params.format; }
+
+            [[nodiscard]] sample_image& image(uint32_t p_image) {
+                return m_frames[p_image].color;
+            }
+
+            [[nodiscard]] sample_image& depth_image(uint32_t p_image) {
+                return m_frames[p_image].depth;
+            }
+
+            [[nodiscard]] VkFramebuffer framebuffer(uint32_t p_image) const {
+                return m_frames[p_image].target;
+            }
+
+            [[nodiscard]] bool alive() const { return !m_frames.empty(); }
+
+            void destruct() {
+                for (frame_target& frame : m_frames) {
+                    wait(frame);
+                    frame.target.destruct();
+                    frame.color.destruct();
+                    if (frame.depth.image_view() != nullptr) {
+                        frame.depth.destruct();
+                    }
+                    // Only created when readback is enabled
+                    if (!frame.mapped.empty()) {
+                        frame.copy.destruct();
+                        frame.readback.destruct();
+                    }
+                    vkDestroyFence(m_device, frame.fence, nullptr);
+                }
+                m_frames.clear();
+            }
+
+        private:
+            struct frame_target {
+                sample_image color{};
+                sample_image depth{};
+                vk::framebuffer target{};
+                buffer readback{};
+                std::span<uint8_t> mapped;
+                command_buffer copy{};
+                VkFence fence = nullptr;
+                bool submitted = false;
+            };
+
+            void construct(frame_target& p_frame) {
+                const image_extent extent = {
+                    .width = m_params.extent.width,
+                    .height = m_params.extent.height,
+                };
+
+                p_frame.color = sample_image(
+                  m_device,
+                  image_params{
+                    .extent = extent,
+                    .format = m_params.format,
+                    .memory_mask = m_params.memory_mask,
+                    .aspect = image_aspect_flags::color_bit,
+                    .usage = image_usage::color_attachment_bit |
+                             image_usage::transfer_src_bit,
+                  });
+
+                std::array<VkImageView, 2> views = {
+                    p_frame.color.image_view(),
+                    nullptr,
+                };
+                uint32_t view_count = 1;
+                if (m_params.depth_format != VK_FORMAT_UNDEFINED) {
+                    p_frame.depth = sample_image(
+                      m_device,
+                      image_params{
+                        .extent = extent,
+                        .format = m_params.depth_format,
+                        .memory_mask = m_params.memory_mask,
+                        .aspect = image_aspect_flags::depth_bit,
+                        .usage = image_usage::depth_stencil_bit,
+                      });
+                    views[view_count++] = p_frame.depth.image_view();
+                }
+
+                if (m_params.renderpass != nullptr) {
+                    p_frame.target = vk::framebuffer(
+                      m_device,
+                      framebuffer_params{
+                        .renderpass = m_params.renderpass,
+                        .views = std::span<VkImageView>(views.data(),
+                                                        view_count),
+                        .extent = m_params.extent,
+                      });
+                }
+
+                VkFenceCreateInfo fence_ci = {
+                    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                };
+                vk_check(
+                  vkCreateFence(m_device, &fence_ci, nullptr, &p_frame.fence),
+                  "vkCreateFence");
+
+                if (m_params.readback_memory_mask == 0) {
+                    return;
+                }
+
+                const uint64_t size_bytes =
+                  static_cast<uint64_t>(m_params.extent.width) *
+                  m_params.extent.height * texel_block(m_params.format).bytes;
+                p_frame.readback = buffer(
+                  m_device,
+                  size_bytes,
+                  buffer_parameters{
+                    .memory_mask = m_params.readback_memory_mask,
+                    .usage = buffer_usage::transfer_dst_bit,
+                  });
+                p_frame.mapped = p_frame.readback.map();
+
+                // The copy is identical every frame, so it is recorded once
+                p_frame.copy = command_buffer(
+                  m_device,
+                  command_params{
+                    .levels = command_levels::primary,
+                    .queue_index = m_params.queue.family,
+                    .flags = command_pool_flags::reset,
+                  });
+                p_frame.copy.begin(command_usage::simulatneous_use_bit);
+                record_copy(p_frame);
+                p_frame.copy.end();
+            }
+
+            void record_copy(frame_target& p_frame) {
+                VkImageMemoryBarrier to_transfer = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                    .oldLayout = m_params.attachment_layout,
+                    .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = p_frame.color,
+                    .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .levelCount = 1,
+                        .layerCount = 1,
+                    },
+                };
+                vkCmdPipelineBarrier(
+                  p_frame.copy,
+                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  0,
+                  0,
+                  nullptr,
+                  0,
+                  nullptr,
+                  1,
+                  &to_transfer);
+
+                std::array<buffer_image_copy, 1> regions = {
+                    buffer_image_copy{
+                      .image_extent = { .width = m_params.extent.width,
+                                        .height = m_params.extent.height },
+                    },
+                };
+                p_frame.readback.copy_from_image(
+                  p_frame.copy, p_frame.color, regions);
+
+                // Back to the attachment layout for the next frame, and make
+                // the copy visible to the host once the fence signals
+                VkImageMemoryBarrier to_attachment = to_transfer;
+                to_attachment.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                to_attachment.dstAccessMask =
+                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                to_attachment.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                to_attachment.newLayout = m_params.attachment_layout;
+
+                VkMemoryBarrier to_host = {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                };
+                vkCmdPipelineBarrier(
+                  p_frame.copy,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                    VK_PIPELINE_STAGE_HOST_BIT,
+                  0,
+                  1,
+                  &to_host,
+                  0,
+                  nullptr,
+                  1,
+                  &to_attachment);
+            }
+
+            void wait(frame_target& p_frame) {
+                if (!p_frame.submitted) {
+                    return;
+                }
+                vk_check(vkWaitForFences(m_device,
+                                         1,
+                                         &p_frame.fence,
+                                         true,
+                                         std::numeric_limits<uint64_t>::max()),
+                         "vkWaitForFences");
+                p_frame.submitted = false;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            VkQueue m_queue = nullptr;
+            headless_target_params m_params{};
+            uint32_t m_current = 0;
+            std::vector<frame_target> m_frames;
+            std::vector<VkCommandBuffer> m_submit_commands;
+        };
+    };
+};
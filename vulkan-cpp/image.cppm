@@ -2,6 +2,8 @@ module;
 
 #include <string_view>
 #include <span>
+#include <functional>
+#include <cstring>
 
 export module vk:image;
 
@@ -10,6 +12,13 @@ import :types;
 export namespace vk {
     inline namespace v6 {
 
+        /**
+         * @brief Returns the memory an image of the given extent and size in
+         * bytes is decoded into, or an empty span to abort the decode
+         */
+        using decode_target =
+          std::function<std::span<uint8_t>(const image_extent&, uint64_t)>;
+
         /**
          * @brief interface for the purpose of acting as an interface to
          * different implementations for support variety of approaches in
@@ -41,7 +50,50 @@ export namespace vk {
              */
             [[nodiscard]] image_extent extent() const { return image_extent(); }
 
+            /**
+             * @brief Decodes p_path into the memory returned by p_target
+             *
+             * p_target is called once the size of the image is known. Unlike
+             * load(), the texels are not kept by the implementation.
+             *
+             * @return false if the image could not be decoded or p_target
+             * returned less memory than the image needs
+             */
+            bool load_into(std::string_view p_path,
+                           texture_params p_params,
+                           const decode_target& p_target) {
+                return image_load_into(p_path, p_params, p_target);
+            }
+
         protected:
+            /**
+             * @brief Implementations that can decode into caller memory (e.g.
+             * by reading the header first) override this to skip the copy
+             * the default performs out of their own buffer
+             */
+            virtual bool image_load_into(std::string_view p_path,
+                                         texture_params p_params,
+                                         const decode_target& p_target) {
+                if (!image_load(p_path, p_params)) {
+                    return false;
+                }
+
+                const std::span<const uint8_t> texels = image_read();
+                if (texels.empty()) {
+                    return false;
+                }
+
+                const std::span<uint8_t> destination =
+                  p_target(image_extent(), texels.size_bytes());
+                if (destination.size_bytes() < texels.size_bytes()) {
+                    return false;
+                }
+
+                std::memcpy(
+                  destination.data(), texels.data(), texels.size_bytes());
+                return true;
+            }
+
             virtual bool image_load(std::string_view, texture_params) = 0;
 
             virtual std::span<const uint8_t> image_read() const = 0;
@@ -0,0 +1,521 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+export module vk:image_decoder;
+
+export import :types;
+export import :utilities;
+export import :buffer;
+export import :command_buffer;
+export import :image;
+export import :texture;
+export import :mipmap;
+
+export namespace vk {
+    inline namespace v6 {
+
+        enum class decode_status : uint8_t {
+            queued,
+            decoding,
+            decoded,
+            uploading,
+            ready,
+            failed,
+        };
+
+        /**
+         * @param worker_count is the amount of decode threads. 0 uses
+         * std::thread::hardware_concurrency()
+         * @param staging_block_size is the size of each pooled staging buffer.
+         * A decode that does not fit into a block gets its own staging buffer.
+         * @param max_staging_blocks is the maximum amount of pooled blocks.
+         * Workers wait for a block to be released once the pool is exhausted,
+         * which bounds the host-visible memory used by in-flight decodes.
+         * @param staging_memory_mask is the host-visible and host-coherent
+         * memory mask for the staging blocks
+         * @param texture are the parameters of the uploaded textures. Mips are
+         * generated on the GPU when texture.linear_blit is set, otherwise a
+         * single level is uploaded.
+         */
+        struct decoder_params {
+            uint32_t worker_count = 0;
+            uint64_t staging_block_size = 16ull * 1024 * 1024;
+            uint32_t max_staging_blocks = 16;
+            uint32_t staging_memory_mask = 0;
+            texture_params texture{};
+        };
+
+        //! @brief Creates the vk::image implementation used to decode a file
+        using image_loader_factory = std::function<std::unique_ptr<image>()>;
+
+        /**
+         * @brief Shared state between the caller, the decode workers and the
+         * upload submission of a single texture
+         */
+        struct decode_request {
+            std::filesystem::path path;
+            std::atomic<decode_status> status = decode_status::queued;
+            image_extent extent{};
+            uint64_t size_bytes = 0;
+            buffer* staging = nullptr;
+            std::unique_ptr<buffer> dedicated_staging;
+            texture result{};
+        };
+
+        /**
+         * @brief Future-like handle to a texture that is decoded and uploaded
+         * asynchronously
+         *
+         * The texture is available once ready() returns true, which happens
+         * during image_decoder::poll() after its upload has finished on the
+         * GPU.
+         */
+        class decode_handle {
+        public:
+            decode_handle() = default;
+            decode_handle(std::shared_ptr<decode_request> p_request)
+              : m_request(std::move(p_request)) {}
+
+            [[nodiscard]] decode_status status() const {
+                return m_request->status.load(std::memory_order_acquire);
+            }
+
+            [[nodiscard]] bool ready() const {
+                return status() == decode_status::ready;
+            }
+
+            [[nodiscard]] bool failed() const {
+                return status() == decode_status::failed;
+            }
+
+            //! @return the uploaded texture, only valid once ready()
+            [[nodiscard]] texture get() const { return m_request->result; }
+
+            [[nodiscard]] bool alive() const { return m_request != nullptr; }
+
+        private:
+            std::shared_ptr<decode_request> m_request;
+        };
+
+        /**
+         * @brief Decodes images on a pool of worker threads into pooled
+         * staging memory and batches their uploads
+         *
+         * Each worker creates a vk::image through the loader factory (e.g. an
+         * stb_image implementation) and decodes the file through
+         * image::load_into() into a persistently mapped staging block.
+         * Loaders that cannot decode into caller memory fall back to a copy
+         * out of their own buffer, which still stays on the worker. poll()
+         * is called on the thread that owns the graphics queue. It records
+         * the uploads of every finished decode into one command buffer and
+         * completes the handles once the GPU signals the upload fence.
+         *
+         * ```
+         *
+         *  load() --> [ queue ] --> worker 0..N: decode -> staging
+         *                                                        |
+         *  poll() <-- handle ready <-- fence <-- upload batch <--+
+         *
+         * ```
+         *
+         * Example Usage:
+         * ```C++
+         *
+         * vk::image_decoder decoder(logical_device, decoder_params, []() {
+         *     return std::make_unique<stb_image>();
+         * });
+         *
+         * std::vector<vk::decode_handle> handles;
+         * for (const auto& path : texture_paths) {
+         *     handles.push_back(decoder.load(path));
+         * }
+         *
+         * // Every frame
+         * decoder.poll();
+         * if (handles[0].ready()) { use(handles[0].get()); }
+         *
+         * ```
+         */
+        class image_decoder {
+            struct upload_batch {
+                VkFence fence = nullptr;
+                command_buffer command{};
+                std::vector<std::shared_ptr<decode_request>> requests;
+            };
+
+        public:
+            image_decoder() = default;
+            image_decoder(const VkDevice& p_device,
+                          const decoder_params& p_params,
+                          image_loader_factory p_factory)
+              : m_device(p_device)
+              , m_params(p_params)
+              , m_factory(std::move(p_factory)) {
+                vkGetDeviceQueue(m_device, 0, 0, &m_queue);
+
+                uint32_t workers = m_params.worker_count;
+                if (workers == 0) {
+                    workers = std::max(std::thread::hardware_concurrency(), 1u);
+                }
+
+                m_workers.reserve(workers);
+                for (uint32_t i = 0; i < workers; i++) {
+                    m_workers.emplace_back(
+                      [this](std::stop_token p_stop) { worker(p_stop); });
+                }
+            }
+
+            image_decoder(const image_decoder&) = delete;
+            image_decoder& operator=(const image_decoder&) = delete;
+
+            /**
+             * @brief Only joins the workers, which reference this decoder. The
+             * staging memory and pending uploads are released by destruct(),
+             * before the device is destroyed.
+             */
+            ~image_decoder() { stop_workers(); }
+
+            /**
+             * @brief Queues p_path to be decoded and uploaded
+             *
+             * Thread-safe.
+             */
+            decode_handle load(const std::filesystem::path& p_path) {
+                auto request = std::make_shared<decode_request>();
+                request->path = p_path;
+                {
+                    std::scoped_lock lock(m_queue_mutex);
+                    m_pending.push_back(request);
+                }
+                m_queue_signal.notify_one();
+                return decode_handle(request);
+            }
+
+            /**
+             * @brief Records uploads for finished decodes and completes
+             * handles whose uploads finished on the GPU
+             *
+             * Must be called from the thread that submits to the graphics
+             * queue.
+             *
+             * @return amount of textures that became ready
+             */
+            uint32_t poll() {
+                uint32_t completed = 0;
+
+                std::erase_if(m_batches, [&](upload_batch& p_batch) {
+                    if (vkGetFenceStatus(m_device, p_batch.fence) !=
+                        VK_SUCCESS) {
+                        return false;
+                    }
+
+                    for (auto& request : p_batch.requests) {
+                        release_staging(*request);
+                        request->status.store(decode_status::ready,
+                                              std::memory_order_release);
+                        completed++;
+                    }
+                    p_batch.command.destruct();
+                    vkDestroyFence(m_device, p_batch.fence, nullptr);
+                    return true;
+                });
+
+                std::vector<std::shared_ptr<decode_request>> decoded;
+                {
+                    std::scoped_lock lock(m_queue_mutex);
+                    m_uploading -= completed;
+                    decoded.swap(m_decoded);
+                    m_uploading += static_cast<uint32_t>(decoded.size());
+                }
+
+                if (decoded.empty()) {
+                    return completed;
+                }
+
+                upload_batch batch{
+                    .command = command_buffer(
+                      m_device,
+                      command_params{
+                        .levels = command_levels::primary,
+                        .queue_index = 0,
+                        .flags = command_pool_flags::reset,
+                      }),
+                };
+                VkFenceCreateInfo fence_ci = {
+                    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                };
+                vk_check(
+                  vkCreateFence(m_device, &fence_ci, nullptr, &batch.fence),
+                  "vkCreateFence");
+
+                batch.command.begin(command_usage::one_time_submit);
+                for (auto& request : decoded) {
+                    record(batch.command, *request);
+                    request->status.store(decode_status::uploading,
+                                          std::memory_order_release);
+                }
+                batch.command.end();
+
+                const VkCommandBuffer handle = batch.command;
+                VkSubmitInfo submit_info = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers = &handle,
+                };
+                vk_check(vkQueueSubmit(m_queue, 1, &submit_info, batch.fence),
+                         "vkQueueSubmit");
+
+                batch.requests = std::move(decoded);
+                m_batches.push_back(std::move(batch));
+                return completed;
+            }
+
+            /**
+             * @return amount of requests not yet ready or failed
+             *
+             * Thread-safe.
+             */
+            [[nodiscard]] uint32_t in_flight() const {
+                std::scoped_lock lock(m_queue_mutex);
+                return static_cast<uint32_t>(m_pending.size() +
+                                             m_decoded.size()) +
+                       m_decoding + m_uploading;
+            }
+
+            /**
+             * @brief Stops the workers and releases the staging memory
+             *
+             * Textures of completed handles are owned by the caller and are
+             * not destroyed.
+             */
+            void destruct() {
+                if (m_device == nullptr) {
+                    return;
+                }
+
+                stop_workers();
+
+                // First poll submits decodes that were never uploaded, the
+                // second one releases them
+                vkQueueWaitIdle(m_queue);
+                poll();
+                vkQueueWaitIdle(m_queue);
+                poll();
+
+                for (buffer& block : m_blocks) {
+                    block.destruct();
+                }
+                m_blocks.clear();
+                m_free_blocks.clear();
+                m_device = nullptr;
+            }
+
+        private:
+            void stop_workers() {
+                for (std::jthread& worker : m_workers) {
+                    worker.request_stop();
+                }
+                m_queue_signal.notify_all();
+                m_block_signal.notify_all();
+                m_workers.clear();
+            }
+
+            void worker(std::stop_token p_stop) {
+                while (!p_stop.stop_requested()) {
+                    std::shared_ptr<decode_request> request;
+                    {
+                        std::unique_lock lock(m_queue_mutex);
+                        m_queue_signal.wait(lock, p_stop, [this]() {
+                            return !m_pending.empty();
+                        });
+                        if (m_pending.empty()) {
+                            return;
+                        }
+                        request = m_pending.front();
+                        m_pending.pop_front();
+                        m_decoding++;
+                    }
+
+                    request->status.store(decode_status::decoding,
+                                          std::memory_order_release);
+                    const bool decoded = decode(*request, p_stop);
+
+                    std::scoped_lock lock(m_queue_mutex);
+                    m_decoding--;
+                    if (decoded) {
+                        request->status.store(decode_status::decoded,
+                                              std::memory_order_release);
+                        m_decoded.push_back(request);
+                    }
+                    else {
+                        request->status.store(decode_status::failed,
+                                              std::memory_order_release);
+                    }
+                }
+            }
+
+            bool decode(decode_request& p_request, std::stop_token p_stop) {
+                std::unique_ptr<image> loader = m_factory();
+                if (loader == nullptr) {
+                    return false;
+                }
+
+                // The staging block is handed out once the loader knows the
+                // size, so loaders that decode into caller memory write
+                // straight into the mapped staging memory
+                const bool decoded = loader->load_into(
+                  p_request.path.string(),
+                  m_params.texture,
+                  [&](const image_extent& p_extent,
+                      uint64_t p_size_bytes) -> std::span<uint8_t> {
+                      if (p_size_bytes == 0) {
+                          return {};
+                      }
+
+                      p_request.extent = p_extent;
+                      p_request.size_bytes = p_size_bytes;
+                      if (!acquire_staging(p_request, p_stop)) {
+                          return {};
+                      }
+                      return p_request.staging->map().first(p_size_bytes);
+                  });
+
+                if (!decoded) {
+                    release_staging(p_request);
+                }
+                return decoded;
+            }
+
+            /**
+             * @brief Assigns a staging block to p_request, waiting for one to
+             * be released when the pool is exhausted
+             */
+            bool acquire_staging(decode_request& p_request,
+                                 std::stop_token p_stop) {
+                const buffer_parameters staging_options = {
+                    .memory_mask = m_params.staging_memory_mask,
+                    .usage = buffer_usage::transfer_src_bit,
+                };
+
+                if (p_request.size_bytes > m_params.staging_block_size) {
+                    p_request.dedicated_staging = std::make_unique<buffer>(
+                      m_device, p_request.size_bytes, staging_options);
+                    p_request.staging = p_request.dedicated_staging.get();
+                    return true;
+                }
+
+                std::unique_lock lock(m_block_mutex);
+                if (m_free_blocks.empty() and
+                    m_blocks.size() < m_params.max_staging_blocks) {
+                    m_blocks.emplace_back(
+                      m_device, m_params.staging_block_size, staging_options);
+                    m_free_blocks.push_back(&m_blocks.back());
+                }
+
+                m_block_signal.wait(
+                  lock, p_stop, [this]() { return !m_free_blocks.empty(); });
+                if (m_free_blocks.empty()) {
+                    return false;
+                }
+
+                p_request.staging = m_free_blocks.back();
+                m_free_blocks.pop_back();
+                return true;
+            }
+
+            void release_staging(decode_request& p_request) {
+                if (p_request.staging == nullptr) {
+                    return;
+                }
+
+                if (p_request.dedicated_staging != nullptr) {
+                    p_request.dedicated_staging->destruct();
+                    p_request.dedicated_staging.reset();
+                }
+                else {
+                    std::scoped_lock lock(m_block_mutex);
+                    m_free_blocks.push_back(p_request.staging);
+                    m_block_signal.notify_one();
+                }
+                p_request.staging = nullptr;
+            }
+
+            void record(const VkCommandBuffer& p_command,
+                        decode_request& p_request) {
+                const bool generate_mips = m_params.texture.mip_levels > 1 and
+                                           m_params.texture.linear_blit;
+
+                image_usage usage =
+                  image_usage::transfer_dst_bit | image_usage::sampled_bit;
+                if (generate_mips) {
+                    usage = usage | image_usage::transfer_src_bit;
+                }
+
+                const image_params img_options = {
+                    .extent = p_request.extent,
+                    .format = m_params.texture.format,
+                    .memory_mask = m_params.texture.memory_mask,
+                    .usage = usage,
+                    .mip_levels =
+                      generate_mips ? std::min(m_params.texture.mip_levels,
+                                               max_mip_levels(p_request.extent))
+                                    : 1u,
+                    .layer_count = 1,
+                    .array_layers = 1,
+                    .sampler = m_params.texture.sampler,
+                };
+
+                const std::array<buffer_image_copy, 1> regions = {
+                    copy_region(p_request.extent, 0, 0),
+                };
+
+                p_request.result = texture(m_device);
+                p_request.result.record_upload(p_command,
+                                               *p_request.staging,
+                                               regions,
+                                               img_options,
+                                               generate_mips);
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            VkQueue m_queue = nullptr;
+            decoder_params m_params{};
+            image_loader_factory m_factory;
+
+            mutable std::mutex m_queue_mutex;
+            std::condition_variable_any m_queue_signal;
+            std::deque<std::shared_ptr<decode_request>> m_pending;
+            std::vector<std::shared_ptr<decode_request>> m_decoded;
+            uint32_t m_decoding = 0;
+            // Requests recorded into m_batches, counted here so in_flight()
+            // does not read the batches poll() modifies
+            uint32_t m_uploading = 0;
+
+            std::mutex m_block_mutex;
+            std::condition_variable_any m_block_signal;
+            // Deque keeps block addresses stable as the pool grows
+            std::deque<buffer> m_blocks;
+            std::vector<buffer*> m_free_blocks;
+
+            std::vector<upload_batch> m_batches;
+            std::vector<std::jthread> m_workers;
+        };
+    };
+};
@@ -0,0 +1,402 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <filesystem>
+#include <expected>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <numeric>
+
+export module vk:ktx2;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        enum class ktx2_error : uint8_t {
+            file_not_found,
+            invalid_identifier,
+            truncated,
+            unsupported_supercompression,
+            unsupported_format,
+            unsupported_dimension,
+            unaligned_level,
+            write_failed,
+        };
+
+        /**
+         * @brief Contents of a KTX2 container ready to be uploaded with
+         * vk::texture
+         *
+         * @param format is the Vulkan format stored in the container
+         * @param extent is the extent of level 0
+         * @param mip_levels is the amount of levels stored in the file
+         * @param array_layers is the amount of array elements (1 if the
+         * texture is not an array)
+         * @param face_count is 6 for cubemaps and 1 otherwise
+         * @param generate_mips is true when the file requests mips to be
+         * generated at load time (KTX2 levelCount of 0)
+         * @param bytes is the entire file. Regions index directly into it so
+         * the file can be uploaded through a staging buffer without repacking.
+         * @param regions is one copy region per mip level, covering every
+         * array layer and face
+         */
+        struct ktx2_texture {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            image_extent extent{};
+            uint32_t mip_levels = 1;
+            uint32_t array_layers = 1;
+            uint32_t face_count = 1;
+            bool generate_mips = false;
+            std::vector<uint8_t> bytes;
+            std::vector<buffer_image_copy> regions;
+
+            //! @return the amount of image layers, where each cube face is its
+            //! own layer
+            [[nodiscard]] uint32_t layer_count() const {
+                return array_layers * face_count;
+            }
+
+            [[nodiscard]] bool is_cubemap() const { return face_count == 6; }
+
+            /**
+             * @brief Image parameters for the levels [p_base_level, mip_levels)
+             *
+             * @param p_memory_mask is the device-local memory mask to allocate
+             * the image with
+             * @param p_base_level is the most detailed level to include. The
+             * image extent is the extent of that level.
+             */
+            [[nodiscard]] image_params params(uint32_t p_memory_mask,
+                                              uint32_t p_base_level = 0) const {
+                VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
+                if (is_cubemap()) {
+                    view_type = (array_layers > 1)
+                                  ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY
+                                  : VK_IMAGE_VIEW_TYPE_CUBE;
+                }
+                else if (array_layers > 1) {
+                    view_type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                }
+
+                return image_params{
+                    .extent = {
+                        .width = std::max(extent.width >> p_base_level, 1u),
+                        .height = std::max(extent.height >> p_base_level, 1u),
+                        .depth = 1,
+                    },
+                    .format = format,
+                    .memory_mask = p_memory_mask,
+                    .usage =
+                      image_usage::transfer_dst_bit | image_usage::sampled_bit,
+                    .image_flags =
+                      is_cubemap() ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u,
+                    .view_type = view_type,
+                    .mip_levels = mip_levels - p_base_level,
+                    .layer_count = layer_count(),
+                    .array_layers = layer_count(),
+                };
+            }
+        };
+
+        /**
+         * @brief Parses a KTX2 container from memory
+         *
+         * Supports containers without supercompression that store a Vulkan
+         * format directly, including block-compressed formats (BCn,
+         * ETC2/EAC), mip chains, array layers and cube faces. Basis Universal
+         * and Zstandard supercompressed files are rejected.
+         *
+         * ```
+         *
+         *  | identifier | header | index | level index | DFD | KVD | levels |
+         *
+         * ```
+         *
+         * Example Usage:
+         * ```C++
+         *
+         * std::expected<vk::ktx2_texture, vk::ktx2_error> ktx =
+         *   vk::load_ktx2("assets/albedo_bc7.ktx2");
+         *
+         * vk::texture albedo(logical_device, ktx.value(), texture_params);
+         *
+         * ```
+         */
+        std::expected<ktx2_texture, ktx2_error> parse_ktx2(
+          std::vector<uint8_t> p_bytes) {
+            static constexpr std::array<uint8_t, 12> identifier = {
+                0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+            };
+
+            // identifier + header (9 x uint32) + index (4 x uint32, 2 x
+            // uint64)
+            static constexpr size_t level_index_offset = 12 + (9 * 4) + 32;
+            static constexpr size_t level_entry_size = 3 * sizeof(uint64_t);
+
+            if (p_bytes.size() < level_index_offset) {
+                return std::unexpected(ktx2_error::truncated);
+            }
+
+            if (!std::equal(
+                  identifier.begin(), identifier.end(), p_bytes.begin())) {
+                return std::unexpected(ktx2_error::invalid_identifier);
+            }
+
+            auto read_u32 = [&p_bytes](size_t p_offset) {
+                uint32_t value = 0;
+                std::memcpy(&value, p_bytes.data() + p_offset, sizeof(value));
+                return value;
+            };
+            auto read_u64 = [&p_bytes](size_t p_offset) {
+                uint64_t value = 0;
+                std::memcpy(&value, p_bytes.data() + p_offset, sizeof(value));
+                return value;
+            };
+
+            const uint32_t vk_format = read_u32(12);
+            const uint32_t pixel_width = read_u32(20);
+            const uint32_t pixel_height = read_u32(24);
+            const uint32_t pixel_depth = read_u32(28);
+            const uint32_t layer_count = read_u32(32);
+            const uint32_t face_count = read_u32(36);
+            const uint32_t level_count = read_u32(40);
+            const uint32_t supercompression = read_u32(44);
+
+            if (supercompression != 0) {
+                return std::unexpected(
+                  ktx2_error::unsupported_supercompression);
+            }
+
+            // VK_FORMAT_UNDEFINED is used by Basis Universal payloads
+            if (vk_format == VK_FORMAT_UNDEFINED or
+                texel_block(static_cast<VkFormat>(vk_format)).bytes == 0) {
+                return std::unexpected(ktx2_error::unsupported_format);
+            }
+
+            // vk::sample_image only creates 2D images
+            if (pixel_depth > 1 or pixel_width == 0 or
+                (face_count != 1 and face_count != 6)) {
+                return std::unexpected(ktx2_error::unsupported_dimension);
+            }
+
+            ktx2_texture texture{
+                .format = static_cast<VkFormat>(vk_format),
+                .extent = { .width = pixel_width,
+                            .height = std::max(pixel_height, 1u),
+                            .depth = 1 },
+                .mip_levels = std::max(level_count, 1u),
+                .array_layers = std::max(layer_count, 1u),
+                .face_count = face_count,
+                .generate_mips = (level_count == 0),
+            };
+
+            if (p_bytes.size() <
+                level_index_offset + (texture.mip_levels * level_entry_size)) {
+                return std::unexpected(ktx2_error::truncated);
+            }
+
+            texture.regions.resize(texture.mip_levels);
+            for (uint32_t level = 0; level < texture.mip_levels; level++) {
+                const size_t entry =
+                  level_index_offset + (level * level_entry_size);
+                const uint64_t byte_offset = read_u64(entry);
+                const uint64_t byte_length = read_u64(entry + 8);
+
+                const uint64_t expected_length =
+                  image_level_size(texture.format, texture.extent, level) *
+                  texture.layer_count();
+
+                // Compared without adding, so a huge offset cannot wrap
+                // around and pass
+                if (byte_length < expected_length or
+                    byte_offset > p_bytes.size() or
+                    byte_length > p_bytes.size() - byte_offset) {
+                    return std::unexpected(ktx2_error::truncated);
+                }
+
+                // KTX2 aligns every level to lcm(block size, 4) from the start
+                // of the file, which vkCmdCopyBufferToImage requires
+                if (byte_offset % copy_alignment(texture.format) != 0) {
+                    return std::unexpected(ktx2_error::unaligned_level);
+                }
+                texture.regions[level] = copy_region(
+                  texture.extent, level, byte_offset, texture.layer_count());
+            }
+
+            texture.bytes = std::move(p_bytes);
+            return texture;
+        }
+
+        //! @brief Loads and parses a KTX2 file from disk
+        std::expected<ktx2_texture, ktx2_error> load_ktx2(
+          const std::filesystem::path& p_filename) {
+            std::ifstream ins(p_filename, std::ios::ate | std::ios::binary);
+
+            if (!ins.is_open()) {
+                return std::unexpected(ktx2_error::file_not_found);
+            }
+
+            const std::streamsize file_size = ins.tellg();
+            std::vector<uint8_t> bytes(static_cast<size_t>(file_size));
+            ins.seekg(0);
+            ins.read(reinterpret_cast<char*>(bytes.data()), file_size);
+
+            return parse_ktx2(std::move(bytes));
+        }
+
+        /**
+         * @brief Writes p_texture to disk as a KTX2 container that load_ktx2
+         * can read back
+         *
+         * Only uncompressed signed float formats (16 and 32-bit, 1 to 4
+         * channels) are supported, which covers the HDR results produced on
+         * the GPU such as environment maps. Levels are read from
+         * p_texture.bytes at the offsets of p_texture.regions and stored from
+         * the smallest to the largest level as KTX2 recommends.
+         */
+        std::expected<void, ktx2_error> save_ktx2(
+          const std::filesystem::path& p_filename,
+          const ktx2_texture& p_texture) {
+            uint32_t channels = 0;
+            uint32_t channel_bits = 0;
+            switch (p_texture.format) {
+                case VK_FORMAT_R16_SFLOAT:
+                    channels = 1;
+                    channel_bits = 16;
+                    break;
+                case VK_FORMAT_R16G16_SFLOAT:
+                    channels = 2;
+                    channel_bits = 16;
+                    break;
+                case VK_FORMAT_R16G16B16A16_SFLOAT:
+                    channels = 4;
+                    channel_bits = 16;
+                    break;
+                case VK_FORMAT_R32_SFLOAT:
+                    channels = 1;
+                    channel_bits = 32;
+                    break;
+                case VK_FORMAT_R32G32_SFLOAT:
+                    channels = 2;
+                    channel_bits = 32;
+                    break;
+                case VK_FORMAT_R32G32B32A32_SFLOAT:
+                    channels = 4;
+                    channel_bits = 32;
+                    break;
+                default:
+                    return std::unexpected(ktx2_error::unsupported_format);
+            }
+
+            if (p_texture.regions.size() != p_texture.mip_levels) {
+                return std::unexpected(ktx2_error::truncated);
+            }
+
+            const uint32_t texel_bytes = (channels * channel_bits) / 8;
+            static constexpr size_t header_size = 12 + (9 * 4) + 32;
+            static constexpr size_t level_entry_size = 3 * sizeof(uint64_t);
+
+            // Data format descriptor: total size, basic block header and one
+            // sample per channel (RGBSDA color model, linear BT.709)
+            const uint32_t basic_block_size = 24 + (16 * channels);
+            const uint32_t dfd_size = 4 + basic_block_size;
+            const size_t dfd_offset =
+              header_size + (p_texture.mip_levels * level_entry_size);
+
+            std::vector<uint8_t> bytes(dfd_offset + dfd_size);
+            auto write_u32 = [&bytes](size_t p_offset, uint32_t p_value) {
+                std::memcpy(bytes.data() + p_offset, &p_value, sizeof(p_value));
+            };
+            auto write_u64 = [&bytes](size_t p_offset, uint64_t p_value) {
+                std::memcpy(bytes.data() + p_offset, &p_value, sizeof(p_value));
+            };
+
+            static constexpr std::array<uint8_t, 12> identifier = {
+                0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+            };
+            std::ranges::copy(identifier, bytes.begin());
+
+            write_u32(12, p_texture.format);
+            write_u32(16, channel_bits / 8);
+            write_u32(20, p_texture.extent.width);
+            write_u32(24, p_texture.extent.height);
+            write_u32(28, 0);
+            write_u32(32, (p_texture.array_layers > 1) ? p_texture.array_layers
+                                                       : 0);
+            write_u32(36, p_texture.face_count);
+            write_u32(40, p_texture.mip_levels);
+            write_u32(44, 0);
+            write_u32(48, static_cast<uint32_t>(dfd_offset));
+            write_u32(52, dfd_size);
+
+            static constexpr std::array<uint8_t, 4> channel_ids = { 0, 1, 2, 15 };
+            const size_t block = dfd_offset + 4;
+            write_u32(dfd_offset, dfd_size);
+            write_u32(block, 0);
+            write_u32(block + 4, 2 | (basic_block_size << 16));
+            write_u32(block + 8, 1 | (1 << 8) | (1 << 16));
+            write_u32(block + 12, 0);
+            write_u32(block + 16, texel_bytes);
+            write_u32(block + 20, 0);
+            for (uint32_t i = 0; i < channels; i++) {
+                const size_t sample = block + 24 + (16 * i);
+                // float and signed qualifiers are the top bits of channelType
+                const uint32_t channel_type = channel_ids[i] | 0xC0;
+                write_u32(sample,
+                          (i * channel_bits) | ((channel_bits - 1) << 16) |
+                            (channel_type << 24));
+                write_u32(sample + 4, 0);
+                write_u32(sample + 8, 0xBF800000);
+                write_u32(sample + 12, 0x3F800000);
+            }
+
+            // Level data goes after the descriptor, each level aligned to
+            // lcm(texel size, 4)
+            const uint64_t alignment = std::lcm(uint64_t{ texel_bytes }, 4ull);
+            for (uint32_t level = p_texture.mip_levels; level-- > 0;) {
+                const uint64_t level_size =
+                  image_level_size(
+                    p_texture.format, p_texture.extent, level) *
+                  p_texture.layer_count();
+                const uint64_t source = p_texture.regions[level].offset;
+                if (source + level_size > p_texture.bytes.size()) {
+                    return std::unexpected(ktx2_error::truncated);
+                }
+
+                const uint64_t offset =
+                  ((bytes.size() + alignment - 1) / alignment) * alignment;
+                bytes.resize(offset);
+                bytes.insert(bytes.end(),
+                             p_texture.bytes.begin() + source,
+                             p_texture.bytes.begin() + source + level_size);
+
+                const size_t entry = header_size + (level * level_entry_size);
+                write_u64(entry, offset);
+                write_u64(entry + 8, level_size);
+                write_u64(entry + 16, level_size);
+            }
+
+            std::ofstream outs(p_filename, std::ios::binary | std::ios::trunc);
+            if (!outs.is_open()) {
+                return std::unexpected(ktx2_error::write_failed);
+            }
+
+            outs.write(reinterpret_cast<const char*>(bytes.data()),
+                       static_cast<std::streamsize>(bytes.size()));
+            if (!outs) {
+                return std::unexpected(ktx2_error::write_failed);
+            }
+            return {};
+        }
+    };
+};
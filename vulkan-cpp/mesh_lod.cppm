@@ -0,0 +1,569 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <glm/glm.hpp>
+
+export module vk:mesh_lod;
+
+export import :types;
+export import :utilities;
+export import :vertex_buffer;
+export import :index_buffer;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Specifies a range of indices within a shared index buffer
+         * that represents a single level-of-detail for a mesh
+         *
+         * @param first_index is the starting index into the index buffer
+         * @param index_count is the amount of indices this LOD draws
+         * @param error is an upper bound of the world-space geometric error
+         * of this LOD relative to the original mesh (0 for LOD 0)
+         */
+        struct lod_range {
+            uint32_t first_index = 0;
+            uint32_t index_count = 0;
+            float error = 0.f;
+        };
+
+        /**
+         * @param max_lods is the maximum amount of LOD's (including LOD 0) to
+         * generate
+         * @param reduction is the ratio of triangles to keep for each next
+         * level (0.5 halves the triangle count per level)
+         * @param max_error is the maximum world-space error a collapse is
+         * allowed to introduce. Generation stops early when no collapse stays
+         * under this threshold.
+         */
+        struct lod_params {
+            uint32_t max_lods = 4;
+            float reduction = 0.5f;
+            float max_error = std::numeric_limits<float>::max();
+        };
+
+        /**
+         * @brief Symmetric 4x4 quadric matrix for computing the squared
+         * distance of a point to a set of weighted planes.
+         *
+         * Only the upper triangle is stored since the matrix is symmetric.
+         * weight is the sum of the plane weights, dividing by it turns the
+         * weighted sum back into a world-space squared distance.
+         */
+        struct quadric {
+            double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+            double a11 = 0, a12 = 0, a13 = 0;
+            double a22 = 0, a23 = 0;
+            double a33 = 0;
+            double weight = 0;
+
+            //! @brief Constructs the quadric for plane ax + by + cz + d = 0
+            //! weighted by p_weight
+            static quadric from_plane(double p_a,
+                                      double p_b,
+                                      double p_c,
+                                      double p_d,
+                                      double p_weight) {
+                return quadric{
+                    .a00 = p_a * p_a * p_weight,
+                    .a01 = p_a * p_b * p_weight,
+                    .a02 = p_a * p_c * p_weight,
+                    .a03 = p_a * p_d * p_weight,
+                    .a11 = p_b * p_b * p_weight,
+                    .a12 = p_b * p_c * p_weight,
+                    .a13 = p_b * p_d * p_weight,
+                    .a22 = p_c * p_c * p_weight,
+                    .a23 = p_c * p_d * p_weight,
+                    .a33 = p_d * p_d * p_weight,
+                    .weight = p_weight,
+                };
+            }
+
+            quadric& operator+=(const quadric& p_other) {
+                a00 += p_other.a00;
+                a01 += p_other.a01;
+                a02 += p_other.a02;
+                a03 += p_other.a03;
+                a11 += p_other.a11;
+                a12 += p_other.a12;
+                a13 += p_other.a13;
+                a22 += p_other.a22;
+                a23 += p_other.a23;
+                a33 += p_other.a33;
+                weight += p_other.weight;
+                return *this;
+            }
+
+            //! @return the weighted sum of squared distances of p_position to
+            //! the planes
+            [[nodiscard]] double evaluate(const glm::vec3& p_position) const {
+                const double x = p_position.x;
+                const double y = p_position.y;
+                const double z = p_position.z;
+
+                double error = (a00 * x * x) + (2 * a01 * x * y) +
+                               (2 * a02 * x * z) + (2 * a03 * x) +
+                               (a11 * y * y) + (2 * a12 * y * z) +
+                               (2 * a13 * y) + (a22 * z * z) + (2 * a23 * z) +
+                               a33;
+
+                // Floating point cancellation can produce tiny negatives
+                return std::max(error, 0.0);
+            }
+
+            //! @return the weighted mean of the squared distances of
+            //! p_position to the planes, in world units squared
+            [[nodiscard]] double distance_squared(
+              const glm::vec3& p_position) const {
+                if (weight <= 0.0) {
+                    return 0.0;
+                }
+                return evaluate(p_position) / weight;
+            }
+        };
+
+        /**
+         * @brief Simplifies a triangle list using quadric error metrics.
+         *
+         * Edges are collapsed onto one of their existing endpoints, so the
+         * returned indices always reference the original vertices. Which lets
+         * every LOD share a single vertex buffer.
+         *
+         * @param p_vertices are the vertices of the mesh
+         * @param p_indices is the triangle list to simplify
+         * @param p_target_index_count is the amount of indices to reduce to
+         * @param p_max_error is the maximum world-space error allowed
+         * @param p_out_error is set to the world-space error of the result
+         *
+         * @return the simplified triangle list
+         */
+        std::vector<uint32_t> simplify(std::span<const vertex_input> p_vertices,
+                                       std::span<const uint32_t> p_indices,
+                                       uint32_t p_target_index_count,
+                                       float p_max_error,
+                                       float* p_out_error = nullptr) {
+            std::vector<uint32_t> indices(p_indices.begin(), p_indices.end());
+            const size_t vertex_count = p_vertices.size();
+
+            // 1. Accumulate the area-weighted plane quadrics per vertex
+            std::vector<quadric> quadrics(vertex_count);
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const glm::vec3 p0 = p_vertices[indices[i + 0]].position;
+                const glm::vec3 p1 = p_vertices[indices[i + 1]].position;
+                const glm::vec3 p2 = p_vertices[indices[i + 2]].position;
+
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                const float area = glm::length(normal);
+                if (area == 0.f) {
+                    continue;
+                }
+                normal /= area;
+
+                const quadric plane =
+                  quadric::from_plane(normal.x,
+                                      normal.y,
+                                      normal.z,
+                                      -glm::dot(normal, p0),
+                                      area * 0.5);
+                quadrics[indices[i + 0]] += plane;
+                quadrics[indices[i + 1]] += plane;
+                quadrics[indices[i + 2]] += plane;
+            }
+
+            // cost is area-weighted so collapses on large faces are ordered
+            // after small ones, error is the world-space squared distance
+            // compared against p_max_error
+            struct collapse {
+                uint32_t from;
+                uint32_t to;
+                double cost;
+                double error;
+            };
+
+            std::vector<uint32_t> remap(vertex_count);
+            std::iota(remap.begin(), remap.end(), 0u);
+
+            const double max_error_squared =
+              static_cast<double>(p_max_error) * p_max_error;
+            double result_error = 0.0;
+
+            // Each pass collapses an independent set of edges, then rebuilds
+            // the triangle list
+            while (indices.size() > p_target_index_count) {
+                // 2. Vertex -> triangle adjacency (CSR layout)
+                std::vector<uint32_t> offsets(vertex_count + 1, 0);
+                for (uint32_t index : indices) {
+                    offsets[index + 1]++;
+                }
+                std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+                std::vector<uint32_t> adjacency(indices.size());
+                std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+                for (uint32_t i = 0; i < indices.size(); i++) {
+                    adjacency[cursor[indices[i]]++] = i / 3;
+                }
+
+                // 3. Gather edge candidates with their cheapest direction
+                std::vector<collapse> candidates;
+                candidates.reserve(indices.size());
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    for (uint32_t e = 0; e < 3; e++) {
+                        // Duplicated edges from neighboring triangles are
+                        // harmless, the second one gets rejected by the lock
+                        const uint32_t a =
+                          std::min(indices[i + e], indices[i + ((e + 1) % 3)]);
+                        const uint32_t b =
+                          std::max(indices[i + e], indices[i + ((e + 1) % 3)]);
+
+                        quadric combined = quadrics[a];
+                        combined += quadrics[b];
+
+                        const double cost_ab =
+                          combined.evaluate(p_vertices[b].position);
+                        const double cost_ba =
+                          combined.evaluate(p_vertices[a].position);
+
+                        if (cost_ab <= cost_ba) {
+                            candidates.push_back({
+                              a,
+                              b,
+                              cost_ab,
+                              combined.distance_squared(p_vertices[b].position),
+                            });
+                        }
+                        else {
+                            candidates.push_back({
+                              b,
+                              a,
+                              cost_ba,
+                              combined.distance_squared(p_vertices[a].position),
+                            });
+                        }
+                    }
+                }
+
+                std::ranges::sort(candidates, {}, &collapse::cost);
+
+                // 4. Greedily collapse edges whose endpoints are untouched
+                std::vector<bool> locked(vertex_count, false);
+                const size_t triangles_to_remove =
+                  (indices.size() - p_target_index_count + 2) / 3;
+                size_t triangles_removed = 0;
+                uint32_t collapses = 0;
+
+                for (const collapse& edge : candidates) {
+                    if (triangles_removed >= triangles_to_remove) {
+                        break;
+                    }
+
+                    // Candidates are ordered by cost, not error, so a later
+                    // one can still be under the threshold
+                    if (edge.error > max_error_squared) {
+                        continue;
+                    }
+
+                    if (locked[edge.from] or locked[edge.to]) {
+                        continue;
+                    }
+
+                    // Reject collapses that flip the winding of any triangle
+                    // surrounding the vertex being removed
+                    bool flips = false;
+                    size_t shared = 0;
+                    const glm::vec3 target = p_vertices[edge.to].position;
+                    for (uint32_t t = offsets[edge.from];
+                         t < offsets[edge.from + 1];
+                         t++) {
+                        const uint32_t* tri = &indices[adjacency[t] * 3];
+                        if (tri[0] == edge.to or tri[1] == edge.to or
+                            tri[2] == edge.to) {
+                            shared++;
+                            continue;
+                        }
+
+                        glm::vec3 before[3];
+                        glm::vec3 after[3];
+                        for (uint32_t k = 0; k < 3; k++) {
+                            before[k] = p_vertices[tri[k]].position;
+                            after[k] =
+                              (tri[k] == edge.from) ? target : before[k];
+                        }
+
+                        const glm::vec3 n0 = glm::cross(before[1] - before[0],
+                                                        before[2] - before[0]);
+                        const glm::vec3 n1 = glm::cross(after[1] - after[0],
+                                                        after[2] - after[0]);
+                        if (glm::dot(n0, n1) <= 0.f) {
+                            flips = true;
+                            break;
+                        }
+                    }
+
+                    if (flips) {
+                        continue;
+                    }
+
+                    // Lock the one-ring so collapses within this pass stay
+                    // independent from each other
+                    for (uint32_t t = offsets[edge.from];
+                         t < offsets[edge.from + 1];
+                         t++) {
+                        const uint32_t* tri = &indices[adjacency[t] * 3];
+                        locked[tri[0]] = true;
+                        locked[tri[1]] = true;
+                        locked[tri[2]] = true;
+                    }
+
+                    remap[edge.from] = edge.to;
+                    quadrics[edge.to] += quadrics[edge.from];
+                    result_error = std::max(result_error, edge.error);
+                    triangles_removed += shared;
+                    collapses++;
+                }
+
+                if (collapses == 0) {
+                    break;
+                }
+
+                // 5. Rewrite the triangle list and drop degenerate triangles
+                size_t write = 0;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    uint32_t tri[3];
+                    for (uint32_t k = 0; k < 3; k++) {
+                        uint32_t v = indices[i + k];
+                        while (remap[v] != v) {
+                            v = remap[v];
+                        }
+                        tri[k] = v;
+                    }
+
+                    if (tri[0] == tri[1] or tri[1] == tri[2] or
+                        tri[0] == tri[2]) {
+                        continue;
+                    }
+
+                    indices[write++] = tri[0];
+                    indices[write++] = tri[1];
+                    indices[write++] = tri[2];
+                }
+                indices.resize(write);
+            }
+
+            if (p_out_error != nullptr) {
+                *p_out_error = static_cast<float>(std::sqrt(result_error));
+            }
+
+            return indices;
+        }
+
+        /**
+         * @brief Converts an LOD's world-space error into an error in pixels
+         *
+         * @param p_error is the world-space error of the LOD
+         * @param p_distance is the distance from the camera to the mesh
+         * @param p_fov_y is the vertical field-of-view in radians
+         * @param p_viewport_height is the height of the viewport in pixels
+         */
+        float projected_error(float p_error,
+                              float p_distance,
+                              float p_fov_y,
+                              float p_viewport_height) {
+            const float distance = std::max(p_distance, 1e-4f);
+            const float pixels_per_unit =
+              p_viewport_height / (2.f * std::tan(p_fov_y * 0.5f));
+            return (p_error / distance) * pixels_per_unit;
+        }
+
+        /**
+         * @brief Mesh with a chain of LOD's stored contiguously in one vertex
+         * and one index buffer.
+         *
+         * Every LOD references the same vertices, only the index ranges
+         * differ. Switching LOD's is changing the firstIndex and indexCount
+         * of the draw, which means no extra buffer binds are needed.
+         *
+         * [ Index Buffer ]
+         * +--------------------+------------+--------+----+
+         * | LOD 0              | LOD 1      | LOD 2  | .. |
+         * +--------------------+------------+--------+----+
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::mesh_lod mesh(logical_device, vertices, indices, {}, vbo, ibo);
+         *
+         * uint32_t lod = mesh.select(distance, fov_y, viewport_height, 1.f);
+         * VkDrawIndexedIndirectCommand draw = mesh.draw_command(lod);
+         *
+         * // Either record directly
+         * current.draw_indexed(draw);
+         *
+         * // Or write the draw into an indirect buffer
+         * ```
+         *
+         */
+        class mesh_lod {
+        public:
+            mesh_lod() = default;
+
+            /**
+             * @param p_device is the logical device to create the buffers
+             * with
+             * @param p_vertices are the vertices shared by every LOD
+             * @param p_indices is the full resolution triangle list (LOD 0)
+             * @param p_params configures how the LOD chain is generated
+             * @param p_vertex_params are the buffer parameters for the vertex
+             * buffer
+             * @param p_index_params are the buffer parameters for the index
+             * buffer
+             */
+            mesh_lod(const VkDevice& p_device,
+                     std::span<const vertex_input> p_vertices,
+                     std::span<const uint32_t> p_indices,
+                     const lod_params& p_params,
+                     const buffer_parameters& p_vertex_params,
+                     const buffer_parameters& p_index_params)
+              : m_device(p_device) {
+                construct(p_vertices,
+                          p_indices,
+                          p_params,
+                          p_vertex_params,
+                          p_index_params);
+            }
+
+            void construct(std::span<const vertex_input> p_vertices,
+                           std::span<const uint32_t> p_indices,
+                           const lod_params& p_params,
+                           const buffer_parameters& p_vertex_params,
+                           const buffer_parameters& p_index_params) {
+                std::vector<uint32_t> lod_indices(p_indices.begin(),
+                                                  p_indices.end());
+                m_lods.clear();
+                m_lods.push_back({
+                  .first_index = 0,
+                  .index_count = static_cast<uint32_t>(p_indices.size()),
+                  .error = 0.f,
+                });
+
+                std::vector<uint32_t> current(p_indices.begin(),
+                                              p_indices.end());
+                float accumulated_error = 0.f;
+
+                for (uint32_t lod = 1; lod < p_params.max_lods; lod++) {
+                    const uint32_t target = static_cast<uint32_t>(
+                      (current.size() / 3) * p_params.reduction) * 3;
+
+                    float error = 0.f;
+                    std::vector<uint32_t> next = simplify(
+                      p_vertices, current, target, p_params.max_error, &error);
+
+                    // Stop once simplification can no longer make progress
+                    if (next.empty() or next.size() >= current.size()) {
+                        break;
+                    }
+
+                    // Each LOD is simplified from the previous one, so its
+                    // deviation from LOD 0 is bounded by the sum of the steps
+                    accumulated_error += error;
+                    m_lods.push_back({
+                      .first_index = static_cast<uint32_t>(lod_indices.size()),
+                      .index_count = static_cast<uint32_t>(next.size()),
+                      .error = accumulated_error,
+                    });
+                    lod_indices.insert(
+                      lod_indices.end(), next.begin(), next.end());
+                    current = std::move(next);
+                }
+
+                m_vertex_buffer =
+                  vertex_buffer(m_device, p_vertices, p_vertex_params);
+                m_index_buffer =
+                  index_buffer(m_device, lod_indices, p_index_params);
+            }
+
+            //! @return the index ranges of every LOD, LOD 0 being the
+            //! full resolution mesh
+            [[nodiscard]] std::span<const lod_range> lods() const {
+                return m_lods;
+            }
+
+            /**
+             * @brief Selects the coarsest LOD whose projected screen-space
+             * error stays under p_threshold pixels.
+             *
+             * @param p_distance is the distance from the camera to the mesh
+             * @param p_fov_y is the vertical field-of-view in radians
+             * @param p_viewport_height is the viewport height in pixels
+             * @param p_threshold is the maximum allowed error in pixels
+             * @param p_scale is the world scale applied to the mesh
+             */
+            [[nodiscard]] uint32_t select(float p_distance,
+                                          float p_fov_y,
+                                          float p_viewport_height,
+                                          float p_threshold = 1.f,
+                                          float p_scale = 1.f) const {
+                uint32_t selected = 0;
+                for (uint32_t i = 0; i < m_lods.size(); i++) {
+                    const float error =
+                      projected_error(m_lods[i].error * p_scale,
+                                      p_distance,
+                                      p_fov_y,
+                                      p_viewport_height);
+                    if (error > p_threshold) {
+                        break;
+                    }
+                    selected = i;
+                }
+                return selected;
+            }
+
+            /**
+             * @brief Returns the draw parameters for a specific LOD
+             *
+             * The result can be recorded directly or written into a buffer
+             * used with command_buffer::draw_indexed_indirect.
+             */
+            [[nodiscard]] VkDrawIndexedIndirectCommand draw_command(
+              uint32_t p_lod,
+              uint32_t p_instance_count = 1,
+              uint32_t p_first_instance = 0) const {
+                const lod_range& range =
+                  m_lods[std::min<size_t>(p_lod, m_lods.size() - 1)];
+                return VkDrawIndexedIndirectCommand{
+                    .indexCount = range.index_count,
+                    .instanceCount = p_instance_count,
+                    .firstIndex = range.first_index,
+                    .vertexOffset = 0,
+                    .firstInstance = p_first_instance,
+                };
+            }
+
+            [[nodiscard]] VkBuffer vertex_handle() const {
+                return m_vertex_buffer;
+            }
+
+            [[nodiscard]] VkBuffer index_handle() const {
+                return m_index_buffer;
+            }
+
+            void destruct() {
+                m_vertex_buffer.destruct();
+                m_index_buffer.destruct();
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            std::vector<lod_range> m_lods;
+            vertex_buffer m_vertex_buffer{};
+            index_buffer m_index_buffer{};
+        };
+    };
+};
@@ -0,0 +1,227 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+export module vk:mipmap;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @return the amount of mip levels for a full mip chain of an image
+         * with the specified extent (down to 1x1)
+         */
+        uint32_t max_mip_levels(const image_extent& p_extent) {
+            const uint32_t largest =
+              std::max({ p_extent.width, p_extent.height, 1u });
+            return static_cast<uint32_t>(std::bit_width(largest));
+        }
+
+        //! @return the extent of a specific mip level
+        image_extent mip_extent(const image_extent& p_extent, uint32_t p_level) {
+            return image_extent{
+                .width = std::max(p_extent.width >> p_level, 1u),
+                .height = std::max(p_extent.height >> p_level, 1u),
+                .depth = std::max(p_extent.depth >> p_level, 1u),
+            };
+        }
+
+        /**
+         * @brief CPU-generated mip chain that is ready to be copied into an
+         * image with buffer::copy_to_image
+         *
+         * @param bytes are all mip levels packed one after the other. Each
+         * level contains every array layer.
+         * @param regions are the copy regions for each mip level
+         */
+        struct mip_chain {
+            std::vector<uint8_t> bytes;
+            std::vector<buffer_image_copy> regions;
+        };
+
+        /**
+         * @brief 2x2 box filter that downsamples p_src into p_dst
+         *
+         * Odd dimensions are handled by clamping to the edge texel. Rows are
+         * processed without branching in the inner loop so the compiler can
+         * vectorize across the channels.
+         */
+        template<typename T, typename Accumulate>
+        void downsample_box(const T* p_src,
+                            const image_extent& p_src_extent,
+                            T* p_dst,
+                            const image_extent& p_dst_extent,
+                            uint32_t p_channels) {
+            const uint32_t src_row = p_src_extent.width * p_channels;
+            const uint32_t dst_row = p_dst_extent.width * p_channels;
+
+            for (uint32_t y = 0; y < p_dst_extent.height; y++) {
+                const uint32_t y0 = std::min(y * 2, p_src_extent.height - 1);
+                const uint32_t y1 =
+                  std::min(y * 2 + 1, p_src_extent.height - 1);
+                const T* row0 = p_src + (static_cast<size_t>(y0) * src_row);
+                const T* row1 = p_src + (static_cast<size_t>(y1) * src_row);
+                T* out = p_dst + (static_cast<size_t>(y) * dst_row);
+
+                for (uint32_t x = 0; x < p_dst_extent.width; x++) {
+                    const uint32_t x0 =
+                      std::min(x * 2, p_src_extent.width - 1) * p_channels;
+                    const uint32_t x1 =
+                      std::min(x * 2 + 1, p_src_extent.width - 1) * p_channels;
+
+                    for (uint32_t c = 0; c < p_channels; c++) {
+                        const Accumulate sum =
+                          static_cast<Accumulate>(row0[x0 + c]) +
+                          static_cast<Accumulate>(row0[x1 + c]) +
+                          static_cast<Accumulate>(row1[x0 + c]) +
+                          static_cast<Accumulate>(row1[x1 + c]);
+
+                        if constexpr (std::is_integral_v<T>) {
+                            // Round to nearest
+                            out[(x * p_channels) + c] =
+                              static_cast<T>((sum + 2) >> 2);
+                        }
+                        else {
+                            out[(x * p_channels) + c] =
+                              static_cast<T>(sum * 0.25f);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Generates the mip chain on the CPU
+         *
+         * Used as a fallback for formats that cannot be filtered by
+         * vkCmdBlitImage (missing VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR
+         * in optimal tiling).
+         *
+         * Supports 8-bit unorm formats with 1 to 4 channels and 32-bit float
+         * formats. sRGB data is filtered as-is without linearizing.
+         *
+         * @param p_base is the level 0 data of every array layer, tightly
+         * packed
+         * @param p_extent is the extent of level 0
+         * @param p_format is the texel format of p_base
+         * @param p_mip_levels is the amount of levels to generate (including
+         * level 0)
+         * @param p_layer_count is the amount of array layers inside p_base
+         *
+         * @return empty mip_chain if p_format cannot be filtered on the CPU
+         */
+        mip_chain generate_mip_chain(std::span<const uint8_t> p_base,
+                                     const image_extent& p_extent,
+                                     VkFormat p_format,
+                                     uint32_t p_mip_levels,
+                                     uint32_t p_layer_count = 1) {
+            bool is_float = false;
+            uint32_t channels = 0;
+            switch (p_format) {
+                case VK_FORMAT_R8_UNORM:
+                case VK_FORMAT_R8G8_UNORM:
+                case VK_FORMAT_R8G8B8A8_UNORM:
+                case VK_FORMAT_R8G8B8A8_SRGB:
+                case VK_FORMAT_B8G8R8A8_UNORM:
+                case VK_FORMAT_B8G8R8A8_SRGB:
+                    channels = static_cast<uint32_t>(
+                      bytes_per_texture_format(p_format));
+                    break;
+                case VK_FORMAT_R32_SFLOAT:
+                case VK_FORMAT_R32G32_SFLOAT:
+                case VK_FORMAT_R32G32B32A32_SFLOAT:
+                    is_float = true;
+                    channels = static_cast<uint32_t>(
+                                 bytes_per_texture_format(p_format)) /
+                               sizeof(float);
+                    break;
+                default:
+                    return {};
+            }
+
+            if (channels == 0) {
+                return {};
+            }
+
+            const uint32_t texel_size =
+              is_float ? channels * sizeof(float) : channels;
+
+            // Offsets of each level are aligned to 16 bytes which satisfies
+            // both the texel size and the 4-byte bufferOffset requirement
+            auto level_size = [&](const image_extent& p_level) {
+                return static_cast<uint64_t>(p_level.width) * p_level.height *
+                       texel_size * p_layer_count;
+            };
+            auto align = [](uint64_t p_value) {
+                return (p_value + 15) & ~static_cast<uint64_t>(15);
+            };
+
+            mip_chain chain{};
+            chain.regions.resize(p_mip_levels);
+
+            uint64_t total = 0;
+            for (uint32_t level = 0; level < p_mip_levels; level++) {
+                const image_extent extent = mip_extent(p_extent, level);
+                chain.regions[level] = buffer_image_copy{
+                    .offset = total,
+                    .mip_level = level,
+                    .base_array_layer = 0,
+                    .layer_count = p_layer_count,
+                    .image_offset = { .width = 0, .height = 0, .depth = 0 },
+                    .image_extent = { .width = extent.width,
+                                      .height = extent.height,
+                                      .depth = 1 },
+                };
+                total = align(total + level_size(extent));
+            }
+
+            chain.bytes.resize(total);
+            std::memcpy(chain.bytes.data(),
+                        p_base.data(),
+                        std::min<uint64_t>(p_base.size(), level_size(p_extent)));
+
+            for (uint32_t level = 1; level < p_mip_levels; level++) {
+                const image_extent src_extent = mip_extent(p_extent, level - 1);
+                const image_extent dst_extent = mip_extent(p_extent, level);
+                const uint64_t src_layer_size =
+                  level_size(src_extent) / p_layer_count;
+                const uint64_t dst_layer_size =
+                  level_size(dst_extent) / p_layer_count;
+
+                for (uint32_t layer = 0; layer < p_layer_count; layer++) {
+                    const uint8_t* src = chain.bytes.data() +
+                                         chain.regions[level - 1].offset +
+                                         (layer * src_layer_size);
+                    uint8_t* dst = chain.bytes.data() +
+                                   chain.regions[level].offset +
+                                   (layer * dst_layer_size);
+
+                    if (is_float) {
+                        downsample_box<float, float>(
+                          reinterpret_cast<const float*>(src),
+                          src_extent,
+                          reinterpret_cast<float*>(dst),
+                          dst_extent,
+                          channels);
+                    }
+                    else {
+                        downsample_box<uint8_t, uint32_t>(
+                          src, src_extent, dst, dst_extent, channels);
+                    }
+                }
+            }
+
+            return chain;
+        }
+    };
+};
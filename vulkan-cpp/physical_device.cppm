@@ -143,7 +143,10 @@ export namespace vk {
              *
              * @param p_tiling is selecting arrangements of the data format
              * @param p_feature_flag is the bitmask selection for the image
-             * format
+             * format. Every bit must be supported.
+             *
+             * @return the last format in p_format_supported that is
+             * supported, so later entries take priority
              */
             [[nodiscard]] VkFormat request_formats(
               std::span<const format> p_format_supported,
@@ -163,14 +166,14 @@ export namespace vk {
 
                     switch (tiling) {
                         case VK_IMAGE_TILING_LINEAR:
-                            if (format_properties.linearTilingFeatures &
-                                feature_flag) {
+                            if ((format_properties.linearTilingFeatures &
+                                 feature_flag) == feature_flag) {
                                 format = current;
                             }
                             break;
                         case VK_IMAGE_TILING_OPTIMAL:
-                            if (format_properties.optimalTilingFeatures &
-                                feature_flag) {
+                            if ((format_properties.optimalTilingFeatures &
+                                 feature_flag) == feature_flag) {
                                 format = current;
                             }
                             break;
@@ -182,6 +185,52 @@ export namespace vk {
                 return format;
             }
 
+            /**
+             * @brief Selects a format from p_format_supported that can be
+             * sampled with a linear filter in optimal tiling
+             *
+             * Used to pick between block-compressed formats and their
+             * fallbacks before uploading a vk::texture. Later candidates take
+             * priority.
+             *
+             * ```C++
+             *
+             * std::array<vk::format, 2> candidates = {
+             *     vk::format::r8g8b8a8_unorm, vk::format::bc7_unorm_block
+             * };
+             * VkFormat format = physical_device.request_texture_format(candidates);
+             *
+             * ```
+             *
+             * @return VK_FORMAT_UNDEFINED if none of the formats are supported
+             */
+            [[nodiscard]] VkFormat request_texture_format(
+              std::span<const format> p_format_supported) {
+                return request_formats(
+                  p_format_supported,
+                  VK_IMAGE_TILING_OPTIMAL,
+                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+            }
+
+            /**
+             * @return true if p_format can be used as both source and
+             * destination of a linear-filtered vkCmdBlitImage in optimal
+             * tiling, which is required to generate mips on the GPU
+             */
+            [[nodiscard]] bool linear_blit_supported(VkFormat p_format) const {
+                VkFormatProperties format_properties;
+                vkGetPhysicalDeviceFormatProperties(
+                  m_physical_device, p_format, &format_properties);
+
+                const VkFormatFeatureFlags required =
+                  VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                  VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+                return (format_properties.optimalTilingFeatures & required) ==
+                       required;
+            }
+
             [[nodiscard]] surface_params request_surface(
               const VkSurfaceKHR& p_surface,
               uint32_t p_format = VK_FORMAT_B8G8R8A8_SRGB,
@@ -230,6 +279,91 @@ export namespace vk {
                 return surface_properties;
             }
 
+            /**
+             * @brief Selects the first of p_preferred the surface supports
+             *
+             * FIFO is the only mode every surface supports and is returned
+             * when none of p_preferred are.
+             *
+             * ```C++
+             *
+             * // lowest latency without tearing, then tearing, then vsync
+             * std::array<vk::present_mode, 3> modes = {
+             *      vk::present_mode::mailbox_khr,
+             *      vk::present_mode::immediate,
+             *      vk::present_mode::fifo_relaxed_khr,
+             * };
+             * swapchain_settings.present_mode =
+             *      physical_device.request_present_mode(surface, modes);
+             *
+             * ```
+             */
+            [[nodiscard]] present_mode request_present_mode(
+              const VkSurfaceKHR& p_surface,
+              std::span<const present_mode> p_preferred) const {
+                uint32_t mode_count = 0;
+                vk_check(vkGetPhysicalDeviceSurfacePresentModesKHR(
+                           m_physical_device, p_surface, &mode_count, nullptr),
+                         "vkGetPhysicalDeviceSurfacePresentModesKHR");
+
+                std::vector<VkPresentModeKHR> modes(mode_count);
+                vk_check(
+                  vkGetPhysicalDeviceSurfacePresentModesKHR(
+                    m_physical_device, p_surface, &mode_count, modes.data()),
+                  "vkGetPhysicalDeviceSurfacePresentModesKHR");
+
+                for (present_mode preferred : p_preferred) {
+                    for (VkPresentModeKHR mode : modes) {
+                        if (mode == static_cast<VkPresentModeKHR>(preferred)) {
+                            return preferred;
+                        }
+                    }
+                }
+
+                return present_mode::fifo_khr;
+            }
+
+            /**
+             * @return true if VK_KHR_present_id and VK_KHR_present_wait
+             * features are supported, required by
+             * device_present_queue::enable_present_wait
+             */
+            [[nodiscard]] bool present_wait_supported() const {
+                VkPhysicalDevicePresentIdFeaturesKHR present_id = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+                };
+                VkPhysicalDevicePresentWaitFeaturesKHR present_wait = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+                    .pNext = &present_id,
+                };
+                VkPhysicalDeviceFeatures2 features = {
+                    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                    .pNext = &present_wait,
+                };
+                vkGetPhysicalDeviceFeatures2(m_physical_device, &features);
+                return present_id.presentId and present_wait.presentWait;
+            }
+
+            /**
+             * @return true if the graphicsPipelineLibrary feature is
+             * supported, required by pipeline_library_cache. Linking is only
+             * cheap when graphicsPipelineLibraryFastLinking is also reported.
+             */
+            [[nodiscard]] bool graphics_pipeline_library_supported() const {
+                VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT library = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+                };
+                VkPhysicalDeviceFeatures2 features = {
+                    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                    .pNext = &library,
+                };
+                vkGetPhysicalDeviceFeatures2(m_physical_device, &features);
+                return library.graphicsPipelineLibrary;
+            }
+
             operator VkPhysicalDevice() { return m_physical_device; }
 
             operator VkPhysicalDevice() const { return m_physical_device; }
@@ -81,6 +81,43 @@ export namespace vk {
             uint32_t range = 0;
         };
 
+        //! @brief Guaranteed minimum of
+        //! VkPhysicalDeviceLimits::maxPushConstantsSize
+        constexpr uint32_t min_push_constants_size = 128;
+
+        /**
+         * @brief Checks p_ranges against the rules of pipeline layout creation
+         *
+         * Every range must be non-empty, a multiple of 4 bytes in offset and
+         * size, and no stage may appear in more than one range. Ranges must
+         * also end within p_max_size unless it is 0, for a caller that did
+         * not query the device limit. vkCreatePipelineLayout is then left
+         * to reject ranges past it, and the validation layer reports them.
+         *
+         * @return true if p_ranges can be used to create a pipeline layout
+         */
+        bool validate_push_constants(
+          std::span<const push_constant_range> p_ranges,
+          uint32_t p_max_size) {
+            uint32_t stages = 0;
+            for (const push_constant_range& range : p_ranges) {
+                const uint32_t stage = static_cast<uint32_t>(range.stage);
+                if (range.range == 0 or range.offset % 4 != 0 or
+                    range.range % 4 != 0) {
+                    return false;
+                }
+                if (p_max_size != 0 and
+                    range.offset + range.range > p_max_size) {
+                    return false;
+                }
+                if ((stages & stage) != 0) {
+                    return false;
+                }
+                stages |= stage;
+            }
+            return true;
+        }
+
         /**
          * @param renderpass is required for a VkPipeline to know up front
          * @param shader_modules is a std::span<VkShaderModule> of the loaded
@@ -103,6 +140,13 @@ export namespace vk {
          * configuring the depth stencil configurations.
          * @param dynamic_states is specifying the dynamic state of the viewport
          * and scissor to configure for this graphics pipeline
+         * @param flags are the VkPipelineCreateFlags of the pipeline, such as
+         * VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT when its sets are read
+         * from descriptor buffers
+         * @param max_push_constants_size is the device maxPushConstantsSize
+         * the push constant ranges are validated against, from
+         * physical_device::properties().limits. 0 skips the check, ranges
+         * past min_push_constants_size are not portable.
          */
         struct pipeline_params {
             bool use_render_pipeline = false;
@@ -127,6 +171,12 @@ export namespace vk {
             std::span<dynamic_state> dynamic_states = {};
 
             std::span<const push_constant_range> push_constants{};
+            VkPipelineCreateFlags flags = 0;
+            uint32_t max_push_constants_size = 0;
+
+            //! @brief Specialization constants of every stage whose
+            //! shader_handle has none of its own
+            specialization_info specialization{};
         };
 
         /**
@@ -142,7 +192,8 @@ export namespace vk {
              * @param p_device is logical device to create the graphics pipeline
              * handles
              * @param p_params are the parameters for creating the pipelines
-             * with
+             * with. alive() is false if its push constants fail
+             * validate_push_constants.
              */
             pipeline(const VkDevice& p_device, const pipeline_params& p_params)
               : m_device(p_device) {
@@ -184,6 +235,10 @@ export namespace vk {
             void configure(const pipeline_params& p_params) {
                 std::vector<VkPipelineShaderStageCreateInfo>
                   pipeline_shader_stages(p_params.shader_modules.size());
+                std::vector<VkShaderModuleCreateInfo> inline_modules(
+                  p_params.shader_modules.size());
+                std::vector<VkSpecializationInfo> specializations(
+                  p_params.shader_modules.size());
 
                 uint32_t shader_src_index = 0;
 
@@ -198,9 +253,39 @@ export namespace vk {
                             VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                           .stage = static_cast<VkShaderStageFlagBits>(stage),
                           .module = src.module,
-                          .pName = "main"
+                          .pName = src.entry_point
                       };
 
+                    const specialization_info& constants =
+                      src.specialization.empty() ? p_params.specialization
+                                                 : src.specialization;
+                    if (!constants.empty()) {
+                        specializations[shader_src_index] = {
+                            .mapEntryCount =
+                              static_cast<uint32_t>(constants.entries.size()),
+                            .pMapEntries =
+                              reinterpret_cast<const VkSpecializationMapEntry*>(
+                                constants.entries.data()),
+                            .dataSize = constants.data.size_bytes(),
+                            .pData = constants.data.data(),
+                        };
+                        pipeline_shader_stages[shader_src_index]
+                          .pSpecializationInfo =
+                          &specializations[shader_src_index];
+                    }
+
+                    // maintenance5: the module is created with the pipeline
+                    if (src.module == nullptr and !src.code.empty()) {
+                        inline_modules[shader_src_index] = {
+                            .sType =
+                              VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                            .codeSize = src.code.size_bytes(),
+                            .pCode = src.code.data(),
+                        };
+                        pipeline_shader_stages[shader_src_index].pNext =
+                          &inline_modules[shader_src_index];
+                    }
+
                     shader_src_index++;
                 }
 
@@ -363,6 +448,11 @@ export namespace vk {
                       p_params.dynamic_states.data())
                 };
 
+                if (!validate_push_constants(p_params.push_constants,
+                                             p_params.max_push_constants_size)) {
+                    return;
+                }
+
                 std::vector<VkPushConstantRange> push_constants(
                   p_params.push_constants.size());
 
@@ -413,7 +503,7 @@ export namespace vk {
                     .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
                     .pNext =
                       p_params.use_render_pipeline ? &rendering_ci : nullptr,
-                    .flags = 0,
+                    .flags = p_params.flags,
                     .stageCount =
                       static_cast<uint32_t>(pipeline_shader_stages.size()),
                     .pStages = pipeline_shader_stages.data(),
@@ -0,0 +1,1051 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <algorithm>
+
+export module vk:pipeline_library;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+export import :specialization;
+export import :shader_module_cache;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @param optimize relinks every fast-linked pipeline with link-time
+         * optimization on a background thread, swapped in by apply()
+         */
+        struct pipeline_library_params {
+            bool optimize = true;
+        };
+
+        //! @brief Pipeline linked by vk::pipeline_library_cache, owned by it
+        struct linked_pipeline {
+            VkPipeline handle = nullptr;
+            VkPipelineLayout layout = nullptr;
+            bool optimized = false;
+
+            [[nodiscard]] bool alive() const { return handle != nullptr; }
+
+            void bind(const VkCommandBuffer& p_command) const {
+                vkCmdBindPipeline(
+                  p_command, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+            }
+
+            operator VkPipeline() const { return handle; }
+        };
+
+        struct pipeline_library_stats {
+            uint64_t parts_created = 0;
+            uint64_t fast_links = 0;
+            uint64_t optimized_links = 0;
+            double fast_link_ms = 0.0;
+            double optimized_link_ms = 0.0;
+        };
+
+        /**
+         * @brief Creates graphics pipelines by linking separately created
+         * parts with VK_EXT_graphics_pipeline_library
+         *
+         * pipeline_params is split into the four parts of a graphics pipeline,
+         * each created once as a pipeline library and cached by the state it
+         * holds. Shader stages are identified by their SPIR-V when the handle
+         * carries its code, as the handles of vk::shader_module_cache and
+         * vk::shader_resource do, and by their module otherwise.
+         *
+         * A pipeline seen for the first time is fast linked from its parts,
+         * which takes well under a millisecond when
+         * graphicsPipelineLibraryFastLinking is supported, instead of the
+         * tens of milliseconds of a monolithic vkCreateGraphicsPipelines.
+         * Materials sharing a vertex layout, shaders or render targets share
+         * the corresponding parts.
+         *
+         * ```
+         *
+         *  vertex input ------\
+         *  pre-rasterization --+-- fast link --> get() --> bind
+         *  fragment shader ----+
+         *  fragment output ---/ `-- optimized link (background) --> apply()
+         *
+         * ```
+         *
+         * The fast-linked pipeline is relinked with link-time optimization on
+         * a background thread. apply() swaps the optimized pipeline in at a
+         * frame boundary and collect() destroys the fast-linked one once the
+         * frames using it have completed, so get() should be called every
+         * frame rather than keeping the handle.
+         *
+         * The device must enable the graphicsPipelineLibrary feature
+         * (vk::pipeline_library) with VK_KHR_pipeline_library and
+         * VK_EXT_graphics_pipeline_library. Parts share one pipeline layout
+         * per set of descriptor layouts and push constants, owned by the
+         * cache.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::pipeline_library_cache pipelines(logical_device);
+         *
+         * // every frame
+         * pipelines.apply(frame);
+         * pipelines.collect(completed_frame);
+         *
+         * vk::linked_pipeline lit = pipelines.get(lit_params);
+         * lit.bind(current);
+         * vkCmdPushConstants(current, lit.layout, ...);
+         *
+         * ```
+         */
+        class pipeline_library_cache {
+        public:
+            pipeline_library_cache() = default;
+
+            pipeline_library_cache(
+              const VkDevice& p_device,
+              const pipeline_library_params& p_params = {})
+              : m_device(p_device)
+              , m_params(p_params) {
+                if (m_params.optimize) {
+                    m_optimizer = std::jthread(
+                      [this](std::stop_token p_stop) { optimizer(p_stop); });
+                }
+            }
+
+            pipeline_library_cache(const pipeline_library_cache&) = delete;
+            pipeline_library_cache& operator=(const pipeline_library_cache&) =
+              delete;
+
+            //! @brief Only joins the optimizer thread. Pipelines and layouts
+            //! are destroyed by destruct(), before the device is.
+            ~pipeline_library_cache() { stop_optimizer(); }
+
+            /**
+             * @return the pipeline of p_params, fast linked on first use and
+             * optimized once apply() swapped the relinked pipeline in. Not
+             * alive if p_params could not be created. Safe to call from
+             * multiple threads.
+             */
+            [[nodiscard]] linked_pipeline get(
+              const pipeline_params& p_params) {
+                const state_key layout_key = layout_state(p_params);
+                const std::array<state_key, 4> part_keys = {
+                    vertex_input_state(p_params),
+                    pre_rasterization_state(p_params, layout_key),
+                    fragment_shader_state(p_params, layout_key),
+                    fragment_output_state(p_params),
+                };
+                state_key key(0);
+                for (const state_key& part_key : part_keys) {
+                    key.add_key(part_key);
+                }
+
+                {
+                    std::scoped_lock lock(m_mutex);
+                    if (auto found = m_linked.find(key);
+                        found != m_linked.end()) {
+                        return found->second.current;
+                    }
+                }
+
+                // Created without m_mutex, so other threads keep getting
+                // their cached pipelines meanwhile. A thread racing on the
+                // same key loses the insert and destroys what it created.
+                const VkPipelineLayout layout =
+                  create_layout(p_params, layout_key);
+                if (layout == nullptr) {
+                    return {};
+                }
+
+                const std::array<VkPipeline, 4> libraries = {
+                    create_part(part_keys[0], vertex_input_part(p_params)),
+                    create_part(part_keys[1],
+                                pre_rasterization_part(p_params, layout)),
+                    create_part(part_keys[2],
+                                fragment_shader_part(p_params, layout)),
+                    create_part(part_keys[3], fragment_output_part(p_params)),
+                };
+                if (std::ranges::contains(libraries, nullptr)) {
+                    return {};
+                }
+
+                const auto start = std::chrono::steady_clock::now();
+                const VkPipeline handle =
+                  link(libraries, layout, p_params.flags, false);
+                const double elapsed_ms =
+                  std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+                std::scoped_lock lock(m_mutex);
+                m_stats.fast_link_ms += elapsed_ms;
+                m_stats.fast_links++;
+                if (handle == nullptr) {
+                    return {};
+                }
+
+                auto [found, inserted] = m_linked.try_emplace(
+                  std::move(key),
+                  linked_entry{
+                    .current = { .handle = handle, .layout = layout },
+                  });
+                if (!inserted) {
+                    vkDestroyPipeline(m_device, handle, nullptr);
+                    return found->second.current;
+                }
+
+                if (m_params.optimize) {
+                    m_requests.push_back({
+                      .entry = &found->second,
+                      .libraries = libraries,
+                      .layout = layout,
+                      .flags = p_params.flags,
+                    });
+                    m_request_signal.notify_one();
+                }
+                return found->second.current;
+            }
+
+            /**
+             * @brief Swaps optimized pipelines in, called at a frame boundary
+             * before recording p_frame
+             *
+             * @return the amount of pipelines swapped
+             */
+            uint32_t apply(uint64_t p_frame) {
+                std::scoped_lock lock(m_mutex);
+                for (linked_entry* entry : m_optimized) {
+                    m_retired.push_back({ entry->current.handle, p_frame });
+                    entry->current.handle = entry->optimized;
+                    entry->current.optimized = true;
+                    entry->optimized = nullptr;
+                }
+                const auto swapped = static_cast<uint32_t>(m_optimized.size());
+                m_optimized.clear();
+                return swapped;
+            }
+
+            /**
+             * @brief Destroys fast-linked pipelines retired at or before
+             * p_completed_frame
+             *
+             * @param p_completed_frame is the newest frame whose fence has
+             * signaled
+             */
+            void collect(uint64_t p_completed_frame) {
+                std::scoped_lock lock(m_mutex);
+                std::erase_if(m_retired,
+                              [this, p_completed_frame](
+                                const retired_pipeline& p_retired) {
+                                  if (p_retired.frame > p_completed_frame) {
+                                      return false;
+                                  }
+                                  vkDestroyPipeline(
+                                    m_device, p_retired.handle, nullptr);
+                                  return true;
+                              });
+            }
+
+            [[nodiscard]] pipeline_library_stats stats() const {
+                std::scoped_lock lock(m_mutex);
+                return m_stats;
+            }
+
+            //! @brief Destroys every pipeline, library and layout. The device
+            //! must be idle.
+            void destruct() {
+                if (m_device == nullptr) {
+                    return;
+                }
+
+                stop_optimizer();
+
+                std::scoped_lock lock(m_mutex);
+                for (auto& [key, entry] : m_linked) {
+                    vkDestroyPipeline(m_device, entry.current.handle, nullptr);
+                    if (entry.optimized != nullptr) {
+                        vkDestroyPipeline(m_device, entry.optimized, nullptr);
+                    }
+                }
+                for (const retired_pipeline& retired : m_retired) {
+                    vkDestroyPipeline(m_device, retired.handle, nullptr);
+                }
+                for (auto& [key, library] : m_parts) {
+                    vkDestroyPipeline(m_device, library, nullptr);
+                }
+                for (auto& [key, layout] : m_layouts) {
+                    vkDestroyPipelineLayout(m_device, layout, nullptr);
+                }
+                m_linked.clear();
+                m_retired.clear();
+                m_parts.clear();
+                m_layouts.clear();
+                m_requests.clear();
+                m_optimized.clear();
+                m_device = nullptr;
+            }
+
+        private:
+            struct linked_entry {
+                linked_pipeline current{};
+                VkPipeline optimized = nullptr;
+            };
+
+            struct retired_pipeline {
+                VkPipeline handle = nullptr;
+                uint64_t frame = 0;
+            };
+
+            // Entries of m_linked are only erased by destruct, which clears
+            // the requests first
+            struct optimize_request {
+                linked_entry* entry = nullptr;
+                std::array<VkPipeline, 4> libraries{};
+                VkPipelineLayout layout = nullptr;
+                VkPipelineCreateFlags flags = 0;
+            };
+
+            //! @brief Create info of one part and the state it points to
+            struct part_info {
+                VkGraphicsPipelineLibraryFlagsEXT flags = 0;
+                VkPipelineLayout layout = nullptr;
+                std::vector<VkPipelineShaderStageCreateInfo> stages;
+                std::vector<VkSpecializationInfo> specializations;
+                std::vector<VkShaderModuleCreateInfo> inline_modules;
+                std::vector<VkPipelineColorBlendAttachmentState> attachments;
+                VkPipelineVertexInputStateCreateInfo vertex_input{};
+                VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+                VkPipelineViewportStateCreateInfo viewport{};
+                VkPipelineRasterizationStateCreateInfo rasterization{};
+                VkPipelineMultisampleStateCreateInfo multisample{};
+                VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+                VkPipelineColorBlendStateCreateInfo color_blend{};
+                VkPipelineDynamicStateCreateInfo dynamic_state{};
+                VkPipelineRenderingCreateInfo rendering{};
+                bool use_rendering = false;
+                bool use_dynamic_state = false;
+                VkRenderPass renderpass = nullptr;
+                VkPipelineCreateFlags pipeline_flags = 0;
+            };
+
+            /**
+             * @brief Bytes of the state of a part, and their hash_bytes
+             *
+             * The bytes are kept so a lookup compares the whole state rather
+             * than trusting a matching 64-bit hash.
+             */
+            class state_key {
+            public:
+                state_key(uint64_t p_seed) { add(p_seed); }
+
+                template<typename T>
+                void add(const T& p_value) {
+                    add_bytes(std::as_bytes(std::span(&p_value, 1)));
+                }
+
+                template<typename T>
+                void add_span(std::span<const T> p_values) {
+                    add(p_values.size());
+                    for (const T& value : p_values) {
+                        add(value);
+                    }
+                }
+
+                void add_bytes(std::span<const std::byte> p_bytes) {
+                    m_bytes.insert(
+                      m_bytes.end(), p_bytes.begin(), p_bytes.end());
+                    m_hash = hash_bytes(p_bytes, m_hash);
+                }
+
+                //! @brief Adds the words of a module, hashed with spirv_hash
+                void add_spirv(std::span<const uint32_t> p_words) {
+                    const std::span<const std::byte> bytes =
+                      std::as_bytes(p_words);
+                    add(p_words.size());
+                    m_bytes.insert(m_bytes.end(), bytes.begin(), bytes.end());
+                    m_hash = hash_combine(m_hash, spirv_hash(p_words));
+                }
+
+                void add_key(const state_key& p_key) {
+                    m_bytes.insert(m_bytes.end(),
+                                   p_key.m_bytes.begin(),
+                                   p_key.m_bytes.end());
+                    m_hash = hash_combine(m_hash, p_key.m_hash);
+                }
+
+                [[nodiscard]] uint64_t value() const { return m_hash; }
+
+                bool operator==(const state_key& p_other) const {
+                    return m_hash == p_other.m_hash and
+                           m_bytes == p_other.m_bytes;
+                }
+
+            private:
+                std::vector<std::byte> m_bytes;
+                uint64_t m_hash = hash_seed;
+            };
+
+            struct state_key_hash {
+                size_t operator()(const state_key& p_key) const {
+                    return static_cast<size_t>(p_key.value());
+                }
+            };
+
+            template<typename T>
+            using state_map =
+              std::unordered_map<state_key, T, state_key_hash>;
+
+            [[nodiscard]] static state_key layout_state(
+              const pipeline_params& p_params) {
+                state_key key(0);
+                key.add_span(std::span<const VkDescriptorSetLayout>(
+                  p_params.descriptor_layouts));
+                for (const push_constant_range& range :
+                     p_params.push_constants) {
+                    key.add(range.stage);
+                    key.add(range.offset);
+                    key.add(range.range);
+                }
+                return key;
+            }
+
+            // Dynamic states are passed only with depth stencil enabled, as
+            // pipeline::configure does
+            static void add_dynamic_state(state_key& p_key,
+                                          const pipeline_params& p_params) {
+                p_key.add(p_params.depth_stencil_enabled);
+                if (p_params.depth_stencil_enabled) {
+                    p_key.add_span(
+                      std::span<const dynamic_state>(p_params.dynamic_states));
+                }
+            }
+
+            static void add_stages(state_key& p_key,
+                                   const pipeline_params& p_params,
+                                   bool p_fragment) {
+                for (const shader_handle& shader : p_params.shader_modules) {
+                    if ((shader.stage == shader_stage::fragment) !=
+                        p_fragment) {
+                        continue;
+                    }
+                    p_key.add(shader.stage);
+                    // A destroyed module's handle can be reused by another
+                    // module, the SPIR-V identifies the shader instead
+                    if (shader.code.empty()) {
+                        p_key.add(shader.module);
+                    }
+                    else {
+                        p_key.add_spirv(shader.code);
+                    }
+                    p_key.add_span(std::span<const char>(
+                      shader.entry_point, std::strlen(shader.entry_point)));
+
+                    const specialization_info& constants =
+                      shader.specialization.empty() ? p_params.specialization
+                                                    : shader.specialization;
+                    const std::vector<std::byte> permutation =
+                      permutation_bytes(constants);
+                    p_key.add(permutation.size());
+                    p_key.add_bytes(permutation);
+                }
+            }
+
+            [[nodiscard]] static state_key vertex_input_state(
+              const pipeline_params& p_params) {
+                state_key key(1);
+                key.add(p_params.flags);
+                key.add_span(p_params.vertex_bind_attributes);
+                key.add_span(p_params.vertex_attributes);
+                key.add(p_params.input_assembly.topology);
+                key.add(p_params.input_assembly.primitive_restart_enable);
+                add_dynamic_state(key, p_params);
+                return key;
+            }
+
+            [[nodiscard]] static state_key pre_rasterization_state(
+              const pipeline_params& p_params,
+              const state_key& p_layout_key) {
+                state_key key(2);
+                key.add_key(p_layout_key);
+                key.add(p_params.flags);
+                add_stages(key, p_params, false);
+                key.add(p_params.viewport.viewport_count);
+                key.add(p_params.viewport.scissor_count);
+
+                const rasterization_state& rasterization =
+                  p_params.rasterization;
+                key.add(rasterization.depth_clamp_enabled);
+                key.add(rasterization.rasterizer_discard_enabled);
+                key.add(rasterization.polygon_mode);
+                key.add(rasterization.cull_mode);
+                key.add(rasterization.front_face);
+                key.add(rasterization.depth_bias_enabled);
+                key.add(rasterization.depth_bias_constant);
+                key.add(rasterization.depth_bias_clamp);
+                key.add(rasterization.depth_bias_slope);
+                key.add(rasterization.line_width);
+
+                key.add(p_params.renderpass);
+                key.add(p_params.use_render_pipeline);
+                add_dynamic_state(key, p_params);
+                return key;
+            }
+
+            static void add_multisample(state_key& p_key,
+                                         const pipeline_params& p_params) {
+                const multisample_state& multisample = p_params.multisample;
+                p_key.add(multisample.rasterization_samples);
+                p_key.add(multisample.shading_enabled);
+                p_key.add(multisample.min_shading);
+                p_key.add_span(
+                  std::span<const uint32_t>(multisample.p_sample_masks));
+                p_key.add(multisample.alpha_to_coverage_enable);
+                p_key.add(multisample.alpha_to_one_enable);
+            }
+
+            [[nodiscard]] static state_key fragment_shader_state(
+              const pipeline_params& p_params,
+              const state_key& p_layout_key) {
+                state_key key(3);
+                key.add_key(p_layout_key);
+                key.add(p_params.flags);
+                add_stages(key, p_params, true);
+
+                const depth_stencil_state& depth_stencil =
+                  p_params.depth_stencil;
+                key.add(depth_stencil.depth_test_enable);
+                key.add(depth_stencil.depth_write_enable);
+                key.add(depth_stencil.depth_compare_op);
+                key.add(depth_stencil.depth_bounds_test_enable);
+                key.add(depth_stencil.stencil_test_enable);
+
+                add_multisample(key, p_params);
+                key.add(p_params.renderpass);
+                key.add(p_params.use_render_pipeline);
+                add_dynamic_state(key, p_params);
+                return key;
+            }
+
+            [[nodiscard]] static state_key fragment_output_state(
+              const pipeline_params& p_params) {
+                state_key key(4);
+                key.add(p_params.flags);
+
+                const color_blend_state& color_blend = p_params.color_blend;
+                key.add(color_blend.logic_op_enable);
+                key.add(color_blend.logical_op);
+                for (const color_blend_attachment_state& attachment :
+                     color_blend.attachments) {
+                    key.add(attachment.blend_enabled);
+                    key.add(attachment.src_color_blend_factor);
+                    key.add(attachment.dst_color_blend_factor);
+                    key.add(attachment.color_blend_op);
+                    key.add(attachment.src_alpha_blend_factor);
+                    key.add(attachment.dst_alpha_blend_factor);
+                    key.add(attachment.alpha_blend_op);
+                    key.add(attachment.color_write_mask);
+                }
+                key.add_span(
+                  std::span<const float>(color_blend.blend_constants));
+
+                add_multisample(key, p_params);
+                key.add(p_params.renderpass);
+                key.add(p_params.use_render_pipeline);
+                key.add_span(p_params.color_attachment_formats);
+                key.add(p_params.depth_format);
+                key.add(p_params.stencil_format);
+                add_dynamic_state(key, p_params);
+                return key;
+            }
+
+            //! @return the layout of p_params, created on first use
+            [[nodiscard]] VkPipelineLayout create_layout(
+              const pipeline_params& p_params,
+              const state_key& p_key) {
+                {
+                    std::scoped_lock lock(m_mutex);
+                    if (auto found = m_layouts.find(p_key);
+                        found != m_layouts.end()) {
+                        return found->second;
+                    }
+                }
+
+                if (!validate_push_constants(
+                      p_params.push_constants,
+                      p_params.max_push_constants_size)) {
+                    return nullptr;
+                }
+
+                std::vector<VkPushConstantRange> push_constants;
+                for (const push_constant_range& range :
+                     p_params.push_constants) {
+                    push_constants.push_back({
+                      .stageFlags =
+                        static_cast<VkShaderStageFlags>(range.stage),
+                      .offset = range.offset,
+                      .size = range.range,
+                    });
+                }
+
+                VkPipelineLayoutCreateInfo pipeline_layout_ci = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                    .setLayoutCount =
+                      static_cast<uint32_t>(p_params.descriptor_layouts.size()),
+                    .pSetLayouts = p_params.descriptor_layouts.data(),
+                    .pushConstantRangeCount =
+                      static_cast<uint32_t>(push_constants.size()),
+                    .pPushConstantRanges = push_constants.data(),
+                };
+
+                VkPipelineLayout layout = nullptr;
+                vk_check(vkCreatePipelineLayout(
+                           m_device, &pipeline_layout_ci, nullptr, &layout),
+                         "vkCreatePipelineLayout");
+                if (layout == nullptr) {
+                    return nullptr;
+                }
+
+                std::scoped_lock lock(m_mutex);
+                auto [found, inserted] = m_layouts.try_emplace(p_key, layout);
+                if (!inserted) {
+                    vkDestroyPipelineLayout(m_device, layout, nullptr);
+                }
+                return found->second;
+            }
+
+            static void common_state(part_info& p_part,
+                                     const pipeline_params& p_params) {
+                p_part.pipeline_flags = p_params.flags;
+                p_part.renderpass = p_params.renderpass;
+                p_part.use_rendering = p_params.use_render_pipeline;
+                p_part.rendering = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+                    .colorAttachmentCount = static_cast<uint32_t>(
+                      p_params.color_attachment_formats.size()),
+                    .pColorAttachmentFormats =
+                      reinterpret_cast<const VkFormat*>(
+                        p_params.color_attachment_formats.data()),
+                    .depthAttachmentFormat =
+                      static_cast<VkFormat>(p_params.depth_format),
+                    .stencilAttachmentFormat =
+                      static_cast<VkFormat>(p_params.stencil_format),
+                };
+                p_part.use_dynamic_state = p_params.depth_stencil_enabled;
+                p_part.dynamic_state = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+                    .dynamicStateCount =
+                      static_cast<uint32_t>(p_params.dynamic_states.size()),
+                    .pDynamicStates = reinterpret_cast<const VkDynamicState*>(
+                      p_params.dynamic_states.data()),
+                };
+            }
+
+            static void shader_stages(part_info& p_part,
+                                      const pipeline_params& p_params,
+                                      bool p_fragment) {
+                // Reserved up front, stages point into these
+                p_part.specializations.reserve(p_params.shader_modules.size());
+                p_part.inline_modules.reserve(p_params.shader_modules.size());
+
+                for (const shader_handle& shader : p_params.shader_modules) {
+                    if ((shader.stage == shader_stage::fragment) !=
+                        p_fragment) {
+                        continue;
+                    }
+
+                    VkPipelineShaderStageCreateInfo stage = {
+                        .sType =
+                          VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                        .stage =
+                          static_cast<VkShaderStageFlagBits>(shader.stage),
+                        .module = shader.module,
+                        .pName = shader.entry_point,
+                    };
+
+                    const specialization_info& constants =
+                      shader.specialization.empty() ? p_params.specialization
+                                                    : shader.specialization;
+                    if (!constants.empty()) {
+                        stage.pSpecializationInfo =
+                          &p_part.specializations.emplace_back(
+                            VkSpecializationInfo{
+                              .mapEntryCount = static_cast<uint32_t>(
+                                constants.entries.size()),
+                              .pMapEntries = reinterpret_cast<
+                                const VkSpecializationMapEntry*>(
+                                constants.entries.data()),
+                              .dataSize = constants.data.size_bytes(),
+                              .pData = constants.data.data(),
+                            });
+                    }
+
+                    // maintenance5: the module is created with the pipeline
+                    if (shader.module == nullptr and !shader.code.empty()) {
+                        stage.pNext = &p_part.inline_modules.emplace_back(
+                          VkShaderModuleCreateInfo{
+                            .sType =
+                              VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                            .codeSize = shader.code.size_bytes(),
+                            .pCode = shader.code.data(),
+                          });
+                    }
+                    p_part.stages.push_back(stage);
+                }
+            }
+
+            static void multisample(part_info& p_part,
+                                    const pipeline_params& p_params) {
+                p_part.multisample = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+                    .rasterizationSamples = static_cast<VkSampleCountFlagBits>(
+                      p_params.multisample.rasterization_samples),
+                    .sampleShadingEnable = p_params.multisample.shading_enabled,
+                    .minSampleShading = p_params.multisample.min_shading,
+                    .pSampleMask = p_params.multisample.p_sample_masks.data(),
+                    .alphaToCoverageEnable =
+                      p_params.multisample.alpha_to_coverage_enable,
+                    .alphaToOneEnable =
+                      p_params.multisample.alpha_to_one_enable,
+                };
+            }
+
+            [[nodiscard]] static part_info vertex_input_part(
+              const pipeline_params& p_params) {
+                part_info part;
+                common_state(part, p_params);
+                part.flags =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+                part.vertex_input = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+                    .vertexBindingDescriptionCount = static_cast<uint32_t>(
+                      p_params.vertex_bind_attributes.size()),
+                    .pVertexBindingDescriptions =
+                      p_params.vertex_bind_attributes.data(),
+                    .vertexAttributeDescriptionCount =
+                      static_cast<uint32_t>(p_params.vertex_attributes.size()),
+                    .pVertexAttributeDescriptions =
+                      p_params.vertex_attributes.data(),
+                };
+                part.input_assembly = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+                    .topology = static_cast<VkPrimitiveTopology>(
+                      p_params.input_assembly.topology),
+                    .primitiveRestartEnable =
+                      p_params.input_assembly.primitive_restart_enable,
+                };
+                return part;
+            }
+
+            [[nodiscard]] static part_info pre_rasterization_part(
+              const pipeline_params& p_params,
+              VkPipelineLayout p_layout) {
+                part_info part;
+                common_state(part, p_params);
+                part.flags =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+                part.layout = p_layout;
+                shader_stages(part, p_params, false);
+                part.viewport = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+                    .viewportCount = p_params.viewport.viewport_count,
+                    .scissorCount = p_params.viewport.scissor_count,
+                };
+
+                const rasterization_state& rasterization =
+                  p_params.rasterization;
+                part.rasterization = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+                    .depthClampEnable = rasterization.depth_clamp_enabled,
+                    .rasterizerDiscardEnable =
+                      rasterization.rasterizer_discard_enabled,
+                    .polygonMode =
+                      static_cast<VkPolygonMode>(rasterization.polygon_mode),
+                    .cullMode =
+                      static_cast<VkCullModeFlags>(rasterization.cull_mode),
+                    .frontFace =
+                      static_cast<VkFrontFace>(rasterization.front_face),
+                    .depthBiasEnable = rasterization.depth_bias_enabled,
+                    .depthBiasConstantFactor =
+                      rasterization.depth_bias_constant,
+                    .depthBiasClamp = rasterization.depth_bias_clamp,
+                    .depthBiasSlopeFactor = rasterization.depth_bias_slope,
+                    .lineWidth = rasterization.line_width,
+                };
+                return part;
+            }
+
+            [[nodiscard]] static part_info fragment_shader_part(
+              const pipeline_params& p_params,
+              VkPipelineLayout p_layout) {
+                part_info part;
+                common_state(part, p_params);
+                part.flags =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+                part.layout = p_layout;
+                shader_stages(part, p_params, true);
+                multisample(part, p_params);
+                part.depth_stencil = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+                    .depthTestEnable = p_params.depth_stencil.depth_test_enable,
+                    .depthWriteEnable =
+                      p_params.depth_stencil.depth_write_enable,
+                    .depthCompareOp = static_cast<VkCompareOp>(
+                      p_params.depth_stencil.depth_compare_op),
+                    .depthBoundsTestEnable =
+                      p_params.depth_stencil.depth_bounds_test_enable,
+                    .stencilTestEnable =
+                      p_params.depth_stencil.stencil_test_enable,
+                };
+                return part;
+            }
+
+            [[nodiscard]] static part_info fragment_output_part(
+              const pipeline_params& p_params) {
+                part_info part;
+                common_state(part, p_params);
+                part.flags =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+                multisample(part, p_params);
+
+                const color_blend_state& color_blend = p_params.color_blend;
+                for (const color_blend_attachment_state& attachment :
+                     color_blend.attachments) {
+                    part.attachments.push_back({
+                      .blendEnable = attachment.blend_enabled,
+                      .srcColorBlendFactor = static_cast<VkBlendFactor>(
+                        attachment.src_color_blend_factor),
+                      .dstColorBlendFactor = static_cast<VkBlendFactor>(
+                        attachment.dst_color_blend_factor),
+                      .colorBlendOp =
+                        static_cast<VkBlendOp>(attachment.color_blend_op),
+                      .srcAlphaBlendFactor = static_cast<VkBlendFactor>(
+                        attachment.src_alpha_blend_factor),
+                      .dstAlphaBlendFactor = static_cast<VkBlendFactor>(
+                        attachment.dst_alpha_blend_factor),
+                      .alphaBlendOp =
+                        static_cast<VkBlendOp>(attachment.alpha_blend_op),
+                      .colorWriteMask = static_cast<VkColorComponentFlags>(
+                        attachment.color_write_mask),
+                    });
+                }
+
+                part.color_blend = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+                    .logicOpEnable = color_blend.logic_op_enable,
+                    .logicOp = static_cast<VkLogicOp>(color_blend.logical_op),
+                    .attachmentCount =
+                      static_cast<uint32_t>(part.attachments.size()),
+                    .pAttachments = part.attachments.data(),
+                    .blendConstants = { 0.f, 0.f, 0.f, 0.f },
+                };
+                if (color_blend.blend_constants.size() >= 4) {
+                    std::ranges::copy(color_blend.blend_constants.first<4>(),
+                                      part.color_blend.blendConstants);
+                }
+                return part;
+            }
+
+            //! @return the library of p_key, created from p_part on first use
+            [[nodiscard]] VkPipeline create_part(const state_key& p_key,
+                                                 const part_info& p_part) {
+                {
+                    std::scoped_lock lock(m_mutex);
+                    if (auto found = m_parts.find(p_key);
+                        found != m_parts.end()) {
+                        return found->second;
+                    }
+                }
+
+                VkGraphicsPipelineLibraryCreateInfoEXT library_ci = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+                    .pNext = p_part.use_rendering ? &p_part.rendering : nullptr,
+                    .flags = p_part.flags,
+                };
+
+                auto state_of = [&p_part](auto p_flag, const auto* p_state) {
+                    return (p_part.flags & p_flag) ? p_state : nullptr;
+                };
+                constexpr auto vertex_input =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+                constexpr auto pre_rasterization =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+                constexpr auto fragment_shader =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+                constexpr auto fragment_output =
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+                // Retained so the parts can be relinked with optimization
+                constexpr VkPipelineCreateFlags library_flags =
+                  VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                  VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+                VkGraphicsPipelineCreateInfo graphics_pipeline_ci = {
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .pNext = &library_ci,
+                    .flags = p_part.pipeline_flags | library_flags,
+                    .stageCount = static_cast<uint32_t>(p_part.stages.size()),
+                    .pStages = p_part.stages.data(),
+                    .pVertexInputState =
+                      state_of(vertex_input, &p_part.vertex_input),
+                    .pInputAssemblyState =
+                      state_of(vertex_input, &p_part.input_assembly),
+                    .pViewportState =
+                      state_of(pre_rasterization, &p_part.viewport),
+                    .pRasterizationState =
+                      state_of(pre_rasterization, &p_part.rasterization),
+                    .pMultisampleState = state_of(
+                      fragment_shader | fragment_output, &p_part.multisample),
+                    .pDepthStencilState =
+                      state_of(fragment_shader, &p_part.depth_stencil),
+                    .pColorBlendState =
+                      state_of(fragment_output, &p_part.color_blend),
+                    .pDynamicState = p_part.use_dynamic_state
+                                       ? &p_part.dynamic_state
+                                       : nullptr,
+                    .layout = p_part.layout,
+                    .renderPass = p_part.renderpass,
+                    .subpass = 0,
+                    .basePipelineHandle = nullptr,
+                    .basePipelineIndex = -1,
+                };
+
+                VkPipeline library = nullptr;
+                vk_check(vkCreateGraphicsPipelines(m_device,
+                                                   nullptr,
+                                                   1,
+                                                   &graphics_pipeline_ci,
+                                                   nullptr,
+                                                   &library),
+                         "vkCreateGraphicsPipelines");
+                if (library == nullptr) {
+                    return nullptr;
+                }
+
+                std::scoped_lock lock(m_mutex);
+                auto [found, inserted] = m_parts.try_emplace(p_key, library);
+                if (!inserted) {
+                    vkDestroyPipeline(m_device, library, nullptr);
+                    return found->second;
+                }
+                m_stats.parts_created++;
+                return library;
+            }
+
+            [[nodiscard]] VkPipeline link(
+              const std::array<VkPipeline, 4>& p_libraries,
+              VkPipelineLayout p_layout,
+              VkPipelineCreateFlags p_flags,
+              bool p_optimize) const {
+                VkPipelineLibraryCreateInfoKHR library_ci = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+                    .libraryCount = static_cast<uint32_t>(p_libraries.size()),
+                    .pLibraries = p_libraries.data(),
+                };
+
+                VkGraphicsPipelineCreateInfo graphics_pipeline_ci = {
+                    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                    .pNext = &library_ci,
+                    .flags =
+                      p_flags |
+                      (p_optimize
+                         ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT
+                         : 0),
+                    .layout = p_layout,
+                    .basePipelineHandle = nullptr,
+                    .basePipelineIndex = -1,
+                };
+
+                VkPipeline linked = nullptr;
+                vk_check(vkCreateGraphicsPipelines(m_device,
+                                                   nullptr,
+                                                   1,
+                                                   &graphics_pipeline_ci,
+                                                   nullptr,
+                                                   &linked),
+                         "vkCreateGraphicsPipelines");
+                return linked;
+            }
+
+            void stop_optimizer() {
+                if (m_optimizer.joinable()) {
+                    m_optimizer.request_stop();
+                    m_request_signal.notify_all();
+                    m_optimizer.join();
+                }
+            }
+
+            void optimizer(std::stop_token p_stop) {
+                while (!p_stop.stop_requested()) {
+                    optimize_request request;
+                    {
+                        std::unique_lock lock(m_mutex);
+                        m_request_signal.wait(lock, p_stop, [this]() {
+                            return !m_requests.empty();
+                        });
+                        if (m_requests.empty()) {
+                            return;
+                        }
+                        request = m_requests.front();
+                        m_requests.pop_front();
+                    }
+
+                    // Libraries and layouts live until destruct, which stops
+                    // this thread first
+                    const auto start = std::chrono::steady_clock::now();
+                    const VkPipeline optimized = link(
+                      request.libraries, request.layout, request.flags, true);
+                    const double elapsed_ms =
+                      std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+                    std::scoped_lock lock(m_mutex);
+                    m_stats.optimized_links++;
+                    m_stats.optimized_link_ms += elapsed_ms;
+                    if (optimized != nullptr) {
+                        request.entry->optimized = optimized;
+                        m_optimized.push_back(request.entry);
+                    }
+                }
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            pipeline_library_params m_params{};
+            mutable std::mutex m_mutex;
+            state_map<VkPipelineLayout> m_layouts;
+            state_map<VkPipeline> m_parts;
+            state_map<linked_entry> m_linked;
+            std::vector<retired_pipeline> m_retired;
+            std::vector<linked_entry*> m_optimized;
+            std::deque<optimize_request> m_requests;
+            std::condition_variable_any m_request_signal;
+            pipeline_library_stats m_stats{};
+            std::jthread m_optimizer;
+        };
+    };
+};
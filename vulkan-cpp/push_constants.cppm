@@ -0,0 +1,240 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+export module vk:push_constants;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+
+export namespace vk {
+    inline namespace v6 {
+
+        //! @brief Maximum push constant ranges a push_constant_block splits
+        //! its updates over
+        constexpr uint32_t max_push_constant_ranges = 8;
+
+        /**
+         * @brief Typed push constant block of T placed at byte p_offset of
+         * the pipeline layout push constant space
+         *
+         * The layout of T is checked at compile time: the block must be 4-byte
+         * aligned and fit max_size (the guaranteed 128 bytes unless the
+         * device limit is known to be larger).
+         *
+         * The block keeps a copy of the last pushed bytes so push() only
+         * records the bytes that changed, split over the stage ranges that
+         * declare them. Per-draw data that changes one field per draw then
+         * costs a 4 to 16 byte push instead of the whole struct.
+         *
+         * ```
+         *
+         *  ranges:  [ vertex: 0..64 ][ fragment: 64..80 ]
+         *  changed:          [ 48..72 )
+         *  pushes:  vertex 48..64, fragment 64..72
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * struct draw_constants {
+         *      glm::mat4 model;        // vertex
+         *      uint32_t albedo_index;  // fragment
+         *      uint32_t padding[3];
+         * };
+         * using draw_block = vk::push_constant_block<draw_constants>;
+         *
+         * std::array<vk::push_constant_range, 2> ranges = {
+         *      draw_block::subrange(vk::shader_stage::vertex,
+         *          offsetof(draw_constants, model), sizeof(glm::mat4)),
+         *      draw_block::subrange(vk::shader_stage::fragment,
+         *          offsetof(draw_constants, albedo_index), 16),
+         * };
+         * // pass ranges to vk::pipeline_params::push_constants
+         *
+         * draw_block constants;
+         * constants.invalidate(); // after binding the pipeline
+         * for (const auto& object : objects) {
+         *      constants.data().model = object.transform;
+         *      constants.push(current, pipeline.layout(), ranges);
+         * }
+         *
+         * ```
+         */
+        template<typename T,
+                 uint32_t p_offset = 0,
+                 uint32_t max_size = min_push_constants_size>
+        class push_constant_block {
+            static_assert(std::is_trivially_copyable_v<T>,
+                          "Push constant blocks are copied byte-wise and must "
+                          "be trivially copyable.");
+            static_assert(p_offset % 4 == 0,
+                          "Push constant offsets must be a multiple of 4.");
+            static_assert(sizeof(T) % 4 == 0,
+                          "Push constant sizes must be a multiple of 4, pad "
+                          "the block.");
+            static_assert(p_offset + sizeof(T) <= max_size,
+                          "Push constant block exceeds max_size bytes.");
+
+        public:
+            //! @brief Byte offset of the block in the push constant space
+            static constexpr uint32_t offset = p_offset;
+            //! @brief Byte size of the block
+            static constexpr uint32_t size = sizeof(T);
+
+            //! @return a range declaring the whole block for p_stage
+            static constexpr push_constant_range range(shader_stage p_stage) {
+                return push_constant_range{
+                    .stage = p_stage,
+                    .offset = offset,
+                    .range = size,
+                };
+            }
+
+            /**
+             * @return a range declaring p_size bytes at p_member_offset of T
+             * for p_stage, such as offsetof(T, field)
+             */
+            static constexpr push_constant_range subrange(
+              shader_stage p_stage,
+              uint32_t p_member_offset,
+              uint32_t p_size) {
+                return push_constant_range{
+                    .stage = p_stage,
+                    .offset = offset + p_member_offset,
+                    .range = p_size,
+                };
+            }
+
+            push_constant_block() = default;
+
+            push_constant_block(const T& p_data)
+              : m_data(p_data) {}
+
+            //! @return the data pushed by the next push()
+            [[nodiscard]] T& data() { return m_data; }
+
+            [[nodiscard]] const T& data() const { return m_data; }
+
+            /**
+             * @brief Forces the next push() to push every byte, required
+             * after binding a pipeline with a different layout
+             */
+            void invalidate() { m_valid = false; }
+
+            /**
+             * @brief Pushes the bytes of data() that changed since the last
+             * push
+             *
+             * @param p_ranges are the push constant ranges p_layout was
+             * created with
+             * @return false, pushing nothing, if p_ranges has more than
+             * max_push_constant_ranges ranges
+             */
+            bool push(const VkCommandBuffer& p_current,
+                      const VkPipelineLayout& p_layout,
+                      std::span<const push_constant_range> p_ranges) {
+                if (p_ranges.size() > max_push_constant_ranges) {
+                    return false;
+                }
+
+                const auto* bytes = reinterpret_cast<const uint8_t*>(&m_data);
+                const auto* pushed = reinterpret_cast<uint8_t*>(&m_pushed);
+
+                uint32_t first = 0;
+                uint32_t last = size;
+                if (m_valid) {
+                    while (first < size and bytes[first] == pushed[first]) {
+                        first++;
+                    }
+                    if (first == size) {
+                        return true;
+                    }
+                    while (last > first and
+                           bytes[last - 1] == pushed[last - 1]) {
+                        last--;
+                    }
+                    first = first / 4 * 4;
+                    last = (last + 3) / 4 * 4;
+                }
+
+                push_bytes(
+                  p_current, p_layout, p_ranges, offset + first, offset + last);
+
+                std::memcpy(&m_pushed, &m_data, sizeof(T));
+                m_valid = true;
+                return true;
+            }
+
+        private:
+            /**
+             * Splits [p_begin, p_end) at every range boundary, pushing each
+             * piece with the stages of every range covering it, as
+             * vkCmdPushConstants requires. p_ranges holds at most
+             * max_push_constant_ranges ranges.
+             */
+            void push_bytes(const VkCommandBuffer& p_current,
+                            const VkPipelineLayout& p_layout,
+                            std::span<const push_constant_range> p_ranges,
+                            uint32_t p_begin,
+                            uint32_t p_end) const {
+                std::array<uint32_t, 2 * max_push_constant_ranges + 2> cuts{};
+                uint32_t cut_count = 0;
+                cuts[cut_count++] = p_begin;
+                cuts[cut_count++] = p_end;
+                for (const push_constant_range& range : p_ranges) {
+                    for (uint32_t cut : { range.offset,
+                                          range.offset + range.range }) {
+                        if (cut > p_begin and cut < p_end) {
+                            cuts[cut_count++] = cut;
+                        }
+                    }
+                }
+                std::sort(cuts.begin(), cuts.begin() + cut_count);
+
+                const auto* bytes = reinterpret_cast<const uint8_t*>(&m_data);
+                for (uint32_t i = 0; i + 1 < cut_count; i++) {
+                    const uint32_t begin = cuts[i];
+                    const uint32_t end = cuts[i + 1];
+                    if (begin == end) {
+                        continue;
+                    }
+
+                    VkShaderStageFlags stages = 0;
+                    for (const push_constant_range& range : p_ranges) {
+                        if (range.offset <= begin and
+                            range.offset + range.range >= end) {
+                            stages |= static_cast<VkShaderStageFlags>(
+                              range.stage);
+                        }
+                    }
+                    if (stages == 0) {
+                        continue;
+                    }
+
+                    vkCmdPushConstants(p_current,
+                                       p_layout,
+                                       stages,
+                                       begin,
+                                       end - begin,
+                                       bytes + (begin - offset));
+                }
+            }
+
+        private:
+            T m_data{};
+            T m_pushed{};
+            bool m_valid = false;
+        };
+    };
+};
@@ -0,0 +1,364 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+export module vk:readback;
+
+export import :types;
+export import :utilities;
+export import :buffer;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @param frame_size_bytes is the space for copies recorded in one frame
+         * @param frames_in_flight is the amount of frames results are kept
+         * for before their region is reused
+         * @param memory_mask must be host-visible and host-coherent, ideally
+         * host-cached too since the CPU only reads it
+         */
+        struct readback_ring_params {
+            uint64_t frame_size_bytes = 4 * 1024 * 1024;
+            uint32_t frames_in_flight = 3;
+            uint32_t memory_mask = 0;
+        };
+
+        /**
+         * @brief Handle to bytes copied into a vk::readback_ring, redeemed
+         * with readback_ring::read once the frame has completed
+         */
+        struct readback_ticket {
+            uint64_t frame = 0;
+            uint64_t offset = 0;
+            uint64_t size_bytes = 0;
+
+            [[nodiscard]] bool valid() const { return size_bytes != 0; }
+        };
+
+        /**
+         * @brief Copies buffers and images into a persistently mapped staging
+         * buffer and hands the bytes back a few frames later without stalling
+         *
+         * Each frame in flight owns a region of the buffer and a fence. The
+         * frame's last submit signals fence(), and read() returns the bytes of
+         * a ticket only once that fence has signaled, so screenshots, GPU
+         * picking and compute results are consumed frames_in_flight - 1 frames
+         * later with no vkQueueWaitIdle. begin_frame only blocks when the
+         * region about to be reused is still in flight.
+         *
+         * ```
+         *
+         *  frame N:   copy_buffer -> ticket {N, offset, size} -> submit(fence)
+         *  frame N+2: read(ticket) -> std::span<const std::byte>
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::readback_ring readback(logical_device, {
+         *      .memory_mask = host_visible_coherent_cached,
+         * });
+         *
+         * readback.begin_frame();
+         * vk::readback_ticket picked = readback.copy_buffer(
+         *      current, picking_buffer, cursor_offset, sizeof(uint32_t));
+         * readback.end_frame(current);
+         * // submit current with readback.fence()
+         *
+         * // later frames
+         * std::span<const std::byte> id = readback.read(picked);
+         * if (!id.empty()) { ... }
+         *
+         * ```
+         */
+        class readback_ring {
+        public:
+            readback_ring() = default;
+
+            readback_ring(const VkDevice& p_device,
+                          const readback_ring_params& p_params)
+              : m_device(p_device)
+              , m_frame_size(align(p_params.frame_size_bytes)) {
+                m_regions.resize(std::max(p_params.frames_in_flight, 1u));
+
+                m_buffer = buffer(m_device,
+                                  m_frame_size * m_regions.size(),
+                                  buffer_parameters{
+                                    .memory_mask = p_params.memory_mask,
+                                    .usage = buffer_usage::transfer_dst_bit,
+                                  });
+                m_mapped = m_buffer.map();
+
+                VkFenceCreateInfo fence_ci = {
+                    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                };
+                for (frame_region& region : m_regions) {
+                    vk_check(vkCreateFence(
+                               m_device, &fence_ci, nullptr, &region.fence),
+                             "vkCreateFence");
+                }
+            }
+
+            [[nodiscard]] bool alive() const { return m_buffer; }
+
+            /**
+             * @brief Moves to the next region, waiting for its fence if the
+             * frame that last used it is still in flight
+             */
+            void begin_frame() {
+                m_frame++;
+                frame_region& region = current();
+                wait(region);
+                vk_check(vkResetFences(m_device, 1, &region.fence),
+                         "vkResetFences");
+                region.frame = m_frame;
+                region.head = 0;
+            }
+
+            /**
+             * @brief Records a copy of p_size_bytes of p_source at p_offset
+             *
+             * @return the ticket of the copied bytes, invalid when the frame
+             * region is full
+             */
+            [[nodiscard]] readback_ticket copy_buffer(
+              const VkCommandBuffer& p_command,
+              const VkBuffer& p_source,
+              uint64_t p_offset,
+              uint64_t p_size_bytes) {
+                readback_ticket ticket = allocate(p_size_bytes);
+                if (!ticket.valid()) {
+                    return ticket;
+                }
+
+                VkBufferCopy region = {
+                    .srcOffset = p_offset,
+                    .dstOffset = ticket.offset,
+                    .size = p_size_bytes,
+                };
+                vkCmdCopyBuffer(p_command, p_source, m_buffer, 1, &region);
+                return ticket;
+            }
+
+            /**
+             * @brief Records a copy of p_regions of p_image, which must be in
+             * VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+             *
+             * buffer_image_copy::offset is relative to the start of the
+             * returned bytes. Rows are tightly packed unless row_length is set.
+             *
+             * @param p_format is the format of p_image, used to size the copy
+             */
+            [[nodiscard]] readback_ticket copy_image_to_buffer(
+              const VkCommandBuffer& p_command,
+              const VkImage& p_image,
+              VkFormat p_format,
+              std::span<const buffer_image_copy> p_regions) {
+                const format_block block = texel_block(p_format);
+                uint64_t size_bytes = 0;
+                for (const buffer_image_copy& region : p_regions) {
+                    const uint32_t row_length = (region.row_length != 0)
+                                                  ? region.row_length
+                                                  : region.image_extent.width;
+                    const uint32_t image_height =
+                      (region.image_height != 0) ? region.image_height
+                                                 : region.image_extent.height;
+                    const uint64_t row_bytes =
+                      static_cast<uint64_t>((row_length + block.width - 1) /
+                                            block.width) *
+                      block.bytes;
+                    const uint64_t rows =
+                      (image_height + block.height - 1) / block.height;
+                    size_bytes = std::max(size_bytes,
+                                          region.offset +
+                                            (row_bytes * rows *
+                                             region.image_extent.depth *
+                                             region.layer_count));
+                }
+
+                readback_ticket ticket = allocate(size_bytes);
+                if (!ticket.valid()) {
+                    return ticket;
+                }
+
+                m_image_copies.resize(p_regions.size());
+                for (size_t i = 0; i < p_regions.size(); i++) {
+                    const buffer_image_copy& region = p_regions[i];
+                    m_image_copies[i] = {
+                        .bufferOffset = ticket.offset + region.offset,
+                        .bufferRowLength = region.row_length,
+                        .bufferImageHeight = region.image_height,
+                        .imageSubresource = {
+                            .aspectMask = static_cast<VkImageAspectFlags>(
+                              region.aspect_mask),
+                            .mipLevel = region.mip_level,
+                            .baseArrayLayer = region.base_array_layer,
+                            .layerCount = region.layer_count,
+                        },
+                        .imageOffset = {
+                            static_cast<int32_t>(region.image_offset.width),
+                            static_cast<int32_t>(region.image_offset.height),
+                            static_cast<int32_t>(region.image_offset.depth),
+                        },
+                        .imageExtent = {
+                            region.image_extent.width,
+                            region.image_extent.height,
+                            region.image_extent.depth,
+                        },
+                    };
+                }
+
+                vkCmdCopyImageToBuffer(
+                  p_command,
+                  p_image,
+                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                  m_buffer,
+                  static_cast<uint32_t>(m_image_copies.size()),
+                  m_image_copies.data());
+                return ticket;
+            }
+
+            /**
+             * @brief Makes this frame's copies visible to the host, recorded
+             * after the last copy of the frame
+             */
+            void end_frame(const VkCommandBuffer& p_command) {
+                VkMemoryBarrier to_host = {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                };
+                vkCmdPipelineBarrier(p_command,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_HOST_BIT,
+                                     0,
+                                     1,
+                                     &to_host,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr);
+                current().submitted = true;
+            }
+
+            //! @return the fence the current frame's last submit must signal
+            [[nodiscard]] VkFence fence() const {
+                return m_regions[m_frame % m_regions.size()].fence;
+            }
+
+            //! @return true once the bytes of p_ticket can be read
+            [[nodiscard]] bool ready(const readback_ticket& p_ticket) const {
+                const frame_region& region = region_of(p_ticket);
+                return region.frame == p_ticket.frame and region.submitted and
+                       vkGetFenceStatus(m_device, region.fence) == VK_SUCCESS;
+            }
+
+            /**
+             * @return the copied bytes of p_ticket, or empty while its frame
+             * is in flight or once its region was reused. Never blocks.
+             */
+            [[nodiscard]] std::span<const std::byte> read(
+              const readback_ticket& p_ticket) const {
+                if (!p_ticket.valid() or !ready(p_ticket)) {
+                    return {};
+                }
+                return std::as_bytes(
+                  m_mapped.subspan(p_ticket.offset, p_ticket.size_bytes));
+            }
+
+            //! @return bytes used in the current frame region
+            [[nodiscard]] uint64_t used_bytes() const { return current().head; }
+
+            operator VkBuffer() const { return m_buffer; }
+
+            operator VkBuffer() { return m_buffer; }
+
+            void destruct() {
+                for (frame_region& region : m_regions) {
+                    wait(region);
+                    vkDestroyFence(m_device, region.fence, nullptr);
+                }
+                m_regions.clear();
+                m_mapped = {};
+                m_buffer.destruct();
+            }
+
+        private:
+            struct frame_region {
+                VkFence fence = nullptr;
+                uint64_t frame = 0;
+                uint64_t head = 0;
+                bool submitted = false;
+            };
+
+            // Copy offsets must be a multiple of 4 and of the texel size
+            [[nodiscard]] static uint64_t align(uint64_t p_size) {
+                return (p_size + 15) / 16 * 16;
+            }
+
+            [[nodiscard]] frame_region& current() {
+                return m_regions[m_frame % m_regions.size()];
+            }
+
+            [[nodiscard]] const frame_region& current() const {
+                return m_regions[m_frame % m_regions.size()];
+            }
+
+            [[nodiscard]] const frame_region& region_of(
+              const readback_ticket& p_ticket) const {
+                return m_regions[p_ticket.frame % m_regions.size()];
+            }
+
+            readback_ticket allocate(uint64_t p_size_bytes) {
+                frame_region& region = current();
+                const uint64_t size = align(p_size_bytes);
+                if (region.head + size > m_frame_size) {
+                    return {};
+                }
+
+                const uint64_t region_begin =
+                  (m_frame % m_regions.size()) * m_frame_size;
+                readback_ticket ticket = {
+                    .frame = m_frame,
+                    .offset = region_begin + region.head,
+                    .size_bytes = p_size_bytes,
+                };
+                region.head += size;
+                return ticket;
+            }
+
+            void wait(frame_region& p_region) {
+                if (!p_region.submitted) {
+                    return;
+                }
+                vk_check(vkWaitForFences(m_device,
+                                         1,
+                                         &p_region.fence,
+                                         true,
+                                         std::numeric_limits<uint64_t>::max()),
+                         "vkWaitForFences");
+                p_region.submitted = false;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            buffer m_buffer{};
+            std::span<uint8_t> m_mapped;
+            uint64_t m_frame_size = 0;
+            uint64_t m_frame = 0;
+            std::vector<frame_region> m_regions;
+            std::vector<VkBufferImageCopy> m_image_copies;
+        };
+    };
+};
@@ -5,11 +5,13 @@ module;
 #include <vector>
 #include <bit>
 #include <limits>
+#include <algorithm>
 
 export module vk:sample_image;
 
 export import :types;
 export import :utilities;
+export import :sampler_cache;
 
 export namespace vk {
     inline namespace v6 {
@@ -28,6 +30,21 @@ export namespace vk {
             return (static_cast<uint64_t>(p_old) << 32) |
                    static_cast<uint64_t>(p_new);
         }
+        /**
+         * @return the sampler state described by p_image_params, to look up
+         * a shared sampler with vk::sampler_cache
+         */
+        sampler_params sampler_state(const image_params& p_image_params) {
+            return sampler_params{
+                .range = p_image_params.range,
+                .address_mode_u = p_image_params.address_mode_u,
+                .address_mode_v = p_image_params.addrses_mode_v,
+                .address_mode_w = p_image_params.addrses_mode_w,
+                .mip_lod_bias = p_image_params.mip_lod_bias,
+                .max_anisotropy = p_image_params.max_anisotropy,
+            };
+        }
+
         class sample_image {
         public:
             sample_image() = default;
@@ -124,7 +141,7 @@ export namespace vk {
                     .subresourceRange = {
                         .aspectMask = static_cast<VkImageAspectFlags>(p_image_params.aspect),
                         .baseMipLevel = 0,
-                        .levelCount = 1,
+                        .levelCount = p_image_params.mip_levels,
                         .baseArrayLayer = 0,
                         .layerCount = p_image_params.layer_count,
                     },
@@ -134,34 +151,7 @@ export namespace vk {
                            m_device, &image_view_ci, nullptr, &m_image_view),
                          "vkCreateImage");
 
-                // Create VkSampler handler
-                VkSamplerCreateInfo sampler_info = {
-                    .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-                    .pNext = nullptr,
-                    .flags = 0,
-                    .magFilter = p_image_params.range.min,
-                    .minFilter = p_image_params.range.max,
-                    .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-                    .addressModeU = static_cast<VkSamplerAddressMode>(
-                      p_image_params.address_mode_u),
-                    .addressModeV = static_cast<VkSamplerAddressMode>(
-                      p_image_params.addrses_mode_v),
-                    .addressModeW = static_cast<VkSamplerAddressMode>(
-                      p_image_params.addrses_mode_w),
-                    .mipLodBias = 0.0f,
-                    .anisotropyEnable = false,
-                    .maxAnisotropy = 1,
-                    .compareEnable = false,
-                    .compareOp = VK_COMPARE_OP_ALWAYS,
-                    .minLod = 0.0f,
-                    .maxLod = 0.0f,
-                    .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
-                    .unnormalizedCoordinates = false
-                };
-
-                vk_check(
-                  vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler),
-                  "vkCreateSampler");
+                create_sampler(p_image_params);
             }
 
             void construct(const VkImage& p_image,
@@ -194,34 +184,7 @@ export namespace vk {
                            m_device, &image_view_ci, nullptr, &m_image_view),
                          "vkCreateImage");
 
-                // Create VkSampler handler
-                VkSamplerCreateInfo sampler_info = {
-                    .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-                    .pNext = nullptr,
-                    .flags = 0,
-                    .magFilter = p_image_params.range.min,
-                    .minFilter = p_image_params.range.max,
-                    .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-                    .addressModeU = static_cast<VkSamplerAddressMode>(
-                      p_image_params.address_mode_u),
-                    .addressModeV = static_cast<VkSamplerAddressMode>(
-                      p_image_params.addrses_mode_v),
-                    .addressModeW = static_cast<VkSamplerAddressMode>(
-                      p_image_params.addrses_mode_w),
-                    .mipLodBias = 0.0f,
-                    .anisotropyEnable = false,
-                    .maxAnisotropy = 1,
-                    .compareEnable = false,
-                    .compareOp = VK_COMPARE_OP_ALWAYS,
-                    .minLod = 0.0f,
-                    .maxLod = 0.0f,
-                    .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
-                    .unnormalizedCoordinates = false
-                };
-
-                vk_check(
-                  vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler),
-                  "vkCreateSampler");
+                create_sampler(p_image_params);
 
                 m_only_destroy_image_view = true;
             }
@@ -244,6 +207,8 @@ export namespace vk {
              * @param p_old is the source image layout transition from
              * @param p_new is the destination image layout transition to.
              *
+             * The transition is applied to every mip level and array layer of
+             * the image.
              *
              * ```C++
              *
@@ -287,9 +252,9 @@ export namespace vk {
                                             static_cast<VkImageAspectFlags>(
                                               p_aspect_mask),
                                           .baseMipLevel = 0,
-                                          .levelCount = 1,
+                                          .levelCount = VK_REMAINING_MIP_LEVELS,
                                           .baseArrayLayer = 0,
-                                          .layerCount = 1 }
+                                          .layerCount = VK_REMAINING_ARRAY_LAYERS }
                 };
 
                 VkPipelineStageFlags source_stage = VK_PIPELINE_STAGE_NONE;
@@ -523,6 +488,138 @@ export namespace vk {
                                      &image_memory_barrier);
             }
 
+            /**
+             * @brief Generates the mip chain on the GPU by successively
+             * blitting each level into the next with a linear filter
+             *
+             * Requires every level to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+             * with level 0 already written. Once recorded, every level is in
+             * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+             *
+             * The image must be created with image_usage::transfer_src_bit and
+             * its format must support VK_FORMAT_FEATURE_BLIT_SRC_BIT,
+             * VK_FORMAT_FEATURE_BLIT_DST_BIT and
+             * VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT (see
+             * physical_device::linear_blit_supported).
+             *
+             * ```
+             *
+             *  level 0  --blit-->  level 1  --blit-->  ...  level N-1
+             *  DST->SRC            DST->SRC                 DST
+             *  SRC->READ           SRC->READ                DST->READ
+             *
+             * ```
+             *
+             * @param p_command is the command buffer to record the blits to
+             * @param p_extent is the extent of level 0
+             * @param p_mip_levels is the amount of mip levels of the image
+             * @param p_layer_count is the amount of array layers to generate
+             * mips for
+             */
+            void generate_mipmaps(const VkCommandBuffer& p_command,
+                                  const image_extent& p_extent,
+                                  uint32_t p_mip_levels,
+                                  uint32_t p_layer_count = 1) {
+                VkImageMemoryBarrier barrier = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = m_image,
+                    .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                          .baseMipLevel = 0,
+                                          .levelCount = 1,
+                                          .baseArrayLayer = 0,
+                                          .layerCount = p_layer_count },
+                };
+
+                int32_t width = static_cast<int32_t>(p_extent.width);
+                int32_t height = static_cast<int32_t>(p_extent.height);
+
+                for (uint32_t level = 1; level < p_mip_levels; level++) {
+                    // Previous level becomes the blit source
+                    barrier.subresourceRange.baseMipLevel = level - 1;
+                    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    vkCmdPipelineBarrier(p_command,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         0,
+                                         0,
+                                         nullptr,
+                                         0,
+                                         nullptr,
+                                         1,
+                                         &barrier);
+
+                    const int32_t next_width = std::max(width / 2, 1);
+                    const int32_t next_height = std::max(height / 2, 1);
+
+                    VkImageBlit blit = {
+                        .srcSubresource = { .aspectMask =
+                                              VK_IMAGE_ASPECT_COLOR_BIT,
+                                            .mipLevel = level - 1,
+                                            .baseArrayLayer = 0,
+                                            .layerCount = p_layer_count },
+                        .srcOffsets = { { 0, 0, 0 }, { width, height, 1 } },
+                        .dstSubresource = { .aspectMask =
+                                              VK_IMAGE_ASPECT_COLOR_BIT,
+                                            .mipLevel = level,
+                                            .baseArrayLayer = 0,
+                                            .layerCount = p_layer_count },
+                        .dstOffsets = { { 0, 0, 0 },
+                                        { next_width, next_height, 1 } },
+                    };
+
+                    vkCmdBlitImage(p_command,
+                                   m_image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   m_image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   1,
+                                   &blit,
+                                   VK_FILTER_LINEAR);
+
+                    // Previous level is finished and can be sampled
+                    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    vkCmdPipelineBarrier(p_command,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                         0,
+                                         0,
+                                         nullptr,
+                                         0,
+                                         nullptr,
+                                         1,
+                                         &barrier);
+
+                    width = next_width;
+                    height = next_height;
+                }
+
+                // Last level was only ever written to
+                barrier.subresourceRange.baseMipLevel = p_mip_levels - 1;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(p_command,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr,
+                                     1,
+                                     &barrier);
+            }
+
             void destruct() {
                 if (m_image_view != nullptr) {
                     vkDestroyImageView(m_device, m_image_view, nullptr);
@@ -538,7 +635,8 @@ export namespace vk {
                     vkDestroyImage(m_device, m_image, nullptr);
                 }
 
-                if (m_sampler != nullptr) {
+                // Shared samplers are owned by whoever created them
+                if (m_sampler != nullptr and m_owns_sampler) {
                     vkDestroySampler(m_device, m_sampler, nullptr);
                 }
 
@@ -551,8 +649,24 @@ export namespace vk {
 
             operator VkImage() { return m_image; }
 
+        private:
+            //! @brief References p_image_params.sampler when set, otherwise
+            //! creates a sampler owned by this image
+            void create_sampler(const image_params& p_image_params) {
+                if (p_image_params.sampler != nullptr) {
+                    m_sampler = p_image_params.sampler;
+                    m_owns_sampler = false;
+                    return;
+                }
+
+                m_sampler =
+                  vk::create_sampler(m_device, sampler_state(p_image_params));
+                m_owns_sampler = true;
+            }
+
         private:
             bool m_only_destroy_image_view = false;
+            bool m_owns_sampler = false;
             VkDevice m_device = nullptr;
             VkImage m_image = nullptr;
             VkImageView m_image_view = nullptr;
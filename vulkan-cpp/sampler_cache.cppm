@@ -0,0 +1,165 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <mutex>
+#include <bit>
+#include <algorithm>
+#include <functional>
+
+export module vk:sampler_cache;
+
+export import :types;
+export import :utilities;
+
+export namespace vk {
+    inline namespace v6 {
+
+        //! @brief Hashes every field of vk::sampler_params
+        struct sampler_params_hash {
+            size_t operator()(const sampler_params& p_params) const {
+                uint64_t seed = hash_seed;
+                auto combine = [&seed](uint64_t p_value) {
+                    seed = hash_combine(seed, p_value);
+                };
+
+                combine(p_params.range.min);
+                combine(p_params.range.max);
+                combine(p_params.mipmap_mode);
+                combine(p_params.address_mode_u);
+                combine(p_params.address_mode_v);
+                combine(p_params.address_mode_w);
+                combine(std::bit_cast<uint32_t>(p_params.mip_lod_bias));
+                combine(std::bit_cast<uint32_t>(p_params.max_anisotropy));
+                combine(p_params.compare_enable);
+                combine(p_params.compare_op);
+                combine(std::bit_cast<uint32_t>(p_params.min_lod));
+                combine(std::bit_cast<uint32_t>(p_params.max_lod));
+                combine(p_params.border_color);
+                combine(p_params.unnormalized_coordinates);
+                return seed;
+            }
+        };
+
+        //! @brief Creates a VkSampler from p_params that the caller owns
+        VkSampler create_sampler(const VkDevice& p_device,
+                                 const sampler_params& p_params) {
+            VkSamplerCreateInfo sampler_info = {
+                .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .magFilter = p_params.range.max,
+                .minFilter = p_params.range.min,
+                .mipmapMode = p_params.mipmap_mode,
+                .addressModeU =
+                  static_cast<VkSamplerAddressMode>(p_params.address_mode_u),
+                .addressModeV =
+                  static_cast<VkSamplerAddressMode>(p_params.address_mode_v),
+                .addressModeW =
+                  static_cast<VkSamplerAddressMode>(p_params.address_mode_w),
+                .mipLodBias = p_params.mip_lod_bias,
+                .anisotropyEnable = p_params.max_anisotropy > 1.f,
+                .maxAnisotropy = std::max(p_params.max_anisotropy, 1.f),
+                .compareEnable = p_params.compare_enable,
+                .compareOp = p_params.compare_op,
+                .minLod = p_params.min_lod,
+                .maxLod = p_params.max_lod,
+                .borderColor = p_params.border_color,
+                .unnormalizedCoordinates = p_params.unnormalized_coordinates,
+            };
+
+            VkSampler sampler = nullptr;
+            vk_check(vkCreateSampler(p_device, &sampler_info, nullptr, &sampler),
+                     "vkCreateSampler");
+            return sampler;
+        }
+
+        /**
+         * @brief Shares one VkSampler between every image using the same
+         * sampler state
+         *
+         * Devices limit the amount of live samplers
+         * (maxSamplerAllocationCount, as low as 4000), so creating one per
+         * texture does not scale. Samplers are looked up by the full
+         * vk::sampler_params and live until destruct().
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::physical_device physical(...);
+         * vk::sampler_cache samplers(
+         *      logical_device,
+         *      physical.properties().limits.maxSamplerAnisotropy);
+         *
+         * VkSampler trilinear = samplers.get({ .max_anisotropy = 8.f });
+         *
+         * vk::texture albedo(logical_device, ktx, vk::texture_params{
+         *      .memory_mask = device_local,
+         *      .sampler = trilinear,
+         * });
+         *
+         * ```
+         */
+        class sampler_cache {
+        public:
+            sampler_cache() = default;
+
+            /**
+             * @param p_device is the logical device to create samplers with
+             * @param p_max_anisotropy is the largest anisotropy the device
+             * supports. Leave at 1 when the samplerAnisotropy feature is not
+             * enabled, which turns anisotropic filtering off for every sampler.
+             */
+            sampler_cache(const VkDevice& p_device,
+                          float p_max_anisotropy = 1.f)
+              : m_device(p_device)
+              , m_max_anisotropy(std::max(p_max_anisotropy, 1.f)) {}
+
+            sampler_cache(const sampler_cache&) = delete;
+            sampler_cache& operator=(const sampler_cache&) = delete;
+
+            /**
+             * @return the sampler matching p_params, created on first use.
+             * Safe to call from multiple threads.
+             */
+            [[nodiscard]] VkSampler get(sampler_params p_params) {
+                p_params.max_anisotropy =
+                  std::clamp(p_params.max_anisotropy, 1.f, m_max_anisotropy);
+
+                std::scoped_lock lock(m_mutex);
+                auto found = m_samplers.find(p_params);
+                if (found != m_samplers.end()) {
+                    return found->second;
+                }
+
+                VkSampler sampler = create_sampler(m_device, p_params);
+                m_samplers.emplace(p_params, sampler);
+                return sampler;
+            }
+
+            //! @return the amount of unique samplers created
+            [[nodiscard]] size_t size() const {
+                std::scoped_lock lock(m_mutex);
+                return m_samplers.size();
+            }
+
+            //! @brief Destroys every sampler. Images referencing them must no
+            //! longer be in use.
+            void destruct() {
+                std::scoped_lock lock(m_mutex);
+                for (auto& [params, sampler] : m_samplers) {
+                    vkDestroySampler(m_device, sampler, nullptr);
+                }
+                m_samplers.clear();
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            float m_max_anisotropy = 1.f;
+            mutable std::mutex m_mutex;
+            std::unordered_map<sampler_params, VkSampler, sampler_params_hash>
+              m_samplers;
+        };
+    };
+};
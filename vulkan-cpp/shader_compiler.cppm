@@ -0,0 +1,416 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <functional>
+#if VULKAN_CPP_SHADERC
+#include <shaderc/shaderc.hpp>
+#ifndef VULKAN_CPP_SHADERC_VERSION
+#define VULKAN_CPP_SHADERC_VERSION "unknown"
+#endif
+#endif
+
+export module vk:shader_compiler;
+
+export import :types;
+export import :utilities;
+export import :shader_module_cache;
+
+export namespace vk {
+    inline namespace v6 {
+
+        enum class shader_language : uint8_t {
+            glsl,
+            hlsl,
+        };
+
+        //! @brief Preprocessor definition, #define name value
+        struct shader_define {
+            std::string name;
+            std::string value;
+        };
+
+        /**
+         * @param filename is the GLSL or HLSL source file
+         * @param stage is the stage the source is compiled for
+         * @param defines are added before compiling, they are part of the
+         * cache key so every permutation is cached separately
+         * @param entry_point is the function compiled
+         */
+        struct shader_compile_source {
+            std::filesystem::path filename;
+            shader_stage stage = shader_stage::undefined;
+            shader_language language = shader_language::glsl;
+            std::span<const shader_define> defines{};
+            std::string entry_point = "main";
+        };
+
+        /**
+         * @param cache_directory holds compiled SPIR-V, one file per source
+         * hash, defines and options. Caching is disabled when empty.
+         * @param optimize compiles with performance optimizations
+         * @param vulkan_version is the VK_API_VERSION the SPIR-V targets
+         */
+        struct shader_compiler_params {
+            std::filesystem::path cache_directory;
+            bool optimize = true;
+            uint32_t vulkan_version = VK_API_VERSION_1_3;
+        };
+
+        struct shader_compiler_stats {
+            uint64_t cache_hits = 0;
+            uint64_t compiles = 0;
+            double compile_ms = 0.0;
+        };
+
+        /**
+         * @brief Compiles GLSL/HLSL to SPIR-V at runtime with a persistent
+         * on-disk cache
+         *
+         * Compiling requires building with VULKAN_CPP_SHADERC, which links
+         * shaderc from the Vulkan SDK. Without it available() is false and
+         * only sources already in the cache can be loaded, so shipped builds
+         * can carry a warm cache and no compiler.
+         *
+         * Cache entries are named after a hash of the source text, stage,
+         * language, defines, entry point and options, so editing any of them
+         * never reuses a stale binary and permutations of the same source
+         * coexist. The name does not depend on the compiler, so a cache
+         * written by a development build loads in a build without shaderc.
+         * Each entry records the identity of the compiler that wrote it, and
+         * builds with shaderc recompile entries written by another version.
+         * #include is not resolved, sources must be self-contained.
+         *
+         * ```
+         *
+         *  entry: [ magic | identity bytes | identity (padded) | SPIR-V ]
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::shader_compiler compiler({ .cache_directory = ".shader_cache" });
+         *
+         * std::array<vk::shader_define, 1> defines = {
+         *      vk::shader_define{ "USE_SHADOWS", "1" },
+         * };
+         * std::expected<std::vector<uint32_t>, std::string> spirv =
+         *      compiler.compile({
+         *          .filename = "shaders/lit.frag",
+         *          .stage = vk::shader_stage::fragment,
+         *          .defines = defines,
+         *      });
+         * if (!spirv) {
+         *      std::println("{}", spirv.error());
+         * }
+         * vk::shader_handle lit =
+         *      modules.get(*spirv, vk::shader_stage::fragment);
+         *
+         * ```
+         */
+        class shader_compiler {
+        public:
+            shader_compiler() = default;
+
+            shader_compiler(const shader_compiler_params& p_params)
+              : m_params(p_params) {
+                if (!m_params.cache_directory.empty()) {
+                    std::error_code error;
+                    std::filesystem::create_directories(
+                      m_params.cache_directory, error);
+                }
+            }
+
+            shader_compiler(const shader_compiler&) = delete;
+            shader_compiler& operator=(const shader_compiler&) = delete;
+
+            //! @return true if built with shaderc and sources can be compiled
+            [[nodiscard]] static constexpr bool available() {
+#if VULKAN_CPP_SHADERC
+                return true;
+#else
+                return false;
+#endif
+            }
+
+            /**
+             * @return the compiler recorded in cache entries, the shaderc
+             * (Vulkan SDK) version linked, empty without shaderc
+             */
+            [[nodiscard]] static std::string_view compiler_identity() {
+#if VULKAN_CPP_SHADERC
+                return "shaderc " VULKAN_CPP_SHADERC_VERSION;
+#else
+                return {};
+#endif
+            }
+
+            /**
+             * @brief Loads p_source from the cache, compiling and caching it
+             * on a miss. Safe to call from multiple threads.
+             *
+             * @return the SPIR-V words, or why the source could not be read
+             * or compiled
+             */
+            [[nodiscard]] std::expected<std::vector<uint32_t>, std::string>
+            compile(const shader_compile_source& p_source) {
+                std::ifstream ins(p_source.filename, std::ios::binary);
+                if (!ins) {
+                    return std::unexpected(
+                      std::format("shader_compiler: cannot open {}",
+                                  p_source.filename.string()));
+                }
+                std::stringstream text;
+                text << ins.rdbuf();
+                const std::string source = text.str();
+
+                const std::filesystem::path cached =
+                  cache_path(p_source, source);
+                if (!cached.empty()) {
+                    std::vector<uint32_t> spirv = read_cache(cached);
+                    if (!spirv.empty()) {
+                        std::scoped_lock lock(m_mutex);
+                        m_stats.cache_hits++;
+                        return spirv;
+                    }
+                }
+
+                const auto start = std::chrono::steady_clock::now();
+                std::expected<std::vector<uint32_t>, std::string> spirv =
+                  compile_source(p_source, source);
+                const double elapsed_ms =
+                  std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+                if (!spirv) {
+                    return spirv;
+                }
+                {
+                    std::scoped_lock lock(m_mutex);
+                    m_stats.compiles++;
+                    m_stats.compile_ms += elapsed_ms;
+                }
+
+                if (!cached.empty()) {
+                    write_cache(cached, *spirv);
+                }
+                return spirv;
+            }
+
+            [[nodiscard]] shader_compiler_stats stats() const {
+                std::scoped_lock lock(m_mutex);
+                return m_stats;
+            }
+
+        private:
+            [[nodiscard]] std::filesystem::path cache_path(
+              const shader_compile_source& p_source,
+              std::string_view p_text) const {
+                if (m_params.cache_directory.empty()) {
+                    return {};
+                }
+
+                uint64_t key = hash_seed;
+                auto combine = [&key](std::string_view p_bytes) {
+                    // length first so "ab"+"c" and "a"+"bc" differ
+                    key = hash_combine(key, p_bytes.size());
+                    key = hash_bytes(std::as_bytes(std::span(p_bytes)), key);
+                };
+
+                combine(p_text);
+                combine(std::to_string(static_cast<uint32_t>(p_source.stage)));
+                combine(
+                  std::to_string(static_cast<uint32_t>(p_source.language)));
+                for (const shader_define& define : p_source.defines) {
+                    combine(define.name);
+                    combine(define.value);
+                }
+                combine(p_source.entry_point);
+                combine(m_params.optimize ? "O" : "O0");
+                combine(std::to_string(m_params.vulkan_version));
+
+                return m_params.cache_directory /
+                       std::format("{:016x}.spvcache", key);
+            }
+
+            /**
+             * @return the SPIR-V of the entry at p_path, empty if it is
+             * missing, malformed or written by a different compiler than the
+             * one linked
+             */
+            [[nodiscard]] static std::vector<uint32_t> read_cache(
+              const std::filesystem::path& p_path) {
+                std::ifstream ins(p_path, std::ios::ate | std::ios::binary);
+                if (!ins) {
+                    return {};
+                }
+                const size_t size = static_cast<size_t>(ins.tellg());
+                if (size < 2 * sizeof(uint32_t) or
+                    size % sizeof(uint32_t) != 0) {
+                    return {};
+                }
+                std::vector<uint32_t> words(size / sizeof(uint32_t));
+                ins.seekg(0);
+                ins.read(reinterpret_cast<char*>(words.data()),
+                         static_cast<std::streamsize>(size));
+                if (!ins or words[0] != cache_magic) {
+                    return {};
+                }
+
+                const size_t identity_bytes = words[1];
+                const size_t identity_words =
+                  (identity_bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+                if (2 + identity_words > words.size()) {
+                    return {};
+                }
+
+                // Without a compiler any entry is usable, there is nothing
+                // to rebuild it with
+                if (available()) {
+                    const std::string_view identity(
+                      reinterpret_cast<const char*>(words.data() + 2),
+                      identity_bytes);
+                    if (identity != compiler_identity()) {
+                        return {};
+                    }
+                }
+
+                words.erase(words.begin(),
+                            words.begin() +
+                              static_cast<std::ptrdiff_t>(2 + identity_words));
+                if (!validate_spirv(std::as_bytes(std::span(words)))) {
+                    return {};
+                }
+                return words;
+            }
+
+            //! @brief Writes to a temporary file then renames it, so readers
+            //! never see a partial binary
+            static void write_cache(const std::filesystem::path& p_path,
+                                    std::span<const uint32_t> p_spirv) {
+                std::filesystem::path temporary = p_path;
+                temporary += std::format(
+                  ".{}.tmp",
+                  std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+                const std::string_view identity = compiler_identity();
+                std::vector<uint32_t> header(
+                  2 + (identity.size() + sizeof(uint32_t) - 1) /
+                        sizeof(uint32_t));
+                header[0] = cache_magic;
+                header[1] = static_cast<uint32_t>(identity.size());
+                std::memcpy(
+                  header.data() + 2, identity.data(), identity.size());
+                {
+                    std::ofstream outs(temporary, std::ios::binary);
+                    outs.write(
+                      reinterpret_cast<const char*>(header.data()),
+                      static_cast<std::streamsize>(header.size() *
+                                                   sizeof(uint32_t)));
+                    outs.write(
+                      reinterpret_cast<const char*>(p_spirv.data()),
+                      static_cast<std::streamsize>(p_spirv.size_bytes()));
+                    if (!outs) {
+                        return;
+                    }
+                }
+                std::error_code error;
+                std::filesystem::rename(temporary, p_path, error);
+                if (error) {
+                    std::filesystem::remove(temporary, error);
+                }
+            }
+
+            [[nodiscard]] std::expected<std::vector<uint32_t>, std::string>
+            compile_source(const shader_compile_source& p_source,
+                           const std::string& p_text) const {
+#if VULKAN_CPP_SHADERC
+                shaderc::CompileOptions options;
+                for (const shader_define& define : p_source.defines) {
+                    options.AddMacroDefinition(define.name, define.value);
+                }
+                options.SetSourceLanguage(
+                  (p_source.language == shader_language::hlsl)
+                    ? shaderc_source_language_hlsl
+                    : shaderc_source_language_glsl);
+                options.SetTargetEnvironment(shaderc_target_env_vulkan,
+                                             m_params.vulkan_version);
+                options.SetOptimizationLevel(
+                  m_params.optimize ? shaderc_optimization_level_performance
+                                    : shaderc_optimization_level_zero);
+
+                shaderc::Compiler compiler;
+                shaderc::SpvCompilationResult result =
+                  compiler.CompileGlslToSpv(p_text,
+                                            shader_kind(p_source.stage),
+                                            p_source.filename.string().c_str(),
+                                            p_source.entry_point.c_str(),
+                                            options);
+                if (result.GetCompilationStatus() !=
+                    shaderc_compilation_status_success) {
+                    return std::unexpected(std::format(
+                      "shader_compiler: {}", result.GetErrorMessage()));
+                }
+                return std::vector<uint32_t>(result.cbegin(), result.cend());
+#else
+                return std::unexpected(
+                  std::format("shader_compiler: {} is not cached and "
+                              "vulkan-cpp was built without shaderc",
+                              p_source.filename.string()));
+#endif
+            }
+
+#if VULKAN_CPP_SHADERC
+            [[nodiscard]] static shaderc_shader_kind shader_kind(
+              shader_stage p_stage) {
+                switch (static_cast<uint32_t>(p_stage)) {
+                    case VK_SHADER_STAGE_VERTEX_BIT:
+                        return shaderc_vertex_shader;
+                    case VK_SHADER_STAGE_FRAGMENT_BIT:
+                        return shaderc_fragment_shader;
+                    case VK_SHADER_STAGE_COMPUTE_BIT:
+                        return shaderc_compute_shader;
+                    case VK_SHADER_STAGE_GEOMETRY_BIT:
+                        return shaderc_geometry_shader;
+                    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+                        return shaderc_tess_control_shader;
+                    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+                        return shaderc_tess_evaluation_shader;
+                    case VK_SHADER_STAGE_TASK_BIT_EXT:
+                        return shaderc_task_shader;
+                    case VK_SHADER_STAGE_MESH_BIT_EXT:
+                        return shaderc_mesh_shader;
+                    default:
+                        // #pragma shader_stage(...) in the source decides
+                        return shaderc_glsl_infer_from_source;
+                }
+            }
+#endif
+
+        private:
+            //! @brief First word of a cache entry, "vkcc" in little endian
+            static constexpr uint32_t cache_magic = 0x63636b76;
+
+            shader_compiler_params m_params{};
+            mutable std::mutex m_mutex;
+            shader_compiler_stats m_stats{};
+        };
+    };
+};
@@ -0,0 +1,482 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <optional>
+#include <expected>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#if __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+export module vk:shader_hot_reload;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+export import :shader_module_cache;
+export import :shader_compiler;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @param compiler compiles sources that are not .spv files. Without
+         * it every watched shader_source must name a SPIR-V binary, rebuilt
+         * by an external tool such as glslc.
+         * @param debounce is how long the watcher waits after the last change
+         * before rebuilding, so an editor saving in several writes rebuilds
+         * once
+         */
+        struct hot_reload_params {
+            shader_compiler* compiler = nullptr;
+            std::chrono::milliseconds debounce{ 100 };
+        };
+
+        /**
+         * @brief Creates a pipeline from the shader modules of its sources,
+         * in the same order as the watched sources. Called on the watcher
+         * thread for every rebuild, so it must only capture state that
+         * outlives the shader_hot_reload.
+         */
+        using pipeline_builder =
+          std::function<pipeline(std::span<const shader_handle>)>;
+
+        /**
+         * @brief Watches shader sources and rebuilds the pipelines using them
+         * on a background thread when they change
+         *
+         * Changes are detected with inotify on Linux and by polling the file
+         * write times elsewhere. A rebuilt pipeline stays pending until
+         * apply() is called at a frame boundary, which swaps it in and
+         * retires the previous one, so command buffers in flight keep using
+         * the pipeline they were recorded with and the device is never idled.
+         * Retired pipelines are destroyed by collect() once the frame that
+         * retired them has completed. A source that fails to load or compile
+         * keeps the current pipeline, and last_error() tells why.
+         *
+         * ```
+         *
+         *  edit lit.frag --> watcher: compile, build --> pending
+         *  frame N:   apply(N)   --> current = pending, retired {old, N}
+         *  frame N+2: collect(N) --> old destroyed
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::shader_hot_reload reload(logical_device, {
+         *      .compiler = &compiler,
+         * });
+         *
+         * std::array<vk::shader_source, 2> sources = {
+         *      vk::shader_source{ "lit.vert", vk::shader_stage::vertex },
+         *      vk::shader_source{ "lit.frag", vk::shader_stage::fragment },
+         * };
+         * uint32_t lit = reload.watch(sources, [&](auto p_modules) {
+         *      vk::pipeline_params params = lit_params;
+         *      params.shader_modules = p_modules;
+         *      return vk::pipeline(logical_device, params);
+         * });
+         *
+         * // every frame, before recording
+         * reload.apply(frame);
+         * reload.collect(completed_frame);
+         * reload.get(lit).bind(current);
+         *
+         * ```
+         */
+        class shader_hot_reload {
+        public:
+            shader_hot_reload() = default;
+
+            shader_hot_reload(const VkDevice& p_device,
+                              const hot_reload_params& p_params)
+              : m_device(p_device)
+              , m_params(p_params) {
+#if __linux__
+                m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                if (m_inotify < 0) {
+                    m_last_error = "shader_hot_reload: inotify_init1 failed";
+                    return;
+                }
+#endif
+                m_watcher = std::jthread(
+                  [this](std::stop_token p_stop) { watcher(p_stop); });
+            }
+
+            shader_hot_reload(const shader_hot_reload&) = delete;
+            shader_hot_reload& operator=(const shader_hot_reload&) = delete;
+
+            //! @brief Only stops watching. Pipelines are destroyed by
+            //! destruct(), while the device is still alive.
+            ~shader_hot_reload() { stop_watching(); }
+
+            /**
+             * @brief Builds the pipeline of p_sources with p_builder and
+             * rebuilds it whenever one of the sources changes
+             *
+             * @return the id of the pipeline passed to get()
+             */
+            uint32_t watch(std::span<const shader_source> p_sources,
+                           pipeline_builder p_builder) {
+                watched_pipeline watched = {
+                    .sources = { p_sources.begin(), p_sources.end() },
+                    .builder = std::move(p_builder),
+                };
+                for (const shader_source& source : p_sources) {
+                    watched.paths.push_back(normalize(source.filename));
+                }
+
+                if (auto built = build(watched.sources, watched.builder)) {
+                    watched.current = *built;
+                }
+
+                std::scoped_lock lock(m_mutex);
+                for (const std::filesystem::path& path : watched.paths) {
+                    add_watch(path);
+                }
+                m_pipelines.push_back(std::move(watched));
+                return static_cast<uint32_t>(m_pipelines.size() - 1);
+            }
+
+            //! @return the current pipeline of p_id, valid until the next
+            //! apply()
+            [[nodiscard]] pipeline& get(uint32_t p_id) {
+                return m_pipelines[p_id].current;
+            }
+
+            /**
+             * @brief Swaps every rebuilt pipeline in, called at a frame
+             * boundary before recording p_frame
+             *
+             * @return the amount of pipelines swapped
+             */
+            uint32_t apply(uint64_t p_frame) {
+                std::scoped_lock lock(m_mutex);
+                uint32_t swapped = 0;
+                for (watched_pipeline& watched : m_pipelines) {
+                    if (!watched.pending.alive()) {
+                        continue;
+                    }
+                    m_retired.push_back({ watched.current, p_frame });
+                    watched.current = watched.pending;
+                    watched.pending = pipeline{};
+                    swapped++;
+                }
+                m_reloads += swapped;
+                return swapped;
+            }
+
+            /**
+             * @brief Destroys pipelines retired at or before p_completed_frame
+             *
+             * @param p_completed_frame is the newest frame whose fence has
+             * signaled
+             */
+            void collect(uint64_t p_completed_frame) {
+                std::scoped_lock lock(m_mutex);
+                std::erase_if(m_retired,
+                              [p_completed_frame](retired_pipeline& p_retired) {
+                                  if (p_retired.frame > p_completed_frame) {
+                                      return false;
+                                  }
+                                  p_retired.handle.destruct();
+                                  return true;
+                              });
+            }
+
+            //! @return the amount of pipelines swapped in since creation
+            [[nodiscard]] uint64_t reloads() const {
+                std::scoped_lock lock(m_mutex);
+                return m_reloads;
+            }
+
+            //! @return why the last source failed to load or compile, or a
+            //! file could not be watched. Empty if nothing failed.
+            [[nodiscard]] std::string last_error() const {
+                std::scoped_lock lock(m_mutex);
+                return m_last_error;
+            }
+
+            //! @brief Stops watching and destroys every pipeline. The device
+            //! must be idle.
+            void destruct() {
+                if (m_device == nullptr) {
+                    return;
+                }
+
+                stop_watching();
+
+                for (watched_pipeline& watched : m_pipelines) {
+                    watched.current.destruct();
+                    watched.pending.destruct();
+                }
+                for (retired_pipeline& retired : m_retired) {
+                    retired.handle.destruct();
+                }
+                m_pipelines.clear();
+                m_retired.clear();
+                m_device = nullptr;
+            }
+
+        private:
+            void stop_watching() {
+                if (m_watcher.joinable()) {
+                    m_watcher.request_stop();
+                    m_watcher.join();
+                }
+#if __linux__
+                if (m_inotify >= 0) {
+                    close(m_inotify);
+                    m_inotify = -1;
+                }
+#endif
+            }
+
+            struct watched_pipeline {
+                std::vector<shader_source> sources;
+                pipeline_builder builder;
+                std::vector<std::filesystem::path> paths;
+                pipeline current{};
+                pipeline pending{};
+            };
+
+            struct retired_pipeline {
+                pipeline handle{};
+                uint64_t frame = 0;
+            };
+
+            [[nodiscard]] static std::filesystem::path normalize(
+              const std::filesystem::path& p_path) {
+                return std::filesystem::absolute(p_path).lexically_normal();
+            }
+
+            //! @brief Watches the directory of p_path, since editors often
+            //! save by replacing the file rather than writing to it
+            void add_watch(const std::filesystem::path& p_path) {
+#if __linux__
+                if (m_inotify < 0) {
+                    return;
+                }
+                const std::filesystem::path directory = p_path.parent_path();
+                const int descriptor =
+                  inotify_add_watch(m_inotify,
+                                    directory.c_str(),
+                                    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                if (descriptor < 0) {
+                    m_last_error = "shader_hot_reload: cannot watch " +
+                                   directory.string();
+                    return;
+                }
+                m_directories[descriptor] = directory;
+#else
+                std::error_code error;
+                m_write_times[p_path.string()] =
+                  std::filesystem::last_write_time(p_path, error);
+#endif
+            }
+
+            void watcher(std::stop_token p_stop) {
+                std::vector<std::filesystem::path> changed;
+                while (!p_stop.stop_requested()) {
+                    // Rebuild once the changes settle for the debounce time
+                    if (!wait_for_changes(changed) and !changed.empty()) {
+                        rebuild(changed);
+                        changed.clear();
+                    }
+                }
+            }
+
+            //! @return true if files changed within the debounce time,
+            //! appended to p_changed
+            bool wait_for_changes(
+              std::vector<std::filesystem::path>& p_changed) {
+                const size_t previous = p_changed.size();
+#if __linux__
+                pollfd descriptor = { .fd = m_inotify, .events = POLLIN };
+                if (poll(&descriptor,
+                         1,
+                         static_cast<int>(m_params.debounce.count())) <= 0) {
+                    return false;
+                }
+
+                alignas(inotify_event) char events[4096];
+                ssize_t length = 0;
+                while ((length = read(m_inotify, events, sizeof(events))) > 0) {
+                    std::scoped_lock lock(m_mutex);
+                    for (ssize_t offset = 0; offset < length;) {
+                        const auto* event =
+                          reinterpret_cast<const inotify_event*>(events +
+                                                                 offset);
+                        auto directory = m_directories.find(event->wd);
+                        if (event->len > 0 and
+                            directory != m_directories.end()) {
+                            p_changed.push_back(directory->second /
+                                                event->name);
+                        }
+                        offset += sizeof(inotify_event) + event->len;
+                    }
+                }
+#else
+                std::this_thread::sleep_for(m_params.debounce);
+                std::scoped_lock lock(m_mutex);
+                for (auto& [path, write_time] : m_write_times) {
+                    std::error_code error;
+                    const auto latest =
+                      std::filesystem::last_write_time(path, error);
+                    if (!error and latest != write_time) {
+                        write_time = latest;
+                        p_changed.push_back(path);
+                    }
+                }
+#endif
+                return p_changed.size() != previous;
+            }
+
+            void rebuild(std::span<const std::filesystem::path> p_changed) {
+                struct rebuild_request {
+                    size_t index = 0;
+                    std::vector<shader_source> sources;
+                    pipeline_builder builder;
+                };
+
+                std::vector<rebuild_request> requests;
+                {
+                    std::scoped_lock lock(m_mutex);
+                    for (size_t i = 0; i < m_pipelines.size(); i++) {
+                        const watched_pipeline& watched = m_pipelines[i];
+                        const bool affected = std::ranges::any_of(
+                          watched.paths, [p_changed](const auto& p_path) {
+                              return std::ranges::find(p_changed, p_path) !=
+                                     p_changed.end();
+                          });
+                        if (affected) {
+                            requests.push_back(
+                              { i, watched.sources, watched.builder });
+                        }
+                    }
+                }
+
+                for (rebuild_request& request : requests) {
+                    auto built = build(request.sources, request.builder);
+                    if (!built) {
+                        continue;
+                    }
+
+                    std::scoped_lock lock(m_mutex);
+                    // A pending pipeline that was never applied is unused
+                    pipeline& pending = m_pipelines[request.index].pending;
+                    pending.destruct();
+                    pending = *built;
+                }
+            }
+
+            //! @return the pipeline of p_sources, or nothing if a source
+            //! failed to load or the pipeline was not created
+            [[nodiscard]] std::optional<pipeline> build(
+              std::span<const shader_source> p_sources,
+              const pipeline_builder& p_builder) {
+                std::vector<shader_handle> handles(p_sources.size());
+                bool loaded = true;
+
+                for (size_t i = 0; i < p_sources.size() and loaded; i++) {
+                    const std::expected<std::vector<uint32_t>, std::string>
+                      spirv = load(p_sources[i]);
+                    if (!spirv) {
+                        std::scoped_lock lock(m_mutex);
+                        m_last_error = spirv.error();
+                        loaded = false;
+                        break;
+                    }
+
+                    VkShaderModuleCreateInfo shader_module_ci = {
+                        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                        .pNext = nullptr,
+                        .codeSize = spirv->size() * sizeof(uint32_t),
+                        .pCode = spirv->data(),
+                    };
+                    vk_check(vkCreateShaderModule(m_device,
+                                                  &shader_module_ci,
+                                                  nullptr,
+                                                  &handles[i].module),
+                             "vkCreateShaderModule");
+                    handles[i].stage = p_sources[i].stage;
+                }
+
+                std::optional<pipeline> built;
+                if (loaded) {
+                    pipeline created = p_builder(handles);
+                    if (created.alive()) {
+                        built = created;
+                    }
+                    else {
+                        created.destruct();
+                    }
+                }
+
+                // Pipelines keep no reference to the modules they were
+                // created from
+                for (shader_handle& handle : handles) {
+                    if (handle.module != nullptr) {
+                        vkDestroyShaderModule(m_device, handle.module, nullptr);
+                    }
+                }
+                return built;
+            }
+
+            [[nodiscard]] std::expected<std::vector<uint32_t>, std::string>
+            load(const shader_source& p_source) const {
+                const std::filesystem::path path = p_source.filename;
+                if (m_params.compiler != nullptr and
+                    path.extension() != ".spv") {
+                    return m_params.compiler->compile({
+                      .filename = path,
+                      .stage = p_source.stage,
+                    });
+                }
+
+                spirv_file binary(path);
+                if (!binary.valid()) {
+                    return std::unexpected("shader_hot_reload: cannot load " +
+                                           path.string());
+                }
+                return std::vector<uint32_t>(binary.words().begin(),
+                                             binary.words().end());
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            hot_reload_params m_params{};
+            mutable std::mutex m_mutex;
+            // Deque keeps the pipelines returned by get() at stable addresses
+            std::deque<watched_pipeline> m_pipelines;
+            std::vector<retired_pipeline> m_retired;
+            uint64_t m_reloads = 0;
+            std::string m_last_error;
+#if __linux__
+            int m_inotify = -1;
+            std::unordered_map<int, std::filesystem::path> m_directories;
+#else
+            std::unordered_map<std::string,
+                               std::filesystem::file_time_type>
+              m_write_times;
+#endif
+            std::jthread m_watcher;
+        };
+    };
+};
@@ -0,0 +1,317 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <filesystem>
+#if _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module vk:shader_module_cache;
+
+export import :types;
+export import :utilities;
+export import :shader_reflection;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @return true if p_bytes can be read as SPIR-V words: 4-byte aligned,
+         * a multiple of 4 bytes, at least a header long and starting with the
+         * SPIR-V magic number
+         */
+        [[nodiscard]] bool validate_spirv(std::span<const std::byte> p_bytes) {
+            constexpr size_t header_bytes = 5 * sizeof(uint32_t);
+
+            if (reinterpret_cast<uintptr_t>(p_bytes.data()) %
+                  alignof(uint32_t) !=
+                0) {
+                return false;
+            }
+            if (p_bytes.size() < header_bytes or
+                p_bytes.size() % sizeof(uint32_t) != 0) {
+                return false;
+            }
+            return *reinterpret_cast<const uint32_t*>(p_bytes.data()) ==
+                   spirv_magic;
+        }
+
+        /**
+         * @brief Content hash of SPIR-V words and their count, identifying a
+         * shader independently of the module created from it
+         */
+        [[nodiscard]] uint64_t spirv_hash(std::span<const uint32_t> p_spirv) {
+            return hash_combine(hash_bytes(std::as_bytes(p_spirv)),
+                                p_spirv.size());
+        }
+
+        /**
+         * @brief Read-only mapping of a .spv file
+         *
+         * The file is memory mapped rather than streamed into a buffer, so
+         * loading costs no copy and the words are page aligned. Falls back to
+         * a single read into 32-bit storage where mmap is unavailable.
+         */
+        class spirv_file {
+        public:
+            spirv_file() = default;
+
+            spirv_file(const std::filesystem::path& p_path) { open(p_path); }
+
+            spirv_file(const spirv_file&) = delete;
+            spirv_file& operator=(const spirv_file&) = delete;
+
+            spirv_file(spirv_file&& p_other) noexcept
+              : m_words(p_other.m_words)
+              , m_mapped(p_other.m_mapped)
+              , m_mapped_size(p_other.m_mapped_size)
+              , m_storage(std::move(p_other.m_storage)) {
+                p_other.m_words = {};
+                p_other.m_mapped = nullptr;
+                p_other.m_mapped_size = 0;
+            }
+
+            spirv_file& operator=(spirv_file&& p_other) noexcept {
+                if (this != &p_other) {
+                    destruct();
+                    m_words = p_other.m_words;
+                    m_mapped = p_other.m_mapped;
+                    m_mapped_size = p_other.m_mapped_size;
+                    m_storage = std::move(p_other.m_storage);
+                    p_other.m_words = {};
+                    p_other.m_mapped = nullptr;
+                    p_other.m_mapped_size = 0;
+                }
+                return *this;
+            }
+
+            ~spirv_file() { destruct(); }
+
+            //! @return false if the file is missing or not valid SPIR-V
+            [[nodiscard]] bool valid() const { return !m_words.empty(); }
+
+            //! @return the SPIR-V words of the file
+            [[nodiscard]] std::span<const uint32_t> words() const {
+                return m_words;
+            }
+
+            void destruct() {
+#if !_WIN32
+                if (m_mapped != nullptr) {
+                    munmap(m_mapped, m_mapped_size);
+                }
+#endif
+                m_mapped = nullptr;
+                m_mapped_size = 0;
+                m_words = {};
+                m_storage.clear();
+            }
+
+        private:
+            void open(const std::filesystem::path& p_path) {
+                std::span<const std::byte> bytes;
+#if _WIN32
+                std::ifstream ins(p_path, std::ios::ate | std::ios::binary);
+                if (!ins) {
+                    return;
+                }
+                const size_t size = static_cast<size_t>(ins.tellg());
+                m_storage.resize((size + 3) / sizeof(uint32_t));
+                ins.seekg(0);
+                ins.read(reinterpret_cast<char*>(m_storage.data()), size);
+                bytes = std::as_bytes(std::span(m_storage)).first(size);
+#else
+                const int descriptor = ::open(p_path.c_str(), O_RDONLY);
+                if (descriptor < 0) {
+                    return;
+                }
+
+                struct stat file_info{};
+                if (fstat(descriptor, &file_info) == 0 and
+                    file_info.st_size > 0) {
+                    m_mapped_size = static_cast<size_t>(file_info.st_size);
+                    void* mapped = mmap(nullptr,
+                                        m_mapped_size,
+                                        PROT_READ,
+                                        MAP_PRIVATE,
+                                        descriptor,
+                                        0);
+                    m_mapped = (mapped == MAP_FAILED) ? nullptr : mapped;
+                }
+                close(descriptor);
+
+                if (m_mapped == nullptr) {
+                    m_mapped_size = 0;
+                    return;
+                }
+                bytes = std::span<const std::byte>(
+                  static_cast<const std::byte*>(m_mapped), m_mapped_size);
+#endif
+
+                if (!validate_spirv(bytes)) {
+                    destruct();
+                    return;
+                }
+                m_words = std::span<const uint32_t>(
+                  reinterpret_cast<const uint32_t*>(bytes.data()),
+                  bytes.size() / sizeof(uint32_t));
+            }
+
+        private:
+            std::span<const uint32_t> m_words;
+            void* m_mapped = nullptr;
+            size_t m_mapped_size = 0;
+            std::vector<uint32_t> m_storage;
+        };
+
+        /**
+         * @brief Creates one shader module per unique SPIR-V binary, shared by
+         * every pipeline loading it
+         *
+         * Binaries are keyed by a hash of their contents and compared word
+         * for word on a match, so the same vertex shader loaded by many
+         * shader_resources (or from different paths) is created once.
+         * Modules live until destruct().
+         *
+         * Handles carry the cached words in code alongside the module. With
+         * p_inline_modules, no VkShaderModule is created at all: the cache
+         * hands out shader_handles with a null module, whose code the
+         * pipelines pass through VkShaderModuleCreateInfo in the stage
+         * pNext. This requires the maintenance5 feature (VK_KHR_maintenance5
+         * or Vulkan 1.4).
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::shader_module_cache modules(logical_device);
+         *
+         * std::array<vk::shader_source, 2> sources = { ... };
+         * vk::shader_resource geometry(logical_device, {
+         *      .sources = sources,
+         *      .module_cache = &modules,
+         * });
+         *
+         * // or directly
+         * vk::shader_handle blur = modules.get("blur.comp.spv",
+         *      vk::shader_stage::compute);
+         *
+         * ```
+         */
+        class shader_module_cache {
+        public:
+            shader_module_cache() = default;
+
+            shader_module_cache(const VkDevice& p_device,
+                                bool p_inline_modules = false)
+              : m_device(p_device)
+              , m_inline_modules(p_inline_modules) {}
+
+            shader_module_cache(const shader_module_cache&) = delete;
+            shader_module_cache& operator=(const shader_module_cache&) = delete;
+
+            /**
+             * @return the module of the SPIR-V file at p_path, loaded on
+             * first use. The handle has a null module if the file is not
+             * valid SPIR-V. Safe to call from multiple threads.
+             */
+            [[nodiscard]] shader_handle get(
+              const std::filesystem::path& p_path,
+              shader_stage p_stage) {
+                spirv_file file(p_path);
+                if (!file.valid()) {
+                    return shader_handle{ .stage = p_stage };
+                }
+                return get(file.words(), p_stage);
+            }
+
+            //! @return the module of p_spirv, created on first use
+            [[nodiscard]] shader_handle get(std::span<const uint32_t> p_spirv,
+                                            shader_stage p_stage) {
+                const uint64_t key = spirv_hash(p_spirv);
+
+                std::scoped_lock lock(m_mutex);
+                // The hash only narrows the search, binaries colliding on it
+                // are told apart by their words
+                auto [first, last] = m_modules.equal_range(key);
+                auto found = std::find_if(
+                  first, last, [p_spirv](const auto& p_cached) {
+                      return std::ranges::equal(p_cached.second.code, p_spirv);
+                  });
+                if (found == last) {
+                    found = m_modules.emplace(key, create(p_spirv));
+                }
+
+                return shader_handle{
+                    .module = found->second.module,
+                    .stage = p_stage,
+                    .code = found->second.code,
+                };
+            }
+
+            //! @return the amount of unique binaries cached
+            [[nodiscard]] size_t size() const {
+                std::scoped_lock lock(m_mutex);
+                return m_modules.size();
+            }
+
+            //! @brief Destroys every module. Pipelines created from them may
+            //! outlive the modules.
+            void destruct() {
+                std::scoped_lock lock(m_mutex);
+                for (auto& [key, cached] : m_modules) {
+                    if (cached.module != nullptr) {
+                        vkDestroyShaderModule(m_device, cached.module, nullptr);
+                    }
+                }
+                m_modules.clear();
+            }
+
+        private:
+            struct cached_module {
+                VkShaderModule module = nullptr;
+                std::vector<uint32_t> code;
+            };
+
+            cached_module create(std::span<const uint32_t> p_spirv) const {
+                // Kept with a module too, so its handles carry their code
+                cached_module cached;
+                cached.code.assign(p_spirv.begin(), p_spirv.end());
+                if (m_inline_modules) {
+                    return cached;
+                }
+
+                VkShaderModuleCreateInfo shader_module_ci = {
+                    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .codeSize = p_spirv.size_bytes(),
+                    .pCode = p_spirv.data(),
+                };
+                vk_check(
+                  vkCreateShaderModule(
+                    m_device, &shader_module_ci, nullptr, &cached.module),
+                  "vkCreateShaderModule");
+                return cached;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            bool m_inline_modules = false;
+            mutable std::mutex m_mutex;
+            std::unordered_multimap<uint64_t, cached_module> m_modules;
+        };
+    };
+};
@@ -0,0 +1,698 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+export module vk:shader_reflection;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+
+export namespace vk {
+    inline namespace v6 {
+
+        //! @brief Magic number every SPIR-V module starts with
+        constexpr uint32_t spirv_magic = 0x07230203;
+
+        //! @brief Descriptor binding reflected from a shader and the set it
+        //! is declared in
+        struct reflected_descriptor {
+            uint32_t set = 0;
+            descriptor_entry entry{};
+        };
+
+        /**
+         * @brief Bindings, push constants and vertex inputs read out of a
+         * SPIR-V module
+         *
+         * Walks the instruction stream once, without any external dependency,
+         * collecting the decorations and types the resource variables of the
+         * module point to. Reflections of every stage of a pipeline are
+         * combined with merge(), after which they describe the
+         * descriptor_layout entries, push constant ranges and vertex
+         * attributes the pipeline needs, so none are written by hand.
+         *
+         * Runtime descriptor arrays (such as bindless sampler2D textures[])
+         * are reflected with a descriptor_count of 0, to be set to the
+         * capacity the layout is created with.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::shader_reflection reflection(vertex_spirv);
+         * reflection.merge(vk::shader_reflection(fragment_spirv));
+         *
+         * std::vector<vk::descriptor_entry> set0 =
+         *      reflection.descriptor_entries(0);
+         * vk::descriptor_layout set0_layout = {
+         *      .slot = 0,
+         *      .max_sets = image_count,
+         *      .entries = set0,
+         * };
+         *
+         * std::array<vk::vertex_attribute, 1> attributes = {
+         *      reflection.vertex_attributes(),
+         * };
+         * geometry_resource.vertex_attributes(attributes);
+         *
+         * vk::pipeline_params pipeline_configuration = {
+         *      // ...
+         *      .push_constants = reflection.push_constants(),
+         * };
+         *
+         * ```
+         */
+        class shader_reflection {
+        public:
+            shader_reflection() = default;
+
+            //! @param p_spirv are the 32-bit words of a SPIR-V module
+            shader_reflection(std::span<const uint32_t> p_spirv) {
+                m_valid = parse(p_spirv);
+            }
+
+            //! @return false when the module could not be parsed, or merged
+            //! stages declare the same binding with different types
+            [[nodiscard]] bool valid() const { return m_valid; }
+
+            //! @return every stage reflected, OR'd together after merge()
+            [[nodiscard]] shader_stage stage() const { return m_stage; }
+
+            //! @return descriptor bindings of every set, sorted by set and
+            //! binding
+            [[nodiscard]] std::span<const reflected_descriptor> descriptors()
+              const {
+                return m_descriptors;
+            }
+
+            //! @return the push constant range of every stage reflected
+            [[nodiscard]] std::span<const push_constant_range> push_constants()
+              const {
+                return m_push_constants;
+            }
+
+            //! @return vertex shader inputs sorted by location, tightly packed
+            //! in one binding
+            [[nodiscard]] std::span<const vertex_attribute_entry>
+            vertex_inputs() const {
+                return m_vertex_inputs;
+            }
+
+            //! @return the size of one vertex holding every vertex input
+            [[nodiscard]] uint32_t vertex_stride() const {
+                return m_vertex_stride;
+            }
+
+            //! @return the set indices declared, in ascending order
+            [[nodiscard]] std::vector<uint32_t> sets() const {
+                std::vector<uint32_t> indices;
+                for (const reflected_descriptor& descriptor : m_descriptors) {
+                    if (indices.empty() or indices.back() != descriptor.set) {
+                        indices.push_back(descriptor.set);
+                    }
+                }
+                return indices;
+            }
+
+            //! @return the entries of p_set, for vk::descriptor_layout
+            [[nodiscard]] std::vector<descriptor_entry> descriptor_entries(
+              uint32_t p_set) const {
+                std::vector<descriptor_entry> entries;
+                for (const reflected_descriptor& descriptor : m_descriptors) {
+                    if (descriptor.set == p_set) {
+                        entries.push_back(descriptor.entry);
+                    }
+                }
+                return entries;
+            }
+
+            /**
+             * @return the vertex inputs as a single interleaved binding, for
+             * shader_resource::vertex_attributes. References this reflection,
+             * which must outlive it.
+             */
+            [[nodiscard]] vertex_attribute vertex_attributes(
+              uint32_t p_binding = 0,
+              input_rate p_input_rate = input_rate::vertex) {
+                return vertex_attribute{
+                    .binding = p_binding,
+                    .entries = m_vertex_inputs,
+                    .stride = m_vertex_stride,
+                    .input_rate = p_input_rate,
+                };
+            }
+
+            /**
+             * @brief Combines the reflection of another stage of the same
+             * pipeline
+             *
+             * Bindings declared by both get both stages, a binding declared
+             * with different types makes the reflection invalid. Vertex inputs
+             * are taken from whichever reflection has them.
+             */
+            void merge(const shader_reflection& p_other) {
+                m_valid = (m_stage == shader_stage::undefined)
+                            ? p_other.m_valid
+                            : m_valid and p_other.m_valid;
+                m_stage = (m_stage == shader_stage::undefined)
+                            ? p_other.m_stage
+                            : combine(m_stage, p_other.m_stage);
+
+                for (const reflected_descriptor& other :
+                     p_other.m_descriptors) {
+                    auto found = std::ranges::find_if(
+                      m_descriptors,
+                      [&other](const reflected_descriptor& p_descriptor) {
+                          return p_descriptor.set == other.set and
+                                 p_descriptor.entry.binding_point.binding ==
+                                   other.entry.binding_point.binding;
+                      });
+                    if (found == m_descriptors.end()) {
+                        m_descriptors.push_back(other);
+                        continue;
+                    }
+                    if (found->entry.type != other.entry.type) {
+                        m_valid = false;
+                    }
+                    found->entry.binding_point.stage =
+                      combine(found->entry.binding_point.stage,
+                              other.entry.binding_point.stage);
+                }
+                sort_descriptors();
+
+                m_push_constants.insert(m_push_constants.end(),
+                                        p_other.m_push_constants.begin(),
+                                        p_other.m_push_constants.end());
+
+                if (m_vertex_inputs.empty()) {
+                    m_vertex_inputs = p_other.m_vertex_inputs;
+                    m_vertex_stride = p_other.m_vertex_stride;
+                }
+            }
+
+        private:
+            // SPIR-V opcodes, decorations and enumerants read by the parser
+            enum op : uint32_t {
+                op_entry_point = 15,
+                op_type_bool = 20,
+                op_type_int = 21,
+                op_type_float = 22,
+                op_type_vector = 23,
+                op_type_matrix = 24,
+                op_type_image = 25,
+                op_type_sampler = 26,
+                op_type_sampled_image = 27,
+                op_type_array = 28,
+                op_type_runtime_array = 29,
+                op_type_struct = 30,
+                op_type_pointer = 32,
+                op_constant = 43,
+                op_variable = 59,
+                op_decorate = 71,
+                op_member_decorate = 72,
+                op_type_acceleration_structure = 5341,
+            };
+
+            enum decoration : uint32_t {
+                decoration_block = 2,
+                decoration_buffer_block = 3,
+                decoration_array_stride = 6,
+                decoration_matrix_stride = 7,
+                decoration_builtin = 11,
+                decoration_location = 30,
+                decoration_binding = 33,
+                decoration_descriptor_set = 34,
+                decoration_offset = 35,
+            };
+
+            enum storage_class : uint32_t {
+                storage_uniform_constant = 0,
+                storage_input = 1,
+                storage_uniform = 2,
+                storage_push_constant = 9,
+                storage_storage_buffer = 12,
+                storage_physical_storage_buffer = 5349,
+            };
+
+            static constexpr uint32_t dim_buffer = 5;
+            static constexpr uint32_t dim_subpass_data = 6;
+            static constexpr uint32_t unset = ~0u;
+
+            struct spirv_id {
+                uint32_t opcode = 0;
+                // operands following the result id
+                std::span<const uint32_t> operands;
+                uint32_t set = unset;
+                uint32_t binding = unset;
+                uint32_t location = unset;
+                uint32_t array_stride = 0;
+                bool builtin = false;
+                bool block = false;
+                bool buffer_block = false;
+                std::vector<uint32_t> member_offsets;
+                std::vector<uint32_t> member_matrix_strides;
+            };
+
+            bool parse(std::span<const uint32_t> p_spirv) {
+                if (p_spirv.size() < 5 or p_spirv[0] != spirv_magic) {
+                    return false;
+                }
+
+                m_ids.assign(p_spirv[3], spirv_id{});
+                std::vector<uint32_t> variables;
+
+                size_t word = 5;
+                while (word < p_spirv.size()) {
+                    const uint32_t opcode = p_spirv[word] & 0xffff;
+                    const uint32_t count = p_spirv[word] >> 16;
+                    if (count == 0 or word + count > p_spirv.size()) {
+                        return false;
+                    }
+                    std::span<const uint32_t> instruction =
+                      p_spirv.subspan(word, count);
+                    word += count;
+
+                    switch (opcode) {
+                        case op_entry_point:
+                            m_stage = execution_stage(instruction[1]);
+                            break;
+                        case op_decorate:
+                            decorate(instruction);
+                            break;
+                        case op_member_decorate:
+                            member_decorate(instruction);
+                            break;
+                        case op_type_bool:
+                        case op_type_int:
+                        case op_type_float:
+                        case op_type_vector:
+                        case op_type_matrix:
+                        case op_type_image:
+                        case op_type_sampler:
+                        case op_type_sampled_image:
+                        case op_type_array:
+                        case op_type_runtime_array:
+                        case op_type_struct:
+                        case op_type_pointer:
+                        case op_type_acceleration_structure:
+                            define(
+                              opcode, instruction[1], instruction.subspan(2));
+                            break;
+                        case op_constant:
+                            // result type, result id, value
+                            if (instruction.size() > 3) {
+                                define(opcode,
+                                       instruction[2],
+                                       instruction.subspan(3));
+                            }
+                            break;
+                        case op_variable:
+                            // operands keep the result type: type, id,
+                            // storage class
+                            if (instruction.size() > 3) {
+                                define(opcode,
+                                       instruction[2],
+                                       instruction.subspan(1));
+                                variables.push_back(instruction[2]);
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+
+                for (uint32_t variable : variables) {
+                    reflect_variable(variable);
+                }
+                sort_descriptors();
+
+                std::ranges::sort(m_vertex_inputs,
+                                  [](const vertex_attribute_entry& p_lhs,
+                                     const vertex_attribute_entry& p_rhs) {
+                                      return p_lhs.location < p_rhs.location;
+                                  });
+                m_vertex_stride = 0;
+                for (vertex_attribute_entry& input : m_vertex_inputs) {
+                    // entry.stride holds the offset within the vertex
+                    const uint32_t size = input.stride;
+                    input.stride = m_vertex_stride;
+                    m_vertex_stride += size;
+                }
+
+                m_ids.clear();
+                return true;
+            }
+
+            void define(uint32_t p_opcode,
+                        uint32_t p_id,
+                        std::span<const uint32_t> p_operands) {
+                if (p_id >= m_ids.size()) {
+                    return;
+                }
+                m_ids[p_id].opcode = p_opcode;
+                m_ids[p_id].operands = p_operands;
+            }
+
+            void decorate(std::span<const uint32_t> p_instruction) {
+                if (p_instruction.size() < 3 or
+                    p_instruction[1] >= m_ids.size()) {
+                    return;
+                }
+                spirv_id& target = m_ids[p_instruction[1]];
+                const uint32_t value =
+                  (p_instruction.size() > 3) ? p_instruction[3] : 0;
+                switch (p_instruction[2]) {
+                    case decoration_block:
+                        target.block = true;
+                        break;
+                    case decoration_buffer_block:
+                        target.buffer_block = true;
+                        break;
+                    case decoration_array_stride:
+                        target.array_stride = value;
+                        break;
+                    case decoration_builtin:
+                        target.builtin = true;
+                        break;
+                    case decoration_location:
+                        target.location = value;
+                        break;
+                    case decoration_binding:
+                        target.binding = value;
+                        break;
+                    case decoration_descriptor_set:
+                        target.set = value;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            void member_decorate(std::span<const uint32_t> p_instruction) {
+                if (p_instruction.size() < 5 or
+                    p_instruction[1] >= m_ids.size()) {
+                    return;
+                }
+                spirv_id& target = m_ids[p_instruction[1]];
+                const uint32_t member = p_instruction[2];
+                std::vector<uint32_t>* values = nullptr;
+                if (p_instruction[3] == decoration_offset) {
+                    values = &target.member_offsets;
+                }
+                else if (p_instruction[3] == decoration_matrix_stride) {
+                    values = &target.member_matrix_strides;
+                }
+                else {
+                    return;
+                }
+                if (values->size() <= member) {
+                    values->resize(member + 1, 0);
+                }
+                (*values)[member] = p_instruction[4];
+            }
+
+            //! @return the id p_id points to, or p_id when not a pointer
+            [[nodiscard]] uint32_t pointee(uint32_t p_id) const {
+                const spirv_id& type = m_ids[p_id];
+                if (type.opcode == op_type_pointer and
+                    type.operands.size() >= 2) {
+                    return type.operands[1];
+                }
+                return p_id;
+            }
+
+            void reflect_variable(uint32_t p_variable) {
+                if (p_variable >= m_ids.size()) {
+                    return;
+                }
+                const spirv_id& variable = m_ids[p_variable];
+                const uint32_t storage = variable.operands[2];
+                uint32_t type = pointee(variable.operands[0]);
+
+                if (storage == storage_input) {
+                    if (m_stage == shader_stage::vertex and
+                        !variable.builtin and variable.location != unset) {
+                        reflect_vertex_input(variable.location, type);
+                    }
+                    return;
+                }
+
+                if (storage == storage_push_constant) {
+                    m_push_constants.push_back(push_constant_range{
+                      .stage = m_stage,
+                      .offset = first_member_offset(type),
+                      .range = type_size(type) - first_member_offset(type),
+                    });
+                    return;
+                }
+
+                if (variable.set == unset or variable.binding == unset) {
+                    return;
+                }
+
+                // Unwrap descriptor arrays
+                uint32_t descriptor_count = 1;
+                if (m_ids[type].opcode == op_type_array) {
+                    descriptor_count = constant(m_ids[type].operands[1]);
+                    type = m_ids[type].operands[0];
+                }
+                else if (m_ids[type].opcode == op_type_runtime_array) {
+                    descriptor_count = 0;
+                    type = m_ids[type].operands[0];
+                }
+
+                VkDescriptorType descriptor = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+                const spirv_id& resource = m_ids[type];
+                switch (resource.opcode) {
+                    case op_type_struct:
+                        descriptor = (storage == storage_storage_buffer or
+                                      resource.buffer_block)
+                                       ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                       : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                        break;
+                    case op_type_sampled_image:
+                        descriptor = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                        if (resource.operands.size() >= 1 and
+                            m_ids[resource.operands[0]].operands.size() >= 2 and
+                            m_ids[resource.operands[0]].operands[1] ==
+                              dim_buffer) {
+                            descriptor =
+                              VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                        }
+                        break;
+                    case op_type_image:
+                        descriptor = image_descriptor(resource);
+                        break;
+                    case op_type_sampler:
+                        descriptor = VK_DESCRIPTOR_TYPE_SAMPLER;
+                        break;
+                    case op_type_acceleration_structure:
+                        descriptor =
+                          VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+                        break;
+                    default:
+                        return;
+                }
+
+                m_descriptors.push_back(reflected_descriptor{
+                  .set = variable.set,
+                  .entry = {
+                    .type = static_cast<descriptor_type>(descriptor),
+                    .binding_point = {
+                      .binding = variable.binding,
+                      .stage = m_stage,
+                    },
+                    .descriptor_count = descriptor_count,
+                  },
+                });
+            }
+
+            [[nodiscard]] VkDescriptorType image_descriptor(
+              const spirv_id& p_image) const {
+                // sampled type, dim, depth, arrayed, ms, sampled, format
+                if (p_image.operands.size() < 6) {
+                    return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                const uint32_t dim = p_image.operands[1];
+                const bool storage = p_image.operands[5] == 2;
+                if (dim == dim_subpass_data) {
+                    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                if (dim == dim_buffer) {
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                   : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                }
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                               : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+
+            void reflect_vertex_input(uint32_t p_location, uint32_t p_type) {
+                uint32_t components = 1;
+                uint32_t scalar = p_type;
+                if (m_ids[p_type].opcode == op_type_vector) {
+                    scalar = m_ids[p_type].operands[0];
+                    components = m_ids[p_type].operands[1];
+                }
+
+                const spirv_id& scalar_type = m_ids[scalar];
+                if (scalar_type.operands.empty() or components > 4) {
+                    return;
+                }
+
+                // R32, R32G32, R32G32B32, R32G32B32A32 of the scalar kind
+                uint32_t first_format = VK_FORMAT_R32_SFLOAT;
+                if (scalar_type.opcode == op_type_int) {
+                    const bool is_signed = scalar_type.operands.size() > 1 and
+                                           scalar_type.operands[1] == 1;
+                    first_format =
+                      is_signed ? VK_FORMAT_R32_SINT : VK_FORMAT_R32_UINT;
+                }
+                else if (scalar_type.opcode != op_type_float or
+                         scalar_type.operands[0] != 32) {
+                    // 16-bit and 64-bit inputs have no matching format here
+                    return;
+                }
+
+                m_vertex_inputs.push_back(vertex_attribute_entry{
+                  .location = p_location,
+                  .format = static_cast<format>(first_format +
+                                                (components - 1) * 3),
+                  .stride = components * 4,
+                });
+            }
+
+            [[nodiscard]] uint32_t constant(uint32_t p_id) const {
+                const spirv_id& value = m_ids[p_id];
+                if (value.opcode != op_constant or value.operands.empty()) {
+                    return 1;
+                }
+                return value.operands[0];
+            }
+
+            [[nodiscard]] uint32_t first_member_offset(
+              uint32_t p_struct) const {
+                const spirv_id& type = m_ids[p_struct];
+                if (type.member_offsets.empty()) {
+                    return 0;
+                }
+                return *std::ranges::min_element(type.member_offsets);
+            }
+
+            //! @return the size in bytes of p_type under its explicit layout
+            [[nodiscard]] uint32_t type_size(
+              uint32_t p_type,
+              uint32_t p_matrix_stride = 0) const {
+                const spirv_id& type = m_ids[p_type];
+                switch (type.opcode) {
+                    case op_type_bool:
+                        return 4;
+                    case op_type_int:
+                    case op_type_float:
+                        return type.operands[0] / 8;
+                    case op_type_vector:
+                        return type.operands[1] * type_size(type.operands[0]);
+                    case op_type_matrix:
+                        return type.operands[1] *
+                               ((p_matrix_stride != 0)
+                                  ? p_matrix_stride
+                                  : type_size(type.operands[0]));
+                    case op_type_array: {
+                        const uint32_t stride =
+                          (type.array_stride != 0)
+                            ? type.array_stride
+                            : type_size(type.operands[0], p_matrix_stride);
+                        return constant(type.operands[1]) * stride;
+                    }
+                    case op_type_runtime_array:
+                        return 0;
+                    case op_type_pointer:
+                        // Buffer device addresses are 64-bit, other pointers
+                        // cannot appear in an explicit layout
+                        return (type.operands[0] ==
+                                storage_physical_storage_buffer)
+                                 ? 8
+                                 : 0;
+                    case op_type_struct: {
+                        uint32_t size = 0;
+                        for (size_t i = 0; i < type.operands.size(); i++) {
+                            const uint32_t offset =
+                              (i < type.member_offsets.size())
+                                ? type.member_offsets[i]
+                                : size;
+                            const uint32_t matrix_stride =
+                              (i < type.member_matrix_strides.size())
+                                ? type.member_matrix_strides[i]
+                                : 0;
+                            size = std::max(
+                              size,
+                              offset +
+                                type_size(type.operands[i], matrix_stride));
+                        }
+                        return size;
+                    }
+                    default:
+                        return 0;
+                }
+            }
+
+            [[nodiscard]] static shader_stage execution_stage(
+              uint32_t p_model) {
+                switch (p_model) {
+                    case 0:
+                        return shader_stage::vertex;
+                    case 1:
+                        return static_cast<shader_stage>(
+                          VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
+                    case 2:
+                        return static_cast<shader_stage>(
+                          VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
+                    case 3:
+                        return shader_stage::geometry;
+                    case 4:
+                        return shader_stage::fragment;
+                    case 5:
+                        return shader_stage::compute;
+                    case 5267:
+                        return shader_stage::task_bit_ext;
+                    case 5268:
+                        return shader_stage::mesh_bit_ext;
+                    default:
+                        return shader_stage::undefined;
+                }
+            }
+
+            [[nodiscard]] static shader_stage combine(shader_stage p_lhs,
+                                                      shader_stage p_rhs) {
+                return static_cast<shader_stage>(static_cast<uint32_t>(p_lhs) |
+                                                 static_cast<uint32_t>(p_rhs));
+            }
+
+            void sort_descriptors() {
+                std::ranges::sort(m_descriptors,
+                                  [](const reflected_descriptor& p_lhs,
+                                     const reflected_descriptor& p_rhs) {
+                                      if (p_lhs.set != p_rhs.set) {
+                                          return p_lhs.set < p_rhs.set;
+                                      }
+                                      return p_lhs.entry.binding_point.binding <
+                                             p_rhs.entry.binding_point.binding;
+                                  });
+            }
+
+        private:
+            bool m_valid = false;
+            shader_stage m_stage = shader_stage::undefined;
+            std::vector<reflected_descriptor> m_descriptors;
+            std::vector<push_constant_range> m_push_constants;
+            std::vector<vertex_attribute_entry> m_vertex_inputs;
+            uint32_t m_vertex_stride = 0;
+            // Only alive while parsing, indexed by result id
+            std::vector<spirv_id> m_ids;
+        };
+    };
+};
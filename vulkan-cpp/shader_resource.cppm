@@ -3,13 +3,14 @@ module;
 #include <vulkan/vulkan.h>
 #include <span>
 #include <vector>
-#include <fstream>
-#include <filesystem>
+#include <array>
 
 export module vk:shader_resource;
 
 export import :types;
 export import :utilities;
+export import :shader_reflection;
+export import :shader_module_cache;
 
 export namespace vk {
     inline namespace v6 {
@@ -19,10 +20,13 @@ export namespace vk {
          * corresponds to.
          * @param vertex_attributes are the vertex attributes that are used to
          * setup vulkan vertex attributes and the binding attributes.
+         * @param module_cache shares the shader modules with every other
+         * shader_resource using the same cache when set, which then owns them
          */
         struct shader_resource_info {
             std::span<const shader_source> sources{};
             std::span<const vertex_attribute> vertex_attributes{};
+            shader_module_cache* module_cache = nullptr;
         };
 
         /**
@@ -46,34 +50,50 @@ export namespace vk {
                             const shader_resource_info& p_info)
               : m_device(p_device) {
                 m_shader_module_handlers.resize(p_info.sources.size());
+                m_code.resize(p_info.sources.size());
+
+                m_owns_modules = p_info.module_cache == nullptr;
 
                 for (size_t i = 0; i < p_info.sources.size(); i++) {
                     const shader_source shader_src = p_info.sources[i];
-                    std::vector<char> blob =
-                      compile_binary_shader_source(shader_src);
+                    spirv_file binary(shader_src.filename);
 
-                    if (blob.empty()) {
+                    if (!binary.valid()) {
                         m_is_resource_valid = false;
                         return;
                     }
 
-                    std::span<char> binary(blob.begin(), blob.end());
-                    VkShaderModuleCreateInfo shader_module_ci = {
-                        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-                        .pNext = nullptr,
-                        .codeSize = static_cast<uint32_t>(binary.size_bytes()),
-                        .pCode = (const uint32_t*)binary.data()
-                    };
+                    if (p_info.module_cache != nullptr) {
+                        m_shader_module_handlers[i] = p_info.module_cache->get(
+                          binary.words(), shader_src.stage);
+                    }
+                    else {
+                        VkShaderModuleCreateInfo shader_module_ci = {
+                            .sType =
+                              VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                            .pNext = nullptr,
+                            .codeSize = binary.words().size_bytes(),
+                            .pCode = binary.words().data()
+                        };
+
+                        // Setting m_shader_module_handlers[i]'s stage and the
+                        // VkShaderModule handle altogether
+                        vk_check(vkCreateShaderModule(
+                                   m_device,
+                                   &shader_module_ci,
+                                   nullptr,
+                                   &m_shader_module_handlers[i].module),
+                                 "vkCreateShaderModule");
+                        m_shader_module_handlers[i].stage = shader_src.stage;
+
+                        // Identifies the module by content, see
+                        // shader_handle::code
+                        m_code[i].assign(binary.words().begin(),
+                                         binary.words().end());
+                        m_shader_module_handlers[i].code = m_code[i];
+                    }
 
-                    // Setting m_shader_module_handlers[i]'s stage and the
-                    // VkShaderModule handle altogether
-                    vk_check(
-                      vkCreateShaderModule(m_device,
-                                           &shader_module_ci,
-                                           nullptr,
-                                           &m_shader_module_handlers[i].module),
-                      "vkCreateShaderModule");
-                    m_shader_module_handlers[i].stage = shader_src.stage;
+                    m_reflection.merge(shader_reflection(binary.words()));
                 }
 
                 m_is_resource_valid = true;
@@ -112,6 +132,26 @@ export namespace vk {
                 }
             }
 
+            /**
+             * @return the bindings, push constants and vertex inputs of every
+             * loaded stage, to fill descriptor_layout and pipeline_params
+             */
+            [[nodiscard]] const shader_reflection& reflection() const {
+                return m_reflection;
+            }
+
+            /**
+             * @brief Sets the vertex attributes to the reflected vertex shader
+             * inputs, interleaved in binding 0
+             */
+            void reflect_vertex_attributes(
+              input_rate p_input_rate = input_rate::vertex) {
+                std::array<vertex_attribute, 1> attributes = {
+                    m_reflection.vertex_attributes(0, p_input_rate),
+                };
+                vertex_attributes(attributes);
+            }
+
             //! @return the handlers of vulkan shader modules for each
             //! individual shader source loaded altogether
             [[nodiscard]] std::span<const shader_handle> handles() const {
@@ -132,6 +172,9 @@ export namespace vk {
 
             //! @brief used for explicit cleanup for this resource
             void destruct() {
+                if (!m_owns_modules) {
+                    return;
+                }
                 for (auto& handle : m_shader_module_handlers) {
                     if (handle.module != nullptr) {
                         vkDestroyShaderModule(m_device, handle.module, nullptr);
@@ -139,37 +182,6 @@ export namespace vk {
                 }
             }
 
-        private:
-            // Reading the raw .spv binaries
-            std::vector<char> read(const std::string& p_file) {
-                std::vector<char> out_buffer;
-                std::ifstream ins(p_file, std::ios::ate | std::ios::binary);
-
-                if (!ins) {
-                    return {};
-                }
-
-                uint32_t file_size = (uint32_t)ins.tellg();
-                out_buffer.resize(file_size);
-                ins.seekg(0);
-                ins.read(out_buffer.data(), file_size);
-                return out_buffer;
-            }
-
-            //! @brief Ensure file reads are valid before reading raw .spv
-            //! binaries
-            std::vector<char> compile_binary_shader_source(
-              const shader_source& p_shader_source) {
-                std::vector<char> binary_blob{};
-
-                if (std::filesystem::is_regular_file(
-                      p_shader_source.filename)) {
-                    binary_blob = read(p_shader_source.filename);
-                }
-
-                return binary_blob;
-            }
-
         private:
             VkDevice m_device = nullptr;
             bool m_is_resource_valid = false;
@@ -177,6 +189,9 @@ export namespace vk {
             std::vector<VkVertexInputBindingDescription>
               m_vertex_binding_attributes;
             std::vector<shader_handle> m_shader_module_handlers;
+            std::vector<std::vector<uint32_t>> m_code;
+            shader_reflection m_reflection;
+            bool m_owns_modules = true;
         };
     };
 };
\ No newline at end of file
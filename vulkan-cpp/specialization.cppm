@@ -0,0 +1,256 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+#include <mutex>
+
+export module vk:specialization;
+
+export import :types;
+export import :utilities;
+export import :pipeline;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @brief Typed specialization constants, mapping the fields of T to
+         * constant ids
+         *
+         * T holds the values and must be trivially copyable. Each field is a
+         * 32-bit or 64-bit scalar, booleans being VkBool32 as in SPIR-V.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * // layout(constant_id = 0) const bool use_shadows = false;
+         * // layout(constant_id = 1) const uint light_count = 1;
+         * struct lit_constants {
+         *      VkBool32 use_shadows = true;
+         *      uint32_t light_count = 4;
+         * };
+         *
+         * vk::specialization_constants<lit_constants> constants;
+         * constants.constant(0, &lit_constants::use_shadows)
+         *          .constant(1, &lit_constants::light_count);
+         *
+         * vk::pipeline_params params = { ...,
+         *      .specialization = constants.info(),
+         * };
+         *
+         * ```
+         */
+        template<typename T>
+        class specialization_constants {
+            static_assert(std::is_trivially_copyable_v<T>,
+                          "specialization constants are copied as bytes");
+
+        public:
+            specialization_constants() = default;
+
+            specialization_constants(const T& p_values)
+              : m_values(p_values) {}
+
+            //! @brief Maps p_member of T to layout(constant_id = p_id)
+            template<typename M>
+            specialization_constants& constant(uint32_t p_id, M T::*p_member) {
+                static_assert(std::is_arithmetic_v<M> and
+                                !std::is_same_v<M, bool> and
+                                (sizeof(M) == 4 or sizeof(M) == 8),
+                              "specialization constants are 32-bit or 64-bit "
+                              "scalars, use VkBool32 for booleans");
+
+                const auto* base =
+                  reinterpret_cast<const std::byte*>(&m_values);
+                const auto* field =
+                  reinterpret_cast<const std::byte*>(&(m_values.*p_member));
+                m_entries.push_back({
+                  .constant_id = p_id,
+                  .offset = static_cast<uint32_t>(field - base),
+                  .size = sizeof(M),
+                });
+                return *this;
+            }
+
+            [[nodiscard]] T& values() { return m_values; }
+
+            [[nodiscard]] const T& values() const { return m_values; }
+
+            //! @return the entries and values, valid while this object lives
+            [[nodiscard]] specialization_info info() const {
+                return specialization_info{
+                    .entries = m_entries,
+                    .data = std::as_bytes(std::span(&m_values, 1)),
+                };
+            }
+
+        private:
+            T m_values{};
+            std::vector<specialization_entry> m_entries;
+        };
+
+        /**
+         * @return bytes identifying a permutation of specialization
+         * constants: the id and size of every entry followed by the bytes of
+         * its value
+         */
+        [[nodiscard]] std::vector<std::byte> permutation_bytes(
+          const specialization_info& p_constants) {
+            std::vector<std::byte> bytes;
+            auto append = [&bytes](std::span<const std::byte> p_bytes) {
+                bytes.insert(bytes.end(), p_bytes.begin(), p_bytes.end());
+            };
+            for (const specialization_entry& entry : p_constants.entries) {
+                append(std::as_bytes(std::span(&entry.constant_id, 1)));
+                append(std::as_bytes(std::span(&entry.size, 1)));
+                // Only the bytes of mapped fields, padding is not included
+                if (entry.offset < p_constants.data.size()) {
+                    append(p_constants.data.subspan(
+                      entry.offset,
+                      std::min<size_t>(entry.size,
+                                       p_constants.data.size() -
+                                         entry.offset)));
+                }
+            }
+            return bytes;
+        }
+
+        //! @return hash of the permutation_bytes of p_constants
+        [[nodiscard]] uint64_t permutation_key(
+          const specialization_info& p_constants) {
+            return hash_bytes(permutation_bytes(p_constants));
+        }
+
+        /**
+         * @brief Creates and caches the pipeline variants of one set of shader
+         * modules, one per permutation of specialization constants
+         *
+         * Every material variant reuses the same SPIR-V, so a single module
+         * is compiled and shipped instead of one binary per permutation of
+         * #defines. Variants are created on first use, keyed with
+         * permutation_key and told apart by their permutation_bytes.
+         *
+         * The spans of p_base, such as shader modules and descriptor
+         * layouts, are referenced and must outlive the cache.
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::pipeline_variant_cache lit_variants(logical_device, lit_params);
+         *
+         * vk::specialization_constants<lit_constants> constants({
+         *      .use_shadows = material.casts_shadows,
+         *      .light_count = scene.light_count(),
+         * });
+         * constants.constant(0, &lit_constants::use_shadows)
+         *          .constant(1, &lit_constants::light_count);
+         *
+         * lit_variants.get(constants).bind(current);
+         *
+         * ```
+         */
+        class pipeline_variant_cache {
+        public:
+            pipeline_variant_cache() = default;
+
+            pipeline_variant_cache(const VkDevice& p_device,
+                                   const pipeline_params& p_base)
+              : m_device(p_device) {
+                m_base.emplace(p_base);
+            }
+
+            pipeline_variant_cache(const pipeline_variant_cache&) = delete;
+            pipeline_variant_cache& operator=(const pipeline_variant_cache&) =
+              delete;
+
+            /**
+             * @return the pipeline specialized with p_constants, created on
+             * first use. Safe to call from multiple threads.
+             */
+            [[nodiscard]] pipeline& get(
+              const specialization_info& p_constants) {
+                std::vector<std::byte> bytes = permutation_bytes(p_constants);
+                const uint64_t key = hash_bytes(bytes);
+
+                {
+                    std::scoped_lock lock(m_mutex);
+                    if (pipeline* found = find(key, bytes)) {
+                        return *found;
+                    }
+                }
+
+                // Created without m_mutex so variants already cached stay
+                // available to other threads meanwhile
+                pipeline_params params = *m_base;
+                params.specialization = p_constants;
+                pipeline created(m_device, params);
+
+                std::scoped_lock lock(m_mutex);
+                if (pipeline* found = find(key, bytes)) {
+                    // Another thread created the same variant first
+                    created.destruct();
+                    return *found;
+                }
+                return m_variants
+                  .emplace(key, variant{ std::move(bytes), created })
+                  ->second.handle;
+            }
+
+            template<typename T>
+            [[nodiscard]] pipeline& get(
+              const specialization_constants<T>& p_constants) {
+                return get(p_constants.info());
+            }
+
+            //! @return the amount of variants created
+            [[nodiscard]] size_t size() const {
+                std::scoped_lock lock(m_mutex);
+                return m_variants.size();
+            }
+
+            void destruct() {
+                std::scoped_lock lock(m_mutex);
+                for (auto& [key, cached] : m_variants) {
+                    cached.handle.destruct();
+                }
+                m_variants.clear();
+            }
+
+        private:
+            struct variant {
+                std::vector<std::byte> bytes;
+                pipeline handle;
+            };
+
+            //! @return the variant of p_bytes, null if not created yet
+            [[nodiscard]] pipeline* find(
+              uint64_t p_key,
+              std::span<const std::byte> p_bytes) {
+                auto [first, last] = m_variants.equal_range(p_key);
+                for (auto it = first; it != last; ++it) {
+                    if (std::ranges::equal(it->second.bytes, p_bytes)) {
+                        return &it->second.handle;
+                    }
+                }
+                return nullptr;
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            // pipeline_params has no default, the cache does
+            std::optional<pipeline_params> m_base;
+            mutable std::mutex m_mutex;
+            // Keyed by permutation_key, colliding variants share a key
+            std::unordered_multimap<uint64_t, variant> m_variants;
+        };
+    };
+};
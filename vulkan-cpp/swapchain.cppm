@@ -4,16 +4,72 @@ module;
 #include <span>
 #include <vector>
 #include <algorithm>
+#include <limits>
+#include <array>
 
 export module vk:swapchain;
 
 export import :types;
 export import :utilities;
 export import :device_queue;
+export import :sample_image;
+export import :framebuffer;
 
 export namespace vk {
     inline namespace v6 {
 
+        /**
+         * @brief Per-image resources a vk::swapchain creates and rebuilds on
+         * recreate()
+         *
+         * @param renderpass creates a framebuffer per image when set, leave
+         * nullptr with dynamic rendering
+         * @param depth_format creates a depth image per image when not
+         * VK_FORMAT_UNDEFINED
+         * @param memory_mask is the memory of the depth images
+         */
+        struct swapchain_target_params {
+            VkRenderPass renderpass = nullptr;
+            VkFormat depth_format = VK_FORMAT_UNDEFINED;
+            uint32_t memory_mask = 0;
+        };
+
+        /**
+         * @brief vk::swapchain wraps VkSwapchainKHR and optionally the color
+         * views, depth images and framebuffers of its images
+         *
+         * On resize, recreate() hands the current swapchain to
+         * VkSwapchainCreateInfoKHR::oldSwapchain and keeps the old handle and
+         * its targets alive until collect() is told the frame that used them
+         * has completed, so no vkDeviceWaitIdle is needed.
+         *
+         * ```
+         *
+         *  frame N: recreate(extent, surface, N) --> retired {old, targets, N}
+         *  frame M: fence of frame N signaled --> collect(N) destroys them
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * main_swapchain.create_targets({
+         *      .renderpass = main_renderpass,
+         *      .depth_format = depth_format,
+         *      .memory_mask = device_local,
+         * });
+         *
+         * if (present_queue.out_of_date()) {
+         *      vk::surface_params surface =
+         *          physical_device.request_surface(window_surface);
+         *      main_swapchain.recreate({ width, height }, surface, frame);
+         *      present_queue.rebind(main_swapchain);
+         * }
+         * main_swapchain.collect(last_completed_frame);
+         *
+         * ```
+         */
         class swapchain {
         public:
             swapchain() = delete("Cannot construct empty swapchain");
@@ -32,35 +88,127 @@ export namespace vk {
 
             void construct(const swapchain_params& p_settings,
                            const surface_params& p_surface_properties) {
+                m_settings = p_settings;
+                create(p_surface_properties, nullptr);
+            }
 
-                VkSwapchainCreateInfoKHR swapchain_ci = {
-                    .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-                    .pNext = nullptr,
-                    .surface = m_surface_handler,
-                    .minImageCount = p_surface_properties.image_size,
-                    .imageFormat = p_surface_properties.format.format,
-                    .imageColorSpace = p_surface_properties.format.colorSpace,
-                    // use physical device surface formats to getting the right
-                    // formats in vulkan
-                    .imageExtent =
-                      p_surface_properties.capabilities.currentExtent,
-                    .imageArrayLayers = 1,
+            /**
+             * @brief Creates a color view per swapchain image, plus the depth
+             * images and framebuffers requested by p_params. recreate()
+             * rebuilds them for the new images.
+             */
+            void create_targets(const swapchain_target_params& p_params) {
+                m_target_params = p_params;
+                m_has_targets = true;
+                m_targets = build_targets({});
+            }
 
-                    // Remove COLOR_ATTACHMENT flag because its not needed
-                    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                    .queueFamilyIndexCount = 0,
-                    .pQueueFamilyIndices = nullptr,
-                    .preTransform =
-                      p_surface_properties.capabilities.currentTransform,
-                    .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-                    .presentMode =
-                      static_cast<VkPresentModeKHR>(p_settings.present_mode),
-                    .clipped = p_settings.clipped,
+            /**
+             * @brief Rebuilds the swapchain for a new surface extent
+             *
+             * The old swapchain is passed as oldSwapchain, so images it
+             * already acquired still present. It and its targets are
+             * destroyed by collect() once p_frame has completed. Depth images
+             * are reused when the extent and image count did not change.
+             *
+             * @param p_extent is the window framebuffer size, used when the
+             * surface leaves the extent to the swapchain
+             * @param p_surface_properties are freshly queried surface
+             * capabilities
+             * @param p_frame is the number of the last frame submitted
+             *
+             * @return false when the surface has a zero extent (minimized) and
+             * nothing was recreated
+             */
+            bool recreate(const VkExtent2D& p_extent,
+                          const surface_params& p_surface_properties,
+                          uint64_t p_frame) {
+                surface_params surface = p_surface_properties;
+                VkSurfaceCapabilitiesKHR& capabilities = surface.capabilities;
+                if (capabilities.currentExtent.width ==
+                    std::numeric_limits<uint32_t>::max()) {
+                    capabilities.currentExtent = {
+                        .width = std::clamp(p_extent.width,
+                                            capabilities.minImageExtent.width,
+                                            capabilities.maxImageExtent.width),
+                        .height =
+                          std::clamp(p_extent.height,
+                                     capabilities.minImageExtent.height,
+                                     capabilities.maxImageExtent.height),
+                    };
+                }
+
+                if (capabilities.currentExtent.width == 0 or
+                    capabilities.currentExtent.height == 0) {
+                    return false;
+                }
+
+                const VkExtent2D previous_extent = m_extent;
+                const size_t previous_count = m_images.size();
+
+                retired_swapchain retired = {
+                    .handle = m_swapchain_handler,
+                    .targets = std::move(m_targets),
+                    .frame = p_frame,
                 };
-                VkResult res = vkCreateSwapchainKHR(
-                  m_device, &swapchain_ci, nullptr, &m_swapchain_handler);
+                m_targets = {};
 
-                vk_check(res, "vkCreateSwapchainKHR");
+                create(surface, retired.handle);
+                get_images();
+
+                if (m_has_targets) {
+                    std::vector<sample_image> reused_depth;
+                    if (previous_extent.width == m_extent.width and
+                        previous_extent.height == m_extent.height and
+                        previous_count == m_images.size()) {
+                        reused_depth = std::move(retired.targets.depth_images);
+                        retired.targets.depth_images.clear();
+                    }
+                    m_targets = build_targets(std::move(reused_depth));
+                }
+
+                m_retired.push_back(std::move(retired));
+                return true;
+            }
+
+            /**
+             * @brief Destroys swapchains and targets retired at or before
+             * p_completed_frame
+             *
+             * @param p_completed_frame is the newest frame whose fence has
+             * signaled
+             */
+            void collect(uint64_t p_completed_frame) {
+                std::erase_if(m_retired,
+                              [this, p_completed_frame](
+                                retired_swapchain& p_retired) {
+                                  if (p_retired.frame > p_completed_frame) {
+                                      return false;
+                                  }
+                                  destroy(p_retired);
+                                  return true;
+                              });
+            }
+
+            //! @return the extent the swapchain images were created with
+            [[nodiscard]] VkExtent2D extent() const { return m_extent; }
+
+            //! @return color views of the swapchain images, after
+            //! create_targets()
+            [[nodiscard]] std::span<sample_image> images() {
+                return m_targets.images;
+            }
+
+            //! @return depth images per swapchain image, after
+            //! create_targets() with a depth format
+            [[nodiscard]] std::span<sample_image> depth_images() {
+                return m_targets.depth_images;
+            }
+
+            //! @return framebuffers per swapchain image, after
+            //! create_targets() with a renderpass
+            [[nodiscard]] std::span<framebuffer> framebuffers() {
+                return m_targets.framebuffers;
             }
 
             /**
@@ -91,7 +239,14 @@ export namespace vk {
                 return m_images;
             }
 
+            //! @brief Destroys the swapchain, its targets and every retired
+            //! swapchain. The device must be idle.
             void destruct() {
+                for (retired_swapchain& retired : m_retired) {
+                    destroy(retired);
+                }
+                m_retired.clear();
+                destroy(m_targets);
                 vkDestroySwapchainKHR(m_device, m_swapchain_handler, nullptr);
             }
 
@@ -101,11 +256,163 @@ export namespace vk {
 
             operator VkSwapchainKHR() { return m_swapchain_handler; }
 
+        private:
+            struct swapchain_targets {
+                std::vector<sample_image> images;
+                std::vector<sample_image> depth_images;
+                std::vector<framebuffer> framebuffers;
+            };
+
+            struct retired_swapchain {
+                VkSwapchainKHR handle = nullptr;
+                swapchain_targets targets;
+                uint64_t frame = 0;
+            };
+
+            void create(const surface_params& p_surface_properties,
+                        VkSwapchainKHR p_old_swapchain) {
+                m_surface_format = p_surface_properties.format.format;
+                m_extent = p_surface_properties.capabilities.currentExtent;
+
+                const VkSurfaceCapabilitiesKHR& capabilities =
+                  p_surface_properties.capabilities;
+                uint32_t image_count = p_surface_properties.image_size;
+                if (m_settings.image_count != 0) {
+                    const uint32_t max_image_count =
+                      (capabilities.maxImageCount > 0)
+                        ? capabilities.maxImageCount
+                        : std::numeric_limits<uint32_t>::max();
+                    image_count = std::clamp(m_settings.image_count,
+                                             capabilities.minImageCount,
+                                             max_image_count);
+                }
+
+                VkSwapchainCreateInfoKHR swapchain_ci = {
+                    .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+                    .pNext = nullptr,
+                    .surface = m_surface_handler,
+                    .minImageCount = image_count,
+                    .imageFormat = p_surface_properties.format.format,
+                    .imageColorSpace = p_surface_properties.format.colorSpace,
+                    // use physical device surface formats to getting the right
+                    // formats in vulkan
+                    .imageExtent =
+                      p_surface_properties.capabilities.currentExtent,
+                    .imageArrayLayers = 1,
+
+                    // Remove COLOR_ATTACHMENT flag because its not needed
+                    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    .queueFamilyIndexCount = 0,
+                    .pQueueFamilyIndices = nullptr,
+                    .preTransform =
+                      p_surface_properties.capabilities.currentTransform,
+                    .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+                    .presentMode =
+                      static_cast<VkPresentModeKHR>(m_settings.present_mode),
+                    .clipped = m_settings.clipped,
+                    .oldSwapchain = p_old_swapchain,
+                };
+                VkResult res = vkCreateSwapchainKHR(
+                  m_device, &swapchain_ci, nullptr, &m_swapchain_handler);
+
+                vk_check(res, "vkCreateSwapchainKHR");
+            }
+
+            swapchain_targets build_targets(
+              std::vector<sample_image> p_reused_depth) {
+                std::span<const VkImage> images = get_images();
+                swapchain_targets targets;
+                targets.images.resize(images.size());
+
+                for (size_t i = 0; i < images.size(); i++) {
+                    image_params color_params = {
+                        .extent = { .width = m_extent.width,
+                                    .height = m_extent.height },
+                        .format = m_surface_format,
+                        .aspect = image_aspect_flags::color_bit,
+                        .usage = image_usage::color_attachment_bit,
+                    };
+                    targets.images[i] =
+                      sample_image(m_device, images[i], color_params);
+                }
+
+                if (m_target_params.depth_format != VK_FORMAT_UNDEFINED) {
+                    targets.depth_images = std::move(p_reused_depth);
+                    for (size_t i = targets.depth_images.size();
+                         i < images.size();
+                         i++) {
+                        image_params depth_params = {
+                            .extent = { .width = m_extent.width,
+                                        .height = m_extent.height },
+                            .format = m_target_params.depth_format,
+                            .memory_mask = m_target_params.memory_mask,
+                            .aspect = image_aspect_flags::depth_bit,
+                            .usage = image_usage::depth_stencil_bit,
+                        };
+                        targets.depth_images.emplace_back(m_device,
+                                                          depth_params);
+                    }
+                }
+
+                if (m_target_params.renderpass != nullptr) {
+                    targets.framebuffers.resize(images.size());
+                    for (size_t i = 0; i < images.size(); i++) {
+                        std::array<VkImageView, 2> views = {
+                            targets.images[i].image_view(),
+                            nullptr,
+                        };
+                        const uint32_t view_count =
+                          targets.depth_images.empty() ? 1 : 2;
+                        if (view_count == 2) {
+                            views[1] = targets.depth_images[i].image_view();
+                        }
+
+                        framebuffer_params framebuffer_info = {
+                            .renderpass = m_target_params.renderpass,
+                            .views = std::span<VkImageView>(views.data(),
+                                                            view_count),
+                            .extent = m_extent,
+                        };
+                        targets.framebuffers[i] =
+                          framebuffer(m_device, framebuffer_info);
+                    }
+                }
+
+                return targets;
+            }
+
+            void destroy(retired_swapchain& p_retired) {
+                destroy(p_retired.targets);
+                if (p_retired.handle != nullptr) {
+                    vkDestroySwapchainKHR(m_device, p_retired.handle, nullptr);
+                }
+            }
+
+            void destroy(swapchain_targets& p_targets) {
+                for (framebuffer& fb : p_targets.framebuffers) {
+                    fb.destruct();
+                }
+                for (sample_image& image : p_targets.images) {
+                    image.destruct();
+                }
+                for (sample_image& depth : p_targets.depth_images) {
+                    depth.destruct();
+                }
+                p_targets = {};
+            }
+
         private:
             VkDevice m_device = nullptr;
             VkSwapchainKHR m_swapchain_handler = nullptr;
             VkSurfaceKHR m_surface_handler = nullptr;
             std::vector<VkImage> m_images;
+            swapchain_params m_settings{};
+            VkFormat m_surface_format = VK_FORMAT_UNDEFINED;
+            VkExtent2D m_extent{};
+            bool m_has_targets = false;
+            swapchain_target_params m_target_params{};
+            swapchain_targets m_targets;
+            std::vector<retired_swapchain> m_retired;
         };
     };
 };
\ No newline at end of file
@@ -4,6 +4,7 @@ module;
 #include <span>
 #include <array>
 #include <filesystem>
+#include <algorithm>
 
 export module vk:texture;
 
@@ -13,6 +14,8 @@ import :buffer;
 import :sample_image;
 import :command_buffer;
 import :image;
+import :mipmap;
+import :ktx2;
 
 export namespace vk {
     inline namespace v6 {
@@ -21,6 +24,11 @@ export namespace vk {
         public:
             texture() = default;
 
+            //! @brief Creates an empty texture that is filled with
+            //! record_upload
+            texture(const VkDevice& p_device)
+              : m_device(p_device) {}
+
             texture(const VkDevice& p_device,
                     const image_extent& p_extent,
                     std::span<const uint8_t> p_color,
@@ -35,7 +43,6 @@ export namespace vk {
                           p_memory_mask,
                           p_mip_levels,
                           p_layer_count);
-                m_texture_loaded = true;
             }
 
             texture(const VkDevice& p_device,
@@ -45,127 +52,205 @@ export namespace vk {
                 construct(p_image, p_texture_params);
             }
 
+            texture(const VkDevice& p_device,
+                    const ktx2_texture& p_ktx,
+                    const texture_params& p_texture_params)
+              : m_device(p_device) {
+                construct(p_ktx, p_texture_params);
+            }
+
             void construct(image_extent p_extent,
                            std::span<const uint8_t> p_data,
                            uint32_t p_memory_mask,
                            uint32_t p_mip_levels = 1,
                            uint32_t p_layer_count = 1) {
-                m_extent = p_extent;
-
-                const VkFormat texture_format =
-                  static_cast<VkFormat>(format::r8g8b8a8_unorm);
-
-                image_params img_options = {
-                    .extent = p_extent,
-                    .format = texture_format,
-                    .memory_mask = p_memory_mask,
-                    .usage =
-                      image_usage::transfer_dst_bit | image_usage::sampled_bit,
-                    .mip_levels = p_mip_levels,
-                    .layer_count = p_layer_count,
-                };
+                // r8g8b8a8_unorm is required to support linear blits by the
+                // Vulkan specification so mips are always generated on the GPU
+                upload_pixels(p_extent,
+                              p_data,
+                              texture_params{ .memory_mask = p_memory_mask,
+                                              .mip_levels = p_mip_levels,
+                                              .layer_count = p_layer_count,
+                                              .linear_blit = true });
+            }
 
-                m_image = sample_image(m_device, img_options);
+            void construct(image* p_image,
+                           const texture_params& p_texture_params) {
+                upload_pixels(
+                  p_image->extent(), p_image->read(), p_texture_params);
+            }
 
-                // Performing staging transfers
-                buffer_parameters staging_options = {
-                    .memory_mask = img_options.memory_mask,
-                    .usage = buffer_usage::transfer_src_bit,
-                };
-                buffer staging(m_device, p_data.size(), staging_options);
+            /**
+             * @brief Uploads every mip level, array layer and cube face stored
+             * in a KTX2 container
+             *
+             * The format of the container is used instead of
+             * p_texture_params.format. Check it is sampleable on the device
+             * beforehand with physical_device::request_texture_format.
+             *
+             * When the container asks for mips to be generated, they are
+             * blitted on the GPU if p_texture_params.linear_blit is set.
+             * Block-compressed formats cannot be blitted into, so those are
+             * uploaded with the levels stored in the file.
+             */
+            void construct(const ktx2_texture& p_ktx,
+                           const texture_params& p_texture_params) {
+                const bool generate_mips = p_ktx.generate_mips and
+                                           p_texture_params.linear_blit and
+                                           !is_block_compressed(p_ktx.format);
+
+                image_params img_options =
+                  p_ktx.params(p_texture_params.memory_mask);
+                img_options.sampler = p_texture_params.sampler;
+                if (generate_mips) {
+                    img_options.usage =
+                      img_options.usage | image_usage::transfer_src_bit;
+                    img_options.mip_levels = max_mip_levels(p_ktx.extent);
+                }
+
+                upload(img_options, p_ktx.bytes, p_ktx.regions, generate_mips);
+            }
 
-                staging.transfer(p_data);
+            /**
+             * @brief Creates the image and records the copies from p_staging
+             * into p_command without submitting
+             *
+             * Used to batch the uploads of many textures into a single
+             * submission. p_staging must stay alive until p_command has
+             * finished executing. The texture is considered loaded once
+             * recorded.
+             *
+             * @param p_command is the command buffer to record the copies to
+             * @param p_staging is the host-visible buffer holding the texels
+             * @param p_regions are the copy regions from p_staging
+             * @param p_image_params are the parameters of the image to create
+             * @param p_generate_mips blits the remaining mip levels from level
+             * 0 when set. The image usage must include transfer_src_bit.
+             */
+            void record_upload(const VkCommandBuffer& p_command,
+                               buffer& p_staging,
+                               std::span<const buffer_image_copy> p_regions,
+                               const image_params& p_image_params,
+                               bool p_generate_mips) {
+                m_extent = p_image_params.extent;
+                m_image = sample_image(m_device, p_image_params);
+
+                // Transitions every mip level for the copies and blits
+                m_image.memory_barrier(p_command,
+                                       p_image_params.format,
+                                       VK_IMAGE_LAYOUT_UNDEFINED,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+                p_staging.copy_to_image(p_command, m_image, p_regions);
+
+                if (p_generate_mips) {
+                    m_image.generate_mipmaps(p_command,
+                                             p_image_params.extent,
+                                             p_image_params.mip_levels,
+                                             p_image_params.layer_count);
+                }
+                else {
+                    m_image.memory_barrier(
+                      p_command,
+                      p_image_params.format,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                }
 
-                // Performing transfers as a command to GPU memory for
-                // preparations
-                command_params copy_command_params = {
-                    .levels = command_levels::primary,
-                    .queue_index = 0,
-                    .flags = command_pool_flags::reset,
-                };
-                command_buffer temp_command_buffer =
-                  command_buffer(m_device, copy_command_params);
+                m_texture_loaded = true;
+            }
 
-                temp_command_buffer.begin(command_usage::one_time_submit);
+            //! @return true if image loaded, false if texture did not load
+            //! correctly
+            [[nodiscard]] bool loaded() const { return m_texture_loaded; }
 
-                // Performing image layouts
-                VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-                VkImageLayout new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                m_image.memory_barrier(temp_command_buffer,
-                                       img_options.format,
-                                       old_layout,
-                                       new_layout);
-
-                std::array<vk::buffer_image_copy, 1> region_copies = {
-                    vk::buffer_image_copy{
-                        .image_offset = { .width = 0, .height = 0, .depth = 0, },
-                        .image_extent = { .width = img_options.extent.width, .height = img_options.extent.height, .depth = 1, },
-                    }
-                };
+            [[nodiscard]] sample_image image() const { return m_image; }
 
-                staging.copy_to_image(
-                  temp_command_buffer, m_image, region_copies);
+            [[nodiscard]] image_extent extent() const { return m_extent; }
 
-                old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                m_image.memory_barrier(temp_command_buffer,
-                                       img_options.format,
-                                       old_layout,
-                                       new_layout);
+            void destruct() { m_image.destruct(); }
 
-                temp_command_buffer.end();
+        private:
+            /**
+             * @brief Uploads level 0 of uncompressed pixels and fills the
+             * remaining mip levels
+             *
+             * Mips are blitted on the GPU when p_params.linear_blit is set.
+             * Otherwise the mip chain is built on the CPU and every level is
+             * copied from the staging buffer. If the format cannot be filtered
+             * on the CPU either, the texture is created with a single level.
+             */
+            void upload_pixels(const image_extent& p_extent,
+                               std::span<const uint8_t> p_data,
+                               const texture_params& p_params) {
+                uint32_t mip_levels = std::max(p_params.mip_levels, 1u);
+                const bool gpu_mips = mip_levels > 1 and p_params.linear_blit;
+
+                mip_chain cpu_chain{};
+                if (mip_levels > 1 and !gpu_mips) {
+                    cpu_chain = generate_mip_chain(p_data,
+                                                   p_extent,
+                                                   p_params.format,
+                                                   mip_levels,
+                                                   p_params.layer_count);
+                    if (cpu_chain.regions.empty()) {
+                        mip_levels = 1;
+                    }
+                }
 
-                uint32_t queue_family = 0;
-                uint32_t queue_index = 0;
-                VkQueue temp_graphics_queue = nullptr;
-                vkGetDeviceQueue(
-                  m_device, queue_family, queue_index, &temp_graphics_queue);
+                image_usage usage =
+                  image_usage::transfer_dst_bit | image_usage::sampled_bit;
+                if (gpu_mips) {
+                    usage = usage | image_usage::transfer_src_bit;
+                }
 
-                const VkCommandBuffer handle = temp_command_buffer;
-                VkSubmitInfo submit_info = {
-                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                    .commandBufferCount = 1,
-                    .pCommandBuffers = &handle,
+                image_params img_options = {
+                    .extent = p_extent,
+                    .format = p_params.format,
+                    .memory_mask = p_params.memory_mask,
+                    .usage = usage,
+                    .mip_levels = mip_levels,
+                    .layer_count = p_params.layer_count,
+                    .array_layers = p_params.layer_count,
+                    .sampler = p_params.sampler,
                 };
 
-                vkQueueSubmit(temp_graphics_queue, 1, &submit_info, nullptr);
-                vkQueueWaitIdle(temp_graphics_queue);
-
-                temp_command_buffer.destruct();
-                staging.destruct();
-            }
-
-            void construct(image* p_image,
-                           const texture_params& p_texture_params) {
-                m_extent = p_image->extent();
-
-                const VkFormat texture_format =
-                  static_cast<VkFormat>(format::r8g8b8a8_unorm);
+                if (!cpu_chain.regions.empty()) {
+                    upload(img_options,
+                           cpu_chain.bytes,
+                           cpu_chain.regions,
+                           false);
+                    return;
+                }
 
-                image_params img_options = {
-                    .extent = p_image->extent(),
-                    .format = texture_format,
-                    .memory_mask = p_texture_params.memory_mask,
-                    .usage =
-                      image_usage::transfer_dst_bit | image_usage::sampled_bit,
-                    .mip_levels = p_texture_params.mip_levels,
-                    .layer_count = p_texture_params.layer_count,
+                const std::array<buffer_image_copy, 1> region_copies = {
+                    copy_region(p_extent, 0, 0, p_params.layer_count),
                 };
+                upload(img_options, p_data, region_copies, gpu_mips);
+            }
 
-                m_image = sample_image(m_device, img_options);
-
-                // Staging buffer to transfer CPU-visible data to GPU-visible
-                // handles
+            /**
+             * @brief Creates the image and copies p_regions of p_data into it
+             * through a staging buffer
+             *
+             * If p_generate_mips is set, only level 0 is expected to be in
+             * p_regions and the rest of the chain is blitted from it.
+             */
+            void upload(const image_params& p_image_params,
+                        std::span<const uint8_t> p_data,
+                        std::span<const buffer_image_copy> p_regions,
+                        bool p_generate_mips) {
+                // Performing staging transfers
                 buffer_parameters staging_options = {
-                    .memory_mask = img_options.memory_mask,
+                    .memory_mask = p_image_params.memory_mask,
                     .usage = buffer_usage::transfer_src_bit,
                 };
-                buffer staging(
-                  m_device, p_image->read().size(), staging_options);
+                buffer staging(m_device, p_data.size(), staging_options);
 
-                staging.transfer(p_image->read());
+                staging.transfer(p_data);
 
-                // 5. Creating temporary command buffer for texture
+                // Performing transfers as a command to GPU memory for
+                // preparations
                 command_params copy_command_params = {
                     .levels = command_levels::primary,
                     .queue_index = 0,
@@ -176,30 +261,11 @@ export namespace vk {
 
                 temp_command_buffer.begin(command_usage::one_time_submit);
 
-                // Performing image layouts
-                VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-                VkImageLayout new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                m_image.memory_barrier(temp_command_buffer,
-                                       img_options.format,
-                                       old_layout,
-                                       new_layout);
-
-                std::array<vk::buffer_image_copy, 1> region_copies = {
-                    vk::buffer_image_copy{
-                        .image_offset = { .width = 0, .height = 0, .depth = 0, },
-                        .image_extent = { .width = img_options.extent.width, .height = img_options.extent.height, .depth = 1, },
-                    }
-                };
-
-                staging.copy_to_image(
-                  temp_command_buffer, m_image, region_copies);
-
-                old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                m_image.memory_barrier(temp_command_buffer,
-                                       img_options.format,
-                                       old_layout,
-                                       new_layout);
+                record_upload(temp_command_buffer,
+                              staging,
+                              p_regions,
+                              p_image_params,
+                              p_generate_mips);
 
                 temp_command_buffer.end();
 
@@ -223,16 +289,6 @@ export namespace vk {
                 staging.destruct();
             }
 
-            //! @return true if image loaded, false if texture did not load
-            //! correctly
-            [[nodiscard]] bool loaded() const { return m_texture_loaded; }
-
-            [[nodiscard]] sample_image image() const { return m_image; }
-
-            [[nodiscard]] image_extent extent() const { return m_extent; }
-
-            void destruct() { m_image.destruct(); }
-
         private:
             VkDevice m_device = nullptr;
             bool m_texture_loaded = false;
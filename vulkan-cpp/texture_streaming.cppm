@@ -0,0 +1,562 @@
+module;
+
+#include <vulkan/vulkan.h>
+#include <span>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <utility>
+
+export module vk:texture_streaming;
+
+export import :types;
+export import :utilities;
+export import :buffer;
+export import :sample_image;
+export import :command_buffer;
+export import :descriptor_resource;
+export import :ktx2;
+
+export namespace vk {
+    inline namespace v6 {
+
+        /**
+         * @param budget_bytes is the VRAM budget streamed textures are allowed
+         * to occupy. When 0, the budget is queried every update from
+         * VK_EXT_memory_budget (sum of device-local heap budgets scaled by
+         * budget_fraction). Setting this is also how a synthetic budget is
+         * used for testing on software ICDs.
+         * @param budget_fraction is the fraction of the queried heap budget
+         * given to streamed textures
+         * @param mip_tail_size is the largest dimension of mip levels that are
+         * always kept resident
+         * @param upload_bytes_per_update caps the amount of texel data uploaded
+         * in a single update to avoid frame hitches
+         * @param frames_in_flight is how many updates replaced images are kept
+         * alive before being destroyed
+         * @param memory_mask is the device-local memory mask for the images
+         * @param staging_memory_mask is the host-visible memory mask for
+         * staging buffers
+         * @param binding is the bindless combined image sampler binding that
+         * slots are written to
+         * @param sampler is a shared sampler (see vk::sampler_cache) used by
+         * every streamed image. Each residency change creates a new sampler
+         * when null.
+         */
+        struct streaming_params {
+            uint64_t budget_bytes = 0;
+            float budget_fraction = 0.8f;
+            uint32_t mip_tail_size = 64;
+            uint64_t upload_bytes_per_update = 64ull * 1024 * 1024;
+            uint32_t frames_in_flight = 2;
+            uint32_t memory_mask = 0;
+            uint32_t staging_memory_mask = 0;
+            uint32_t binding = 0;
+            VkSampler sampler = nullptr;
+        };
+
+        /**
+         * @brief Streams the mip levels of KTX2 textures into VRAM on demand
+         *
+         * Every texture starts with only its mip tail resident (levels no
+         * larger than streaming_params::mip_tail_size). Each frame the renderer
+         * calls request() with the most detailed level it needs, and update()
+         * streams in the requested levels. When the budget would be exceeded,
+         * the least recently used textures are dropped back to their mip tail.
+         *
+         * Residency changes create a new image holding only the resident
+         * levels and rewrite the texture's slot in the bindless descriptor set
+         * in place. The binding must be created with
+         * descriptor_bind_flags::update_after_bind and
+         * descriptor_bind_flags::partially_bound_bit inside a
+         * descriptor_layout_flags::update_after_bind_pool set (see
+         * demos/16-descriptor-indexing).
+         *
+         * ```
+         *
+         *  level:      0      1      2     3    4   5  6
+         *            [    ][    ][    ][   ][  ][ ][ ]
+         *                   ^ resident      ^ mip tail (always resident)
+         *                   |-------------------------|  current image
+         *
+         * ```
+         *
+         * Example Usage:
+         * ```C++
+         *
+         * vk::texture_streamer streamer(logical_device, physical_device,
+         *                               &set1_resource, streaming_params);
+         *
+         * uint32_t albedo = streamer.add(vk::load_ktx2("albedo.ktx2").value(),
+         *                                0);
+         *
+         * // Every frame
+         * streamer.request(albedo, desired_level);
+         * streamer.update(frame_index);
+         *
+         * ```
+         */
+        class texture_streamer {
+            struct streamed_texture {
+                ktx2_texture source;
+                uint32_t slot = 0;
+                uint32_t tail_level = 0;
+                uint32_t resident_level = 0;
+                uint32_t desired_level = 0;
+                uint64_t last_used = 0;
+                uint64_t resident_bytes = 0;
+                sample_image image{};
+            };
+
+            struct retired_image {
+                sample_image image;
+                uint64_t frame = 0;
+            };
+
+            struct upload_batch {
+                VkFence fence = nullptr;
+                command_buffer command{};
+                std::vector<buffer> staging;
+            };
+
+        public:
+            texture_streamer() = default;
+            texture_streamer(const VkDevice& p_device,
+                             const VkPhysicalDevice& p_physical,
+                             descriptor_resource* p_bindless,
+                             const streaming_params& p_params)
+              : m_device(p_device)
+              , m_physical(p_physical)
+              , m_bindless(p_bindless)
+              , m_params(p_params) {
+                vkGetDeviceQueue(m_device, 0, 0, &m_queue);
+            }
+
+            /**
+             * @brief Registers a texture and makes its mip tail resident
+             *
+             * @param p_source is the KTX2 texture holding every mip level. It
+             * is kept on the CPU to stream levels from.
+             * @param p_slot is the array element of the bindless binding the
+             * texture is written to
+             *
+             * @return handle used with request()
+             */
+            uint32_t add(ktx2_texture p_source, uint32_t p_slot) {
+                streamed_texture texture{
+                    .source = std::move(p_source),
+                    .slot = p_slot,
+                };
+
+                // First level that fits inside the mip tail
+                const uint32_t levels = texture.source.mip_levels;
+                texture.tail_level = levels - 1;
+                for (uint32_t level = 0; level < levels; level++) {
+                    const uint32_t largest =
+                      std::max(texture.source.extent.width >> level,
+                               texture.source.extent.height >> level);
+                    if (largest <= m_params.mip_tail_size) {
+                        texture.tail_level = level;
+                        break;
+                    }
+                }
+                texture.resident_level = texture.tail_level;
+                texture.desired_level = texture.tail_level;
+
+                m_textures.emplace_back(std::move(texture));
+                const uint32_t handle =
+                  static_cast<uint32_t>(m_textures.size() - 1);
+                m_pending_tail.push_back(handle);
+                return handle;
+            }
+
+            /**
+             * @brief Marks the texture as used this frame and requests
+             * p_level to be the most detailed resident level
+             */
+            void request(uint32_t p_handle, uint32_t p_level) {
+                streamed_texture& texture = m_textures[p_handle];
+                texture.desired_level = std::min(p_level, texture.tail_level);
+                // Requests are made for the upcoming update
+                texture.last_used = m_frame + 1;
+            }
+
+            /**
+             * @brief Performs streaming for this frame
+             *
+             * Releases finished uploads and retired images, evicts least
+             * recently used textures when over budget, then streams in
+             * requested levels for the most recently used textures first.
+             *
+             * @param p_frame is a monotonically increasing frame counter
+             */
+            void update(uint64_t p_frame) {
+                m_frame = p_frame;
+                collect();
+
+                const uint64_t budget = budget_bytes();
+                upload_batch batch{};
+                uint64_t uploaded = 0;
+
+                // Mip tails are always resident and are not subject to the
+                // budget
+                for (uint32_t handle : m_pending_tail) {
+                    streamed_texture& texture = m_textures[handle];
+                    make_resident(texture, texture.tail_level, batch);
+                }
+                m_pending_tail.clear();
+
+                std::vector<uint32_t> order(m_textures.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::ranges::sort(order, [this](uint32_t p_a, uint32_t p_b) {
+                    return m_textures[p_a].last_used >
+                           m_textures[p_b].last_used;
+                });
+
+                for (uint32_t handle : order) {
+                    streamed_texture& texture = m_textures[handle];
+                    if (texture.desired_level >= texture.resident_level) {
+                        continue;
+                    }
+
+                    // Try the requested level first, then coarser ones
+                    for (uint32_t level = texture.desired_level;
+                         level < texture.resident_level;
+                         level++) {
+                        const uint64_t size = residency_size(texture, level);
+                        const uint64_t cost = size - texture.resident_bytes;
+
+                        if (uploaded + size > m_params.upload_bytes_per_update) {
+                            continue;
+                        }
+
+                        if (m_resident_bytes + cost > budget and
+                            !evict(m_resident_bytes + cost - budget,
+                                   texture.last_used)) {
+                            continue;
+                        }
+
+                        make_resident(texture, level, batch);
+                        uploaded += size;
+                        break;
+                    }
+                }
+
+                submit(std::move(batch));
+            }
+
+            //! @return bytes of texel data currently resident in VRAM
+            [[nodiscard]] uint64_t resident_bytes() const {
+                return m_resident_bytes;
+            }
+
+            /**
+             * @return the budget available for streamed textures, either the
+             * synthetic streaming_params::budget_bytes or the value queried
+             * from VK_EXT_memory_budget
+             */
+            [[nodiscard]] uint64_t budget_bytes() const {
+                if (m_params.budget_bytes != 0) {
+                    return m_params.budget_bytes;
+                }
+
+                VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+                    .pNext = nullptr,
+                };
+                VkPhysicalDeviceMemoryProperties2 memory_properties = {
+                    .sType =
+                      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+                    .pNext = &budget_properties,
+                };
+                vkGetPhysicalDeviceMemoryProperties2(m_physical,
+                                                     &memory_properties);
+
+                uint64_t budget = 0;
+                uint64_t usage = 0;
+                const VkPhysicalDeviceMemoryProperties& properties =
+                  memory_properties.memoryProperties;
+                for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+                    if (properties.memoryHeaps[i].flags &
+                        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                        budget += budget_properties.heapBudget[i];
+                        usage += budget_properties.heapUsage[i];
+                    }
+                }
+
+                // heapUsage already contains our own textures, so only the
+                // memory used by everything else is subtracted
+                const uint64_t others =
+                  (usage > m_resident_bytes) ? usage - m_resident_bytes : 0;
+                const uint64_t available =
+                  (budget > others) ? budget - others : 0;
+                return static_cast<uint64_t>(
+                  static_cast<double>(available) * m_params.budget_fraction);
+            }
+
+            //! @return the most detailed level currently resident
+            [[nodiscard]] uint32_t resident_level(uint32_t p_handle) const {
+                return m_textures[p_handle].resident_level;
+            }
+
+            void destruct() {
+                if (m_device == nullptr) {
+                    return;
+                }
+
+                vkQueueWaitIdle(m_queue);
+
+                for (upload_batch& batch : m_batches) {
+                    release(batch);
+                }
+                m_batches.clear();
+
+                for (retired_image& retired : m_retired) {
+                    retired.image.destruct();
+                }
+                m_retired.clear();
+
+                for (streamed_texture& texture : m_textures) {
+                    texture.image.destruct();
+                }
+                m_textures.clear();
+            }
+
+        private:
+            //! @return bytes occupied by levels [p_level, mip_levels)
+            uint64_t residency_size(const streamed_texture& p_texture,
+                                    uint32_t p_level) const {
+                uint64_t size = 0;
+                for (uint32_t level = p_level;
+                     level < p_texture.source.mip_levels;
+                     level++) {
+                    size += image_level_size(p_texture.source.format,
+                                             p_texture.source.extent,
+                                             level) *
+                            p_texture.source.layer_count();
+                }
+                return size;
+            }
+
+            /**
+             * @brief Drops least recently used textures back to their mip
+             * tail until p_bytes have been freed
+             *
+             * Only textures used before p_last_used are considered, so a
+             * texture never evicts something needed by the same frame.
+             *
+             * @return true if enough memory was freed
+             */
+            bool evict(uint64_t p_bytes, uint64_t p_last_used) {
+                std::vector<uint32_t> candidates;
+                for (uint32_t i = 0; i < m_textures.size(); i++) {
+                    const streamed_texture& texture = m_textures[i];
+                    if (texture.resident_level < texture.tail_level and
+                        texture.last_used < p_last_used) {
+                        candidates.push_back(i);
+                    }
+                }
+
+                uint64_t reclaimable = 0;
+                for (uint32_t i : candidates) {
+                    const streamed_texture& texture = m_textures[i];
+                    reclaimable += texture.resident_bytes -
+                                   residency_size(texture, texture.tail_level);
+                }
+                if (reclaimable < p_bytes) {
+                    return false;
+                }
+
+                std::ranges::sort(candidates,
+                                  [this](uint32_t p_a, uint32_t p_b) {
+                                      return m_textures[p_a].last_used <
+                                             m_textures[p_b].last_used;
+                                  });
+
+                upload_batch batch{};
+                uint64_t freed = 0;
+                for (uint32_t i : candidates) {
+                    if (freed >= p_bytes) {
+                        break;
+                    }
+                    streamed_texture& texture = m_textures[i];
+                    const uint64_t before = texture.resident_bytes;
+                    make_resident(texture, texture.tail_level, batch);
+                    freed += before - texture.resident_bytes;
+                }
+                submit(std::move(batch));
+                return true;
+            }
+
+            /**
+             * @brief Replaces the texture's image with one holding levels
+             * [p_level, mip_levels) and rewrites its bindless slot
+             */
+            void make_resident(streamed_texture& p_texture,
+                               uint32_t p_level,
+                               upload_batch& p_batch) {
+                const ktx2_texture& source = p_texture.source;
+
+                if (p_batch.fence == nullptr) {
+                    p_batch.command = command_buffer(
+                      m_device,
+                      command_params{
+                        .levels = command_levels::primary,
+                        .queue_index = 0,
+                        .flags = command_pool_flags::reset,
+                      });
+                    p_batch.command.begin(command_usage::one_time_submit);
+
+                    VkFenceCreateInfo fence_ci = {
+                        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                        .pNext = nullptr,
+                        .flags = 0,
+                    };
+                    vk_check(
+                      vkCreateFence(m_device, &fence_ci, nullptr, &p_batch.fence),
+                      "vkCreateFence");
+                }
+
+                // KTX2 stores the smallest level first so the levels
+                // [p_level, mip_levels) are one contiguous range of the file
+                const uint64_t first =
+                  source.regions[source.mip_levels - 1].offset;
+                const uint64_t last =
+                  source.regions[p_level].offset +
+                  (image_level_size(source.format, source.extent, p_level) *
+                   source.layer_count());
+
+                buffer staging(m_device,
+                               last - first,
+                               buffer_parameters{
+                                 .memory_mask = m_params.staging_memory_mask,
+                                 .usage = buffer_usage::transfer_src_bit,
+                               });
+                staging.transfer(std::span<const uint8_t>(
+                  source.bytes.data() + first, last - first));
+
+                std::vector<buffer_image_copy> regions;
+                regions.reserve(source.mip_levels - p_level);
+                for (uint32_t level = p_level; level < source.mip_levels;
+                     level++) {
+                    buffer_image_copy region = source.regions[level];
+                    region.offset -= first;
+                    region.mip_level -= p_level;
+                    regions.push_back(region);
+                }
+
+                image_params img_options =
+                  source.params(m_params.memory_mask, p_level);
+                img_options.sampler = m_params.sampler;
+                sample_image image(m_device, img_options);
+                image.memory_barrier(p_batch.command,
+                                     source.format,
+                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+                staging.copy_to_image(p_batch.command, image, regions);
+                image.memory_barrier(p_batch.command,
+                                     source.format,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                p_batch.staging.push_back(staging);
+
+                // In-flight frames may still sample the previous image
+                if (p_texture.image.image_view() != nullptr) {
+                    m_retired.push_back(
+                      retired_image{ .image = p_texture.image,
+                                     .frame = m_frame });
+                }
+
+                m_resident_bytes -= p_texture.resident_bytes;
+                p_texture.image = image;
+                p_texture.resident_level = p_level;
+                p_texture.resident_bytes = residency_size(p_texture, p_level);
+                m_resident_bytes += p_texture.resident_bytes;
+
+                // The upload is submitted before the frame that samples it on
+                // the same queue, and the barrier above orders it against the
+                // fragment shader reads
+                if (m_bindless != nullptr) {
+                    const std::array<write_image, 1> images = {
+                        write_image{
+                          .sampler = image.sampler(),
+                          .view = image.image_view(),
+                          .layout = image_layout::shader_read_only_optimal,
+                        },
+                    };
+                    const std::array<write_image_descriptor, 1> writes = {
+                        write_image_descriptor{
+                          .dst_binding = m_params.binding,
+                          .dst_array_element = p_texture.slot,
+                          .sample_images = images,
+                        },
+                    };
+                    m_bindless->update({}, writes);
+                }
+            }
+
+            void submit(upload_batch&& p_batch) {
+                if (p_batch.fence == nullptr) {
+                    return;
+                }
+
+                p_batch.command.end();
+
+                const VkCommandBuffer handle = p_batch.command;
+                VkSubmitInfo submit_info = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers = &handle,
+                };
+                vk_check(vkQueueSubmit(m_queue, 1, &submit_info, p_batch.fence),
+                         "vkQueueSubmit");
+
+                m_batches.push_back(std::move(p_batch));
+            }
+
+            //! @brief Frees finished uploads and images no frame can reference
+            void collect() {
+                std::erase_if(m_batches, [this](upload_batch& p_batch) {
+                    if (vkGetFenceStatus(m_device, p_batch.fence) !=
+                        VK_SUCCESS) {
+                        return false;
+                    }
+                    release(p_batch);
+                    return true;
+                });
+
+                std::erase_if(m_retired, [this](retired_image& p_retired) {
+                    if (p_retired.frame + m_params.frames_in_flight > m_frame) {
+                        return false;
+                    }
+                    p_retired.image.destruct();
+                    return true;
+                });
+            }
+
+            void release(upload_batch& p_batch) {
+                for (buffer& staging : p_batch.staging) {
+                    staging.destruct();
+                }
+                p_batch.command.destruct();
+                vkDestroyFence(m_device, p_batch.fence, nullptr);
+            }
+
+        private:
+            VkDevice m_device = nullptr;
+            VkPhysicalDevice m_physical = nullptr;
+            VkQueue m_queue = nullptr;
+            descriptor_resource* m_bindless = nullptr;
+            streaming_params m_params{};
+            uint64_t m_frame = 0;
+            uint64_t m_resident_bytes = 0;
+            std::vector<streamed_texture> m_textures;
+            std::vector<uint32_t> m_pending_tail;
+            std::vector<upload_batch> m_batches;
+            std::vector<retired_image> m_retired;
+        };
+    };
+};
@@ -6,6 +6,7 @@ module;
 #include <span>
 #include <array>
 #include <filesystem>
+#include <cstddef>
 #include <glm/glm.hpp>
 
 export module vk:types;
@@ -649,8 +650,14 @@ export namespace vk {
             uint32_t present_index = -1;
 
             uint64_t depth; // depth format
+            //! @brief Should come from physical_device::request_present_mode
+            //! so unsupported modes fall back to fifo
             uint32_t present_mode = present_mode::fifo_khr;
             bool clipped = true;
+            //! @brief Swapchain images requested, clamped to the surface
+            //! limits. 0 uses surface_params::image_size (minImageCount + 1).
+            //! 2 lowers latency under fifo, 3 keeps mailbox from blocking.
+            uint32_t image_count = 0;
         };
 
         /**
@@ -1061,8 +1068,19 @@ export namespace vk {
               VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // represents
                                                          // VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
             sampled_only_image =
-              VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE // represents
-                                               // VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+              VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, // represents
+                                                // VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            storage_image =
+              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, // represents
+                                                // VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            sampler_only = VK_DESCRIPTOR_TYPE_SAMPLER, // represents
+                                                       // VK_DESCRIPTOR_TYPE_SAMPLER
+            uniform_dynamic =
+              VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // represents
+                                                         // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+            storage_dynamic =
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC // represents
+                                                        // VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
         };
 
         enum class image_usage : uint32_t {
@@ -1481,6 +1499,10 @@ export namespace vk {
             none = 0x00000000,
             update_after_bind_pool =
               VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            descriptor_buffer =
+              VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT,
+            push_descriptor =
+              VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
         };
 
         enum class descriptor_bind_flags : uint32_t {
@@ -1504,11 +1526,57 @@ export namespace vk {
             shader_stage stage = shader_stage::undefined;
         };
 
+        /**
+         * @brief Maps a specialization constant, layout(constant_id = N), to
+         * its value in specialization_info::data
+         *
+         * Same layout as VkSpecializationMapEntry, so a constexpr array of
+         * entries can be described with offsetof and passed as is.
+         */
+        struct specialization_entry {
+            uint32_t constant_id = 0;
+            uint32_t offset = 0;
+            size_t size = 0;
+        };
+
+        // The pipelines pass entries through pMapEntries without a copy
+        static_assert(sizeof(specialization_entry) ==
+                        sizeof(VkSpecializationMapEntry) and
+                      alignof(specialization_entry) ==
+                        alignof(VkSpecializationMapEntry));
+        static_assert(offsetof(specialization_entry, constant_id) ==
+                        offsetof(VkSpecializationMapEntry, constantID) and
+                      offsetof(specialization_entry, offset) ==
+                        offsetof(VkSpecializationMapEntry, offset) and
+                      offsetof(specialization_entry, size) ==
+                        offsetof(VkSpecializationMapEntry, size));
+
+        //! @brief Values of the specialization constants of a shader stage,
+        //! maps to VkSpecializationInfo
+        struct specialization_info {
+            std::span<const specialization_entry> entries{};
+            std::span<const std::byte> data{};
+
+            [[nodiscard]] bool empty() const { return entries.empty(); }
+        };
+
         //! @brief Represent the vulkan shader module that will get utilized by
         //! VkPipeline
         struct shader_handle {
             VkShaderModule module = nullptr;
             shader_stage stage = shader_stage::undefined;
+            /**
+             * @brief SPIR-V of the stage, passed inline through
+             * VkShaderModuleCreateInfo when module is null (requires
+             * maintenance5). Set with a module too, caches then identify the
+             * shader by its content rather than by a handle that can be
+             * reused once the module is destroyed.
+             */
+            std::span<const uint32_t> code{};
+            //! @brief Function of the module the stage executes
+            const char* entry_point = "main";
+            //! @brief Overrides pipeline_params::specialization when set
+            specialization_info specialization{};
         };
 
         struct vertex_attribute_entry {
@@ -1545,6 +1613,10 @@ export namespace vk {
         struct descriptor_binding_point {
             uint32_t binding;
             shader_stage stage;
+
+            bool operator==(const descriptor_binding_point& p_other) const {
+                return binding == p_other.binding and stage == p_other.stage;
+            }
         };
 
         struct descriptor_entry {
@@ -1552,8 +1624,23 @@ export namespace vk {
             descriptor_binding_point binding_point;
             uint32_t descriptor_count;
             descriptor_bind_flags flags;
+
+            bool operator==(const descriptor_entry& p_other) const {
+                return type == p_other.type and
+                       binding_point == p_other.binding_point and
+                       descriptor_count == p_other.descriptor_count and
+                       flags == p_other.flags;
+            }
         };
 
+        /**
+         * @brief Image descriptor to write
+         *
+         * Only the fields used by the descriptor type of the binding are
+         * read: descriptor_type::sampler_only only uses sampler and
+         * descriptor_type::sampled_only_image only uses view and layout, so
+         * shared samplers can be bound separately from the images.
+         */
         struct write_image {
             VkSampler sampler = nullptr;
             VkImageView view = nullptr;
@@ -1565,16 +1652,26 @@ export namespace vk {
             uint32_t range = 0;
         };
 
+        /**
+         * @param type is only read by command_buffer::push_descriptors,
+         * descriptor_resource::update takes the type from its layout
+         */
         struct write_buffer_descriptor {
             uint32_t dst_binding;
             uint32_t dst_array_element = 0;
             std::span<const write_buffer> uniforms;
+            descriptor_type type = descriptor_type::uniform;
         };
 
+        /**
+         * @param type is only read by command_buffer::push_descriptors,
+         * descriptor_resource::update takes the type from its layout
+         */
         struct write_image_descriptor {
             uint32_t dst_binding;
             uint32_t dst_array_element = 0;
             std::span<const write_image> sample_images;
+            descriptor_type type = descriptor_type::combined_image_sampler;
         };
 
         struct image_extent {
@@ -1583,6 +1680,62 @@ export namespace vk {
             uint32_t depth = 1;
         };
 
+        /**
+         * @brief Full state of a VkSampler, used as the key of
+         * vk::sampler_cache
+         *
+         * @param range.min is the minification filter and range.max the
+         * magnification filter
+         * @param max_anisotropy enables anisotropic filtering when greater
+         * than 1. Requires the samplerAnisotropy feature and is clamped to
+         * VkPhysicalDeviceLimits::maxSamplerAnisotropy by vk::sampler_cache.
+         * @param max_lod defaults to VK_LOD_CLAMP_NONE so every mip level of
+         * the image can be sampled
+         */
+        struct sampler_params {
+            filter_range range{
+                .min = VK_FILTER_LINEAR,
+                .max = VK_FILTER_LINEAR,
+            };
+            VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+            uint32_t address_mode_u = sampler_address_mode::repeat;
+            uint32_t address_mode_v = sampler_address_mode::repeat;
+            uint32_t address_mode_w = sampler_address_mode::repeat;
+            float mip_lod_bias = 0.f;
+            float max_anisotropy = 1.f;
+            bool compare_enable = false;
+            VkCompareOp compare_op = VK_COMPARE_OP_ALWAYS;
+            float min_lod = 0.f;
+            float max_lod = VK_LOD_CLAMP_NONE;
+            VkBorderColor border_color = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+            bool unnormalized_coordinates = false;
+
+            bool operator==(const sampler_params& p_other) const {
+                return range.min == p_other.range.min and
+                       range.max == p_other.range.max and
+                       mipmap_mode == p_other.mipmap_mode and
+                       address_mode_u == p_other.address_mode_u and
+                       address_mode_v == p_other.address_mode_v and
+                       address_mode_w == p_other.address_mode_w and
+                       mip_lod_bias == p_other.mip_lod_bias and
+                       max_anisotropy == p_other.max_anisotropy and
+                       compare_enable == p_other.compare_enable and
+                       compare_op == p_other.compare_op and
+                       min_lod == p_other.min_lod and
+                       max_lod == p_other.max_lod and
+                       border_color == p_other.border_color and
+                       unnormalized_coordinates ==
+                         p_other.unnormalized_coordinates;
+            }
+        };
+
+        /**
+         * @param mip_lod_bias and max_anisotropy configure the sampler the
+         * image creates when sampler is not set
+         * @param sampler is a shared sampler (e.g. from vk::sampler_cache) to
+         * reference instead of creating one per image. It is not destroyed
+         * with the image.
+         */
         struct image_params {
             image_extent extent{};
             VkFormat format = VK_FORMAT_UNDEFINED;
@@ -1602,17 +1755,29 @@ export namespace vk {
             uint32_t address_mode_u = sampler_address_mode::repeat;
             uint32_t addrses_mode_v = sampler_address_mode::repeat;
             uint32_t addrses_mode_w = sampler_address_mode::repeat;
+            float mip_lod_bias = 0.f;
+            float max_anisotropy = 1.f;
+            VkSampler sampler = nullptr;
         };
 
         // TODO: Remove redundant struct and replace with vk::image_params
         struct texture_params {
             uint32_t memory_mask = 0;
+            VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
             uint32_t mip_levels = 1;
             uint32_t layer_count = 1;
+            //! @brief Generate mips with vkCmdBlitImage when true, otherwise
+            //! fallback to generating them on the CPU. Should be set from
+            //! physical_device::linear_blit_supported
+            bool linear_blit = true;
+            //! @brief Shared sampler to reference, a sampler is created per
+            //! texture when null
+            VkSampler sampler = nullptr;
         };
 
         struct buffer_image_copy {
-            uint32_t offset = 0;
+            //! byte offset into the buffer, 64-bit as in VkBufferImageCopy
+            VkDeviceSize offset = 0;
             uint32_t row_length = 0;
             uint32_t image_height = 0;
             image_aspect_flags aspect_mask = image_aspect_flags::color_bit;
@@ -1623,6 +1788,19 @@ export namespace vk {
             image_extent image_extent{};
         };
 
+        /**
+         * @brief Texel block dimensions of a format
+         *
+         * Uncompressed formats are treated as 1x1 blocks where bytes is the
+         * size of a single texel. Block-compressed formats (BCn, ETC2/EAC)
+         * are stored as 4x4 texel blocks.
+         */
+        struct format_block {
+            uint32_t width = 1;
+            uint32_t height = 1;
+            uint32_t bytes = 0;
+        };
+
         struct buffer_parameters {
             uint32_t memory_mask = 0;
             buffer_usage usage;
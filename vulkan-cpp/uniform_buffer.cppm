@@ -4,6 +4,8 @@ module;
 #include <span>
 #include <array>
 #include <cassert>
+#include <algorithm>
+#include <cstring>
 
 export module vk:uniform_buffer;
 
@@ -55,5 +57,174 @@ export namespace vk {
             VkDevice m_device = nullptr;
             buffer m_uniform_handle{};
         };
+
+        //! @brief Offset returned when a uniform_ring frame is out of space
+        constexpr uint32_t invalid_uniform_offset = ~0u;
+
+        /**
+         * @param frame_size_bytes is the space for uniforms of one frame
+         * @param frames_in_flight is the amount of frames the GPU may still be
+         * reading, each gets its own region
+         * @param min_alignment must be the device
+         * minUniformBufferOffsetAlignment
+         * @param memory_mask must be host-visible and host-coherent
+         */
+        struct uniform_ring_params {
+            uint64_t frame_size_bytes = 64 * 1024;
+            uint32_t frames_in_flight = 2;
+            uint64_t min_alignment = 256;
+            uint32_t memory_mask = 0;
+        };
+
+        /**
+         * @brief Suballocates per-draw uniform slices from one persistently
+         * mapped buffer
+         *
+         * Each frame in flight owns a region of the buffer, so the CPU never
+         * writes memory a previous frame is still reading (which
+         * vk::uniform_buffer does when rewritten every frame). Slices are
+         * aligned to min_alignment and bound through a single
+         * descriptor_type::uniform_dynamic descriptor with the slice offset as
+         * the dynamic offset, so one descriptor set serves every draw.
+         *
+         * ```
+         *
+         *  [ frame 0: draw0 | draw1 | ... ][ frame 1: draw0 | ... ]
+         *                                    ^ begin_frame(1) resets the head
+         *
+         * ```
+         *
+         * Example Usage:
+         *
+         * ```C++
+         *
+         * vk::uniform_ring ring(logical_device, {
+         *      .frames_in_flight = image_count,
+         *      .min_alignment =
+         *        physical.properties().limits.minUniformBufferOffsetAlignment,
+         *      .memory_mask = host_visible_coherent,
+         * });
+         *
+         * // descriptor written once with descriptor_type::uniform_dynamic
+         * std::array<vk::write_buffer, 1> uniforms = { ring.descriptor(
+         *      sizeof(object_uniform)) };
+         *
+         * ring.begin_frame(current_frame);
+         * for (const auto& object : objects) {
+         *      std::array<uint32_t, 1> offsets = { ring.push(object.ubo) };
+         *      current.bind_descriptors(pipeline.layout(),
+         *          VK_PIPELINE_BIND_POINT_GRAPHICS, sets, offsets);
+         *      // draw
+         * }
+         *
+         * ```
+         */
+        class uniform_ring {
+        public:
+            uniform_ring() = default;
+
+            uniform_ring(const VkDevice& p_device,
+                         const uniform_ring_params& p_params)
+              : m_alignment(std::max<uint64_t>(p_params.min_alignment, 1))
+              , m_frame_count(std::max(p_params.frames_in_flight, 1u)) {
+                m_frame_size = align(p_params.frame_size_bytes);
+
+                buffer_parameters ring_params = {
+                    .memory_mask = p_params.memory_mask,
+                    .usage = buffer_usage::uniform_buffer_bit,
+                };
+                m_buffer =
+                  buffer(p_device, m_frame_size * m_frame_count, ring_params);
+                m_mapped = m_buffer.map();
+            }
+
+            [[nodiscard]] bool alive() const { return m_buffer; }
+
+            /**
+             * @brief Starts writing into the region of p_frame_index
+             *
+             * The fence of the frame that last used this region must have
+             * signaled.
+             */
+            void begin_frame(uint32_t p_frame_index) {
+                m_frame_begin = (p_frame_index % m_frame_count) * m_frame_size;
+                m_head = m_frame_begin;
+            }
+
+            /**
+             * @brief Reserves p_size_bytes in the current frame region
+             *
+             * @return the dynamic offset of the slice, or
+             * invalid_uniform_offset when the region is full
+             */
+            [[nodiscard]] uint32_t allocate(uint64_t p_size_bytes) {
+                const uint64_t size = align(p_size_bytes);
+                if (m_head + size > m_frame_begin + m_frame_size) {
+                    return invalid_uniform_offset;
+                }
+
+                const uint64_t offset = m_head;
+                m_head += size;
+                return static_cast<uint32_t>(offset);
+            }
+
+            //! @brief Copies p_data into a new slice
+            //! @return the dynamic offset of the slice
+            template<typename T>
+            [[nodiscard]] uint32_t push(const T& p_data) {
+                const uint32_t offset = allocate(sizeof(T));
+                if (offset != invalid_uniform_offset) {
+                    std::memcpy(m_mapped.data() + offset, &p_data, sizeof(T));
+                }
+                return offset;
+            }
+
+            //! @return the mapped bytes of a slice returned by allocate()
+            [[nodiscard]] std::span<uint8_t> data(uint32_t p_offset,
+                                                  uint64_t p_size_bytes) {
+                return m_mapped.subspan(p_offset, p_size_bytes);
+            }
+
+            /**
+             * @return the buffer descriptor to write once into a
+             * descriptor_type::uniform_dynamic binding, p_range being the
+             * size the shader reads per slice
+             */
+            [[nodiscard]] write_buffer descriptor(uint32_t p_range) const {
+                return write_buffer{
+                    .buffer = m_buffer,
+                    .offset = 0,
+                    .range = p_range,
+                };
+            }
+
+            //! @return bytes used in the current frame region
+            [[nodiscard]] uint64_t used_bytes() const {
+                return m_head - m_frame_begin;
+            }
+
+            operator VkBuffer() const { return m_buffer; }
+
+            operator VkBuffer() { return m_buffer; }
+
+            void destruct() {
+                m_mapped = {};
+                m_buffer.destruct();
+            }
+
+        private:
+            [[nodiscard]] uint64_t align(uint64_t p_size) const {
+                return (p_size + m_alignment - 1) / m_alignment * m_alignment;
+            }
+
+        private:
+            buffer m_buffer{};
+            std::span<uint8_t> m_mapped;
+            uint64_t m_alignment = 256;
+            uint32_t m_frame_count = 1;
+            uint64_t m_frame_size = 0;
+            uint64_t m_frame_begin = 0;
+            uint64_t m_head = 0;
+        };
     };
 };
\ No newline at end of file
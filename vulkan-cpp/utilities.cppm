@@ -6,6 +6,9 @@ module;
 #include <span>
 #include <source_location>
 #include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 
 export module vk:utilities;
 
@@ -53,12 +56,17 @@ export namespace vk {
                 case VK_FORMAT_R8_SINT:
                 case VK_FORMAT_R8_UNORM:
                     return 1;
+                case VK_FORMAT_R8G8_UNORM:
                 case VK_FORMAT_R16_SFLOAT:
                     return 2;
                 case VK_FORMAT_R16G16_SFLOAT:
                 case VK_FORMAT_B8G8R8A8_UNORM:
+                case VK_FORMAT_B8G8R8A8_SRGB:
                 case VK_FORMAT_R8G8B8A8_UNORM:
+                case VK_FORMAT_R32_SFLOAT:
                     return 4;
+                case VK_FORMAT_R32G32_SFLOAT:
+                    return 2 * sizeof(float);
                 case VK_FORMAT_R16G16B16A16_SFLOAT:
                     return 4 * sizeof(uint16_t);
                 case VK_FORMAT_R32G32B32A32_SFLOAT:
@@ -72,11 +80,177 @@ export namespace vk {
             return 0;
         }
 
+        //! @return the texel block dimensions and byte size of p_format
+        format_block texel_block(VkFormat p_format) {
+            switch (p_format) {
+                // 8 bytes per 4x4 block
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                case VK_FORMAT_BC4_SNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+                case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+                case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+                    return format_block{ .width = 4, .height = 4, .bytes = 8 };
+
+                // 16 bytes per 4x4 block
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                case VK_FORMAT_BC5_SNORM_BLOCK:
+                case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+                case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+                case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+                case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+                    return format_block{ .width = 4, .height = 4, .bytes = 16 };
+
+                default:
+                    return format_block{
+                        .bytes = static_cast<uint32_t>(
+                          bytes_per_texture_format(p_format)),
+                    };
+            }
+        }
+
+        //! @return true if p_format is stored as blocks of multiple texels
+        bool is_block_compressed(VkFormat p_format) {
+            const format_block block = texel_block(p_format);
+            return block.width > 1 or block.height > 1;
+        }
+
+        /**
+         * @return the size in bytes of a single layer of mip level p_level
+         *
+         * Partial blocks at the edges of the image are rounded up to a whole
+         * block as required by block-compressed formats.
+         */
+        uint64_t image_level_size(VkFormat p_format,
+                                  const image_extent& p_extent,
+                                  uint32_t p_level = 0) {
+            const format_block block = texel_block(p_format);
+            const uint32_t width = std::max(p_extent.width >> p_level, 1u);
+            const uint32_t height = std::max(p_extent.height >> p_level, 1u);
+            const uint32_t depth = std::max(p_extent.depth >> p_level, 1u);
+
+            const uint64_t blocks_x = (width + block.width - 1) / block.width;
+            const uint64_t blocks_y =
+              (height + block.height - 1) / block.height;
+            return blocks_x * blocks_y * depth * block.bytes;
+        }
+
+        /**
+         * @brief Copy region of a single mip level
+         *
+         * The image extent is the real size of the mip level rather than a
+         * multiple of the block size, which Vulkan allows for regions that
+         * touch the edge of the image. p_offset must be a multiple of the
+         * block size in bytes (and of 4).
+         *
+         * Row length and image height are left as 0 (tightly packed) so
+         * Vulkan derives them from the extent, rounding up to whole blocks.
+         *
+         * @param p_extent is the extent of level 0
+         * @param p_level is the mip level to copy into
+         * @param p_offset is the byte offset of the level inside the buffer
+         * @param p_layer_count is the amount of array layers (including cube
+         * faces) tightly packed after p_offset
+         */
+        buffer_image_copy copy_region(const image_extent& p_extent,
+                                      uint32_t p_level,
+                                      VkDeviceSize p_offset,
+                                      uint32_t p_layer_count = 1) {
+            return buffer_image_copy{
+                .offset = p_offset,
+                .mip_level = p_level,
+                .base_array_layer = 0,
+                .layer_count = p_layer_count,
+                .image_offset = { .width = 0, .height = 0, .depth = 0 },
+                .image_extent = {
+                    .width = std::max(p_extent.width >> p_level, 1u),
+                    .height = std::max(p_extent.height >> p_level, 1u),
+                    .depth = std::max(p_extent.depth >> p_level, 1u),
+                },
+            };
+        }
+
+        //! @return lcm(texel block size, 4), the alignment
+        //! vkCmdCopyBufferToImage requires of buffer offsets of p_format
+        uint64_t copy_alignment(VkFormat p_format) {
+            const uint64_t bytes = std::max(texel_block(p_format).bytes, 1u);
+            return (bytes % 4 == 0)   ? bytes
+                   : (bytes % 2 == 0) ? bytes * 2
+                                      : bytes * 4;
+        }
+
+        /**
+         * @brief Copy regions for a mip chain that is tightly packed one level
+         * after the other, each level holding every array layer
+         *
+         * Level offsets are aligned to both the block size and 4 bytes as
+         * required by vkCmdCopyBufferToImage.
+         */
+        std::vector<buffer_image_copy> copy_regions(VkFormat p_format,
+                                                    const image_extent& p_extent,
+                                                    uint32_t p_mip_levels,
+                                                    uint32_t p_layer_count = 1) {
+            const uint64_t alignment = copy_alignment(p_format);
+
+            std::vector<buffer_image_copy> regions(p_mip_levels);
+            uint64_t offset = 0;
+            for (uint32_t level = 0; level < p_mip_levels; level++) {
+                offset = ((offset + alignment - 1) / alignment) * alignment;
+                regions[level] =
+                  copy_region(p_extent, level, offset, p_layer_count);
+                offset +=
+                  image_level_size(p_format, p_extent, level) * p_layer_count;
+            }
+            return regions;
+        }
+
         bool has_stencil_attachment(VkFormat p_format) {
             return ((p_format == VK_FORMAT_D32_SFLOAT_S8_UINT) ||
                     (p_format == VK_FORMAT_D24_UNORM_S8_UINT));
         }
 
+        //! @brief Offset basis of 64-bit FNV-1a, the initial seed of hash_bytes
+        constexpr uint64_t hash_seed = 0xcbf29ce484222325ull;
+
+        /**
+         * @brief 64-bit FNV-1a of p_bytes, continuing from p_seed
+         *
+         * Content hash shared by the caches of vk. Hash several fields by
+         * passing the result of one call as the seed of the next.
+         */
+        [[nodiscard]] uint64_t hash_bytes(std::span<const std::byte> p_bytes,
+                                          uint64_t p_seed = hash_seed) {
+            for (std::byte byte : p_bytes) {
+                p_seed =
+                  (p_seed ^ std::to_integer<uint64_t>(byte)) * 0x100000001b3ull;
+            }
+            return p_seed;
+        }
+
+        //! @brief Mixes the 8 bytes of p_value into p_seed, as hash_bytes does
+        [[nodiscard]] constexpr uint64_t hash_combine(uint64_t p_seed,
+                                                      uint64_t p_value) {
+            for (uint32_t i = 0; i < sizeof(uint64_t); i++) {
+                p_seed = (p_seed ^ ((p_value >> (i * 8)) & 0xff)) *
+                         0x100000001b3ull;
+            }
+            return p_seed;
+        }
+
         /**
          * @brief Used to convert a given set of types T into chunks of bytes.
          *
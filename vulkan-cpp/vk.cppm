@@ -24,6 +24,28 @@ export import :descriptor_resource;
 export import :texture;
 export import :buffer_device_address;
 export import :image;
+export import :mesh_lod;
+export import :mipmap;
+export import :ktx2;
+export import :texture_streaming;
+export import :image_decoder;
+export import :compute_pipeline;
+export import :environment_processor;
+export import :sampler_cache;
+export import :descriptor_allocator;
+export import :descriptor_layout_cache;
+export import :descriptor_update_template;
+export import :bindless_table;
+export import :descriptor_buffer;
+export import :push_constants;
+export import :headless;
+export import :readback;
+export import :shader_reflection;
+export import :shader_module_cache;
+export import :shader_compiler;
+export import :shader_hot_reload;
+export import :specialization;
+export import :pipeline_library;
 
 namespace vk {
     inline namespace v6 {};